@@ -0,0 +1,377 @@
+// Copyright Douglas Santos Reis.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+
+/*
+ * Microbenchmarks of the helpers on the hot paths of the loader, timed over
+ * the geometries of the flash presets and a range of image sizes. Each case
+ * runs several times on a memory in RAM and the median is reported, as JSON
+ * or CSV, to be compared between releases.
+ */
+
+#include "FlashModel.h"
+#include "crc.h"
+#include <Flashboot.h>
+#include <Helper.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_MAX_RUNS 101
+
+static const char usage[] =
+    "usage: flashbootBench [--runs <n>] [--format json|csv] [--output <file>]\n"
+    "                      [--flash stm32g4|spi-nor] [--size <bytes>]\n"
+    "Without --flash or --size a range of each one is run.\n";
+
+/*!
+ * The Bench struct holds the program memory and, right after it, the data
+ * memory the copies are made from, both in one buffer.
+ */
+typedef struct {
+  Flashboot_Context loader;
+  uint8_t workbuffer[4 * 1024]; /*!< Work buffer of a small device*/
+  Flashboot_Memory progMem;
+  Flashboot_Memory dataMem;
+  uint8_t *memory; /*!< Content of both memories*/
+  uint64_t size;   /*!< Size of both memories*/
+} Bench;
+
+/*!
+ * A helper timed over a memory geometry and an image size.
+ */
+typedef struct {
+  const char *name;
+  /*!
+   * Put the memories in the state the helper starts from, not timed.
+   */
+  void (*Prepare)(Bench *this, uint64_t size);
+  /*!
+   * Call the helper.
+   * @return See ::Flashboot_Result
+   */
+  Flashboot_eResult (*Run)(Bench *this, uint64_t size);
+} BenchCase;
+
+static uint8_t *GetMemAddr(Bench *this, uint64_t address, uint32_t size) {
+  if (address < this->progMem.startAddress ||
+      address + size > this->progMem.startAddress + this->size) {
+    return NULL;
+  }
+  return this->memory + (address - this->progMem.startAddress);
+}
+
+static uint32_t FlashWrite(void *arg, uint64_t address, uint8_t *data) {
+  Bench *this = (Bench *)arg;
+  uint8_t *memory = GetMemAddr(this, address, this->progMem.pageSize);
+
+  if (memory) {
+    memcpy(memory, data, this->progMem.pageSize);
+    return this->progMem.pageSize;
+  }
+  return 0;
+}
+
+static uint32_t FlashWriteBlock(void *arg, uint64_t address, uint8_t *data,
+                                uint32_t size) {
+  uint8_t *memory = GetMemAddr((Bench *)arg, address, size);
+
+  if (memory) {
+    memcpy(memory, data, size);
+    return size;
+  }
+  return 0;
+}
+
+static uint32_t FlashRead(void *arg, uint64_t address, uint8_t *data,
+                          uint32_t size) {
+  uint8_t *memory = GetMemAddr((Bench *)arg, address, size);
+
+  if (memory) {
+    memcpy(data, memory, size);
+  }
+  return size;
+}
+
+static uint32_t FlashErase(void *arg, uint64_t address) {
+  Bench *this = (Bench *)arg;
+  uint8_t *memory = GetMemAddr(this, address, this->progMem.sectorSize);
+
+  if (memory) {
+    memset(memory, 0xFF, this->progMem.sectorSize);
+  }
+  return this->progMem.sectorSize;
+}
+
+static uint32_t FlashProtect(void *arg, bool lock) { return 0; }
+
+static void CheckData(void *arg) {}
+
+static uint32_t SendData(void *arg, uint8_t *data, uint32_t size) {
+  return size;
+}
+
+static uint32_t CRCCalc(void *arg, uint32_t initValue, void *data,
+                        uint32_t size) {
+  return crc32(data, size, initValue);
+}
+
+static uint32_t Boot(void *arg, uint64_t address) { return 1; }
+
+static uint32_t GetTick(void *arg) { return 0; }
+
+static void SetError(void *arg, Flashboot_eResult error) {}
+
+static const Flashboot_Interface interface = {
+    .WriteMemPage = FlashWrite,
+    .WriteMem = FlashWriteBlock,
+    .ReadMem = FlashRead,
+    .EraseMemSector = FlashErase,
+    .ProtectMem = FlashProtect,
+    .CheckData = CheckData,
+    .SendData = SendData,
+    .CalcCRC = CRCCalc,
+    .Boot = Boot,
+    .GetTick = GetTick,
+    .SetError = SetError,
+};
+
+/*!
+ * Fill a range with the content of an image, no sector is blank.
+ */
+static void FillImage(Bench *this, uint64_t address, uint64_t size) {
+  uint8_t *memory = GetMemAddr(this, address, size);
+
+  for (uint64_t i = 0; i < size; i++) {
+    memory[i] = (uint8_t)(i * 31 + 7);
+  }
+}
+
+/*!
+ * MBR of an image at the start of a memory, the MBR follows the image.
+ */
+static Flashboot_MBR ImageMBR(Bench *this, const Flashboot_Memory *memory,
+                              uint64_t size) {
+  uint64_t mbrAddress = memory->startAddress + size;
+
+  mbrAddress += (MBR_ALINGMENT - mbrAddress % MBR_ALINGMENT) % MBR_ALINGMENT;
+  return (Flashboot_MBR){
+      .magicKey = MBR_MAGIC_KEY_V2,
+      .version = 1,
+      .loadAddress = memory->startAddress,
+      .bootAddress = this->progMem.startAddress,
+      .size = size,
+      .mbrAddress = mbrAddress,
+      .crc = crc32(GetMemAddr(this, memory->startAddress, size), size, 0),
+  };
+}
+
+static void PrepareImage(Bench *this, uint64_t size) {
+  FillImage(this, this->progMem.startAddress, size);
+}
+
+static void PrepareMBR(Bench *this, uint64_t size) {
+  Flashboot_MBR mbr;
+
+  PrepareImage(this, size);
+  mbr = ImageMBR(this, &this->progMem, size);
+  memcpy(GetMemAddr(this, mbr.mbrAddress, sizeof(mbr)), &mbr, sizeof(mbr));
+}
+
+static void PrepareCopy(Bench *this, uint64_t size) {
+  FillImage(this, this->progMem.startAddress, this->progMem.size);
+  FillImage(this, this->dataMem.startAddress, size);
+  this->loader.mbr = ImageMBR(this, &this->dataMem, size);
+}
+
+static Flashboot_eResult RunCalcCRC(Bench *this, uint64_t size) {
+  static volatile uint32_t crc;
+
+  crc = Flashboot_CalcCRC(&this->loader, this->progMem.startAddress, size);
+  return crc == 0 ? Flashboot_eCRCError : Flashboot_eOK;
+}
+
+static Flashboot_eResult RunMemoryErase(Bench *this, uint64_t size) {
+  return Flashboot_MemoryErase(&this->loader, this->progMem.startAddress,
+                               size);
+}
+
+static Flashboot_eResult RunMemoryWrite(Bench *this, uint64_t size) {
+  return Flashboot_MemoryWrite(
+      &this->loader, this->progMem.startAddress,
+      GetMemAddr(this, this->dataMem.startAddress, size), size);
+}
+
+static Flashboot_eResult RunSearchForMBR(Bench *this, uint64_t size) {
+  Flashboot_MBR mbr;
+
+  return Flashboot_SearchForMBR(&this->loader, &this->progMem, &mbr);
+}
+
+static Flashboot_eResult RunCopyToMemory(Bench *this, uint64_t size) {
+  Flashboot_MBR mbr = this->loader.mbr;
+
+  return Flashboot_CopyToMemory(&this->loader, &this->progMem, &mbr);
+}
+
+static const BenchCase cases[] = {
+    {"CalcCRC", PrepareImage, RunCalcCRC},
+    {"MemoryErase", PrepareImage, RunMemoryErase},
+    {"MemoryWrite", PrepareCopy, RunMemoryWrite},
+    {"SearchForMBR", PrepareMBR, RunSearchForMBR},
+    {"CopyToMemory", PrepareCopy, RunCopyToMemory},
+};
+
+static uint64_t Now(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int CompareTime(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+  return x < y ? -1 : x > y;
+}
+
+/*!
+ * Lay out both memories for an image size, the program memory has room for
+ * the image, its MBR and a partial sector.
+ */
+static Flashboot_eResult Setup(Bench *this, const FlashModel_Config *flash,
+                               uint64_t size) {
+  uint64_t sectors = size / flash->sectorSize + 2;
+
+  this->progMem = (Flashboot_Memory){.startAddress = 0x08000000};
+  FlashModel_Geometry(flash, &this->progMem);
+  this->progMem.size = sectors * flash->sectorSize;
+  this->dataMem = this->progMem;
+  this->dataMem.startAddress += this->progMem.size;
+  this->size = 2 * this->progMem.size;
+
+  this->memory = malloc(this->size);
+  Flashboot_ASSERT(this->memory == NULL, Flashboot_eBufferOverflowError);
+  memset(this->memory, 0xFF, this->size);
+
+  Flashboot_eResult result =
+      Flashboot_Initialize(&this->loader, this, &interface, &this->progMem,
+                           this->workbuffer, sizeof(this->workbuffer));
+  if (result == Flashboot_eOK) {
+    result = Flashboot_SetDataMemory(&this->loader, &this->dataMem);
+  }
+  return result;
+}
+
+int main(int argc, char **argv) {
+  static const struct option options[] = {
+      {"runs", required_argument, NULL, 'r'},
+      {"format", required_argument, NULL, 'f'},
+      {"output", required_argument, NULL, 'o'},
+      {"flash", required_argument, NULL, 'F'},
+      {"size", required_argument, NULL, 's'},
+      {NULL, 0, NULL, 0},
+  };
+  const char *flashes[] = {"stm32g4", "spi-nor"};
+  uint64_t sizes[] = {16 * 1024, 64 * 1024, 256 * 1024, 1024 * 1024};
+  uint32_t flashCount = 2, sizeCount = 4, runs = 15;
+  uint64_t time[BENCH_MAX_RUNS];
+  static Bench bench;
+  FILE *output = stdout;
+  bool json = true, first = true;
+  int option, failures = 0;
+
+  while ((option = getopt_long(argc, argv, "", options, NULL)) != -1) {
+    switch (option) {
+    case 'r':
+      runs = strtoul(optarg, NULL, 0);
+      break;
+    case 'f':
+      json = strcmp(optarg, "csv") != 0;
+      break;
+    case 'o':
+      output = fopen(optarg, "w");
+      break;
+    case 'F':
+      flashes[0] = optarg;
+      flashCount = 1;
+      break;
+    case 's':
+      sizes[0] = strtoull(optarg, NULL, 0);
+      sizeCount = 1;
+      break;
+    default:
+      fputs(usage, stderr);
+      return 2;
+    }
+  }
+  if (runs == 0 || runs > BENCH_MAX_RUNS || output == NULL ||
+      sizes[0] == 0 || sizes[0] > UINT32_MAX) {
+    fputs(usage, stderr);
+    return 2;
+  }
+
+  fputs(json ? "[\n"
+             : "function,flash,page,sector,size,runs,median_ns,min_ns,"
+               "max_ns,mib_s\n",
+        output);
+  for (uint32_t f = 0; f < flashCount; f++) {
+    const FlashModel_Config *flash = FlashModel_Find(flashes[f]);
+
+    for (uint32_t s = 0; flash && s < sizeCount; s++) {
+      if (Setup(&bench, flash, sizes[s]) != Flashboot_eOK) {
+        failures++;
+        continue;
+      }
+
+      for (uint32_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        Flashboot_eResult result = Flashboot_eOK;
+
+        /*The first run warms the caches and isn't counted*/
+        for (uint32_t r = 0; r <= runs; r++) {
+          uint64_t start;
+          Flashboot_eResult ret;
+
+          memset(bench.memory, 0, bench.size);
+          cases[c].Prepare(&bench, sizes[s]);
+          start = Now();
+          ret = cases[c].Run(&bench, sizes[s]);
+          if (r) {
+            time[r - 1] = Now() - start;
+          }
+          result = ret != Flashboot_eOK ? ret : result;
+        }
+        if (result != Flashboot_eOK) {
+          fprintf(stderr, "%s failed on %s with %" PRIu64 " bytes\n",
+                  cases[c].name, flash->name, sizes[s]);
+          failures++;
+        }
+
+        qsort(time, runs, sizeof(time[0]), CompareTime);
+        uint64_t median = time[runs / 2];
+        double rate = median ? sizes[s] * 1e9 / median / (1024 * 1024) : 0;
+        fprintf(output,
+                json ? "%s  {\"function\": \"%s\", \"flash\": \"%s\", "
+                       "\"page\": %u, \"sector\": %u, \"size\": %" PRIu64
+                       ", \"runs\": %u, \"median_ns\": %" PRIu64
+                       ", \"min_ns\": %" PRIu64 ", \"max_ns\": %" PRIu64
+                       ", \"mib_s\": %.1f}"
+                     : "%s%s,%s,%u,%u,%" PRIu64 ",%u,%" PRIu64 ",%" PRIu64
+                       ",%" PRIu64 ",%.1f\n",
+                json && !first ? ",\n" : "", cases[c].name, flash->name,
+                flash->pageSize, flash->sectorSize, sizes[s], runs, median,
+                time[0], time[runs - 1], rate);
+        first = false;
+      }
+      free(bench.memory);
+    }
+    failures += flash ? 0 : 1;
+  }
+  fputs(json ? "\n]\n" : "", output);
+
+  if (output != stdout) {
+    fclose(output);
+  }
+  return failures ? 1 : 0;
+}
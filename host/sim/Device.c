@@ -0,0 +1,158 @@
+// Copyright Douglas Santos Reis.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "Device.h"
+#include "crc.h"
+#include <stdlib.h>
+#include <string.h>
+
+static uint8_t *GetMemAddr(Device *this, uint64_t address, uint32_t size) {
+  if (address < this->memory.startAddress ||
+      address + size > this->memory.startAddress + this->memory.size) {
+    return NULL;
+  }
+  return this->flash + (address - this->memory.startAddress);
+}
+
+static uint32_t FlashWrite(void *arg, uint64_t address, uint8_t *data) {
+  Device *this = (Device *)arg;
+  uint8_t *memory = GetMemAddr(this, address, this->memory.pageSize);
+
+  if (this->model) {
+    FlashModel_Program(this->model, address, this->memory.pageSize);
+  }
+  if (memory) {
+    memcpy(memory, data, this->memory.pageSize);
+    return this->memory.pageSize;
+  }
+  return 0;
+}
+
+static uint32_t FlashWriteBlock(void *arg, uint64_t address, uint8_t *data,
+                                uint32_t size) {
+  Device *this = (Device *)arg;
+  uint8_t *memory = GetMemAddr(this, address, size);
+
+  if (this->model) {
+    FlashModel_Program(this->model, address, size);
+  }
+  if (memory) {
+    memcpy(memory, data, size);
+    return size;
+  }
+  return 0;
+}
+
+static uint32_t FlashRead(void *arg, uint64_t address, uint8_t *data,
+                          uint32_t size) {
+  Device *this = (Device *)arg;
+  uint8_t *memory = GetMemAddr(this, address, size);
+
+  if (this->model) {
+    FlashModel_Read(this->model, size);
+  }
+  if (memory) {
+    memcpy(data, memory, size);
+  }
+  return size;
+}
+
+static uint32_t FlashErase(void *arg, uint64_t address) {
+  Device *this = (Device *)arg;
+  uint8_t *memory = GetMemAddr(this, address, this->memory.sectorSize);
+
+  if (this->model) {
+    FlashModel_Erase(this->model);
+  }
+  if (memory) {
+    memset(memory, 0xFF, this->memory.sectorSize);
+  }
+  return this->memory.sectorSize;
+}
+
+static uint32_t FlashProtect(void *arg, bool lock) { return 0; }
+
+static void CheckData(void *arg) {
+  Device *this = (Device *)arg;
+  int32_t size = this->Receive(this->link, this->frame, sizeof(this->frame));
+
+  if (size > 0) {
+    Flashboot_ProcessProtocol(&this->loader, this->frame, size);
+  } else if (size < 0) {
+    /*The host closed the link*/
+    this->running = false;
+  }
+}
+
+static uint32_t SendData(void *arg, uint8_t *data, uint32_t size) {
+  Device *this = (Device *)arg;
+  return this->Send(this->link, data, size) < 0 ? 0 : size;
+}
+
+static uint32_t CRCCalc(void *arg, uint32_t initValue, void *data,
+                        uint32_t size) {
+  return crc32(data, size, initValue);
+}
+
+static uint32_t Boot(void *arg, uint64_t address) {
+  Device *this = (Device *)arg;
+
+  this->bootAddress = address;
+  this->running = false;
+  return 1;
+}
+
+static uint32_t GetTick(void *arg) {
+  Device *this = (Device *)arg;
+  return this->GetTick(this->link);
+}
+
+static void SetError(void *arg, Flashboot_eResult error) {}
+
+static const Flashboot_Interface interface = {
+    .WriteMemPage = FlashWrite,
+    .WriteMem = FlashWriteBlock,
+    .ReadMem = FlashRead,
+    .EraseMemSector = FlashErase,
+    .ProtectMem = FlashProtect,
+    .CheckData = CheckData,
+    .SendData = SendData,
+    .CalcCRC = CRCCalc,
+    .Boot = Boot,
+    .GetTick = GetTick,
+    .SetError = SetError,
+};
+
+Flashboot_eResult Device_Initialize(Device *this,
+                                    const Flashboot_Memory *memory) {
+  this->memory = *memory;
+  this->flash = malloc(memory->size);
+  Flashboot_ASSERT(this->flash == NULL, Flashboot_eBufferOverflowError);
+  memset(this->flash, 0xFF, memory->size);
+
+  return Device_Reset(this, true);
+}
+
+Flashboot_eResult Device_Reset(Device *this, bool commandMode) {
+  Flashboot_eResult result;
+
+  result = Flashboot_Initialize(&this->loader, this, &interface, &this->memory,
+                                this->workbuffer, sizeof(this->workbuffer));
+  if (result == Flashboot_eOK) {
+    result = Flashboot_SetCommandMode(&this->loader, commandMode);
+  }
+  this->bootAddress = 0;
+  this->running = result == Flashboot_eOK;
+  return result;
+}
+
+void Device_Step(void *arg) {
+  Device *this = (Device *)arg;
+  Flashboot_Execute(&this->loader);
+}
+
+void Device_Free(Device *this) {
+  free(this->flash);
+  this->flash = NULL;
+}
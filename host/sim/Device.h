@@ -0,0 +1,74 @@
+// Copyright Douglas Santos Reis.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef HOST_SIM_DEVICE_H_
+#define HOST_SIM_DEVICE_H_
+
+#include "FlashModel.h"
+#include <Flashboot.h>
+
+/*!
+ * The Device struct is a boot loader running on a program memory in RAM. The
+ * frames are exchanged through the link callbacks and the memory operations
+ * are accounted by the optional model, both set before ::Device_Initialize.
+ */
+typedef struct {
+  Flashboot_Context loader; /*!< Boot loader library object*/
+  uint8_t workbuffer[8 * 1024]; /*!< Work buffer, a sector of the presets
+                                     fits in it*/
+  Flashboot_Memory memory;  /*!< Program memory*/
+  uint8_t *flash;           /*!< Content of the program memory*/
+  uint8_t frame[sizeof(Flashboot_Frame)]; /*!< Last frame received*/
+  bool running;         /*!< Cleared when the application is booted or the
+                           link is closed*/
+  uint64_t bootAddress; /*!< Address of the application booted*/
+  FlashModel *model;    /*!< Cost of the memory operations, NULL for none*/
+  void *link;           /*!< Argument of the link callbacks*/
+  /*!
+   * Receive the next frame of the host.
+   * @return The frame size, 0 if none arrived, negative if the link closed.
+   */
+  int32_t (*Receive)(void *link, uint8_t *data, uint32_t size);
+  /*!
+   * Send a reply to the host.
+   * @return The size sent, negative on failure.
+   */
+  int32_t (*Send)(void *link, const uint8_t *data, uint32_t size);
+  /*!
+   * Current time in milliseconds.
+   */
+  uint32_t (*GetTick)(void *link);
+} Device;
+
+/*!
+ * @brief Start the boot loader on a blank program memory, in command mode.
+ * @param[in] this    Device with its link callbacks set.
+ * @param[in] memory  Geometry of the program memory.
+ * @return See ::Flashboot_Result
+ */
+Flashboot_eResult Device_Initialize(Device *this,
+                                    const Flashboot_Memory *memory);
+
+/*!
+ * @brief Restart the boot loader on the current program memory, as after a
+ * reset of the device.
+ * @param[in] this         Device initialized by ::Device_Initialize.
+ * @param[in] commandMode  Wait for the host instead of booting.
+ * @return See ::Flashboot_Result
+ */
+Flashboot_eResult Device_Reset(Device *this, bool commandMode);
+
+/*!
+ * @brief Execute a state of the boot loader.
+ * @param[in] arg  Device initialized by ::Device_Initialize.
+ */
+void Device_Step(void *arg);
+
+/*!
+ * @brief Release the program memory.
+ * @param[in] this  Device initialized by ::Device_Initialize.
+ */
+void Device_Free(Device *this);
+
+#endif /* HOST_SIM_DEVICE_H_ */
@@ -0,0 +1,103 @@
+// Copyright Douglas Santos Reis.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "FlashModel.h"
+#include <inttypes.h>
+#include <string.h>
+
+const FlashModel_Config FlashModel_Presets[] = {
+    {
+        .name = "ideal",
+        .pageSize = 8,
+        .programSize = 8,
+        .sectorSize = 2048,
+    },
+    {
+        .name = "stm32g4",
+        .pageSize = 8,
+        .programSize = 8,
+        .sectorSize = 2048,
+        .pageProgram = 82,
+        .sectorErase = 22000,
+        .readBandwidth = 100 * 1000 * 1000,
+        .overhead = 1,
+    },
+    {
+        .name = "spi-nor",
+        .pageSize = 8,
+        .programSize = 256,
+        .sectorSize = 4096,
+        .flags = FLASHBOOT_MEMORY_BIT_CLEAR,
+        .pageProgram = 700,
+        .sectorErase = 45000,
+        .readBandwidth = 50 * 1000 * 1000 / 8,
+        .overhead = 5,
+    },
+    {0},
+};
+
+/*!
+ * Add the time of an operation to the clock.
+ */
+static void Spend(FlashModel *this, uint64_t time) {
+  time += this->config->overhead;
+  this->stats.busy += time;
+  *this->clock += time;
+}
+
+const FlashModel_Config *FlashModel_Find(const char *name) {
+  for (const FlashModel_Config *config = FlashModel_Presets; config->name;
+       config++) {
+    if (strcmp(config->name, name) == 0) {
+      return config;
+    }
+  }
+  return NULL;
+}
+
+void FlashModel_Initialize(FlashModel *this, const FlashModel_Config *config,
+                           uint64_t *clock) {
+  memset(this, 0, sizeof(FlashModel));
+  this->config = config;
+  this->clock = clock;
+}
+
+void FlashModel_Geometry(const FlashModel_Config *config,
+                         Flashboot_Memory *memory) {
+  memory->pageSize = config->pageSize;
+  memory->sectorSize = config->sectorSize;
+  memory->writeBlockSize = config->programSize;
+  memory->flags = config->flags;
+}
+
+void FlashModel_Program(FlashModel *this, uint64_t address, uint32_t size) {
+  uint32_t page = this->config->programSize;
+
+  for (uint64_t i = address / page; size && i <= (address + size - 1) / page;
+       i++) {
+    this->stats.programs++;
+    Spend(this, this->config->pageProgram);
+  }
+}
+
+void FlashModel_Erase(FlashModel *this) {
+  this->stats.erases++;
+  Spend(this, this->config->sectorErase);
+}
+
+void FlashModel_Read(FlashModel *this, uint32_t size) {
+  uint32_t bandwidth = this->config->readBandwidth;
+
+  this->stats.reads++;
+  this->stats.readBytes += size;
+  Spend(this, bandwidth ? (uint64_t)size * 1000000 / bandwidth : 0);
+}
+
+void FlashModel_Report(const FlashModel *this, FILE *output) {
+  fprintf(output,
+          "Flash %s: programs=%" PRIu64 " erases=%" PRIu64 " reads=%" PRIu64
+          " readBytes=%" PRIu64 " busy=%" PRIu64 " us\n",
+          this->config->name, this->stats.programs, this->stats.erases,
+          this->stats.reads, this->stats.readBytes, this->stats.busy);
+}
@@ -0,0 +1,107 @@
+// Copyright Douglas Santos Reis.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef HOST_SIM_FLASHMODEL_H_
+#define HOST_SIM_FLASHMODEL_H_
+
+#include <Flashboot_Types.h>
+#include <stdio.h>
+
+/*!
+ * The FlashModel_Config struct defines the geometry of a memory and the time
+ * of its operations, typical values of the datasheets.
+ */
+typedef struct {
+  const char *name;       /*!< Name of the preset*/
+  uint32_t pageSize;      /*!< Smallest write, the page of the loader*/
+  uint32_t programSize;   /*!< Bytes programmed by a page program, the writes
+                             are done in blocks of this size*/
+  uint32_t sectorSize;    /*!< Bytes erased by a sector erase*/
+  uint32_t flags;         /*!< Memory features of the loader*/
+  uint32_t pageProgram;   /*!< Microseconds to program a page*/
+  uint32_t sectorErase;   /*!< Microseconds to erase a sector*/
+  uint32_t readBandwidth; /*!< Bytes read per second, 0 for no cost*/
+  uint32_t overhead; /*!< Microseconds added to each command, as the opcode,
+                        the address and the status polling of a SPI memory*/
+} FlashModel_Config;
+
+/*!
+ * Presets, terminated by a preset without name:
+ * - ideal: operations without cost, the geometry of the simulator.
+ * - stm32g4: internal flash of a STM32G4, double word program, 2 KiB pages
+ *   erase and reads with wait states.
+ * - spi-nor: serial NOR as a W25Q128 at 50 MHz single SPI, 256 bytes pages
+ *   and 4 KiB sectors.
+ */
+extern const FlashModel_Config FlashModel_Presets[];
+
+/*!
+ * The FlashModel struct adds the time of the operations done on a memory to
+ * a virtual clock and counts them.
+ */
+typedef struct {
+  const FlashModel_Config *config;
+  uint64_t *clock; /*!< Virtual time in microseconds*/
+  struct {
+    uint64_t programs;  /*!< Pages programmed*/
+    uint64_t erases;    /*!< Sectors erased*/
+    uint64_t reads;     /*!< Read commands*/
+    uint64_t readBytes; /*!< Bytes read*/
+    uint64_t busy;      /*!< Microseconds spent by the memory*/
+  } stats;
+} FlashModel;
+
+/*!
+ * @brief Find a preset by its name.
+ * @param[in] name  Name of the preset.
+ * @return The preset, NULL if there's none with the name.
+ */
+const FlashModel_Config *FlashModel_Find(const char *name);
+
+/*!
+ * @brief Initialize a model, the counters start at 0.
+ * @param[in] this    Model to be initialized.
+ * @param[in] config  Costs of the memory.
+ * @param[in] clock   Virtual time advanced by the operations.
+ */
+void FlashModel_Initialize(FlashModel *this, const FlashModel_Config *config,
+                           uint64_t *clock);
+
+/*!
+ * @brief Fill the geometry of a memory with the one of a preset.
+ * @param[in] config   Preset.
+ * @param[out] memory  Memory, its address and size are kept.
+ */
+void FlashModel_Geometry(const FlashModel_Config *config,
+                         Flashboot_Memory *memory);
+
+/*!
+ * @brief Account a write, a page program for each page it reaches.
+ * @param[in] this     Model initialized.
+ * @param[in] address  Address written.
+ * @param[in] size     Bytes written.
+ */
+void FlashModel_Program(FlashModel *this, uint64_t address, uint32_t size);
+
+/*!
+ * @brief Account a sector erase.
+ * @param[in] this  Model initialized.
+ */
+void FlashModel_Erase(FlashModel *this);
+
+/*!
+ * @brief Account a read.
+ * @param[in] this  Model initialized.
+ * @param[in] size  Bytes read.
+ */
+void FlashModel_Read(FlashModel *this, uint32_t size);
+
+/*!
+ * @brief Print the counters and the time spent by the memory.
+ * @param[in] this    Model initialized.
+ * @param[in] output  Stream the report is printed to.
+ */
+void FlashModel_Report(const FlashModel *this, FILE *output);
+
+#endif /* HOST_SIM_FLASHMODEL_H_ */
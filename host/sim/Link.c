@@ -0,0 +1,163 @@
+// Copyright Douglas Santos Reis.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "Link.h"
+#include <math.h>
+#include <string.h>
+
+/*!
+ * Uniform random number in [0, 1), xorshift32.
+ */
+static double Random(Link *this) {
+  this->random ^= this->random << 13;
+  this->random ^= this->random >> 17;
+  this->random ^= this->random << 5;
+  return this->random / 4294967296.0;
+}
+
+/*!
+ * Put a frame on the wire, it's delivered after its bytes and the latency.
+ * @param this       Link initialized by ::Link_Initialize function.
+ * @param channel    Direction of the frame
+ * @param data       Frame
+ * @param size       Frame size
+ */
+static void Transmit(Link *this, Link_Channel *channel, const uint8_t *data,
+                     uint32_t size) {
+  uint32_t mtu = this->config.mtu;
+  uint64_t fragments = mtu && size > mtu ? (size + mtu - 1) / mtu : 1;
+  uint64_t wire = size + LINK_FRAGMENT_HEADER * fragments;
+  uint64_t start = channel->free > this->now ? channel->free : this->now;
+
+  channel->free = start + wire * 10 * 1000000 / this->config.baud;
+  this->stats.frames++;
+  this->stats.bytes += size;
+  this->stats.wireBytes += wire;
+
+  /*The frame check of the link drops a frame with any bit flipped*/
+  if (this->config.bitErrorRate > 0 &&
+      Random(this) < 1 - pow(1 - this->config.bitErrorRate, wire * 8)) {
+    this->stats.dropped++;
+    return;
+  }
+  if (channel->count == LINK_MAX_FRAMES ||
+      size > sizeof(((Link_Frame *)0)->data)) {
+    this->stats.dropped++;
+    return;
+  }
+
+  Link_Frame *frame =
+      &channel->frame[(channel->head + channel->count) % LINK_MAX_FRAMES];
+  frame->arrival = channel->free + this->config.latency;
+  frame->size = size;
+  memcpy(frame->data, data, size);
+  channel->count++;
+}
+
+/*!
+ * Take the next frame of a direction if it was delivered.
+ * @return The frame size, 0 if none was delivered yet.
+ */
+static int32_t Deliver(Link *this, Link_Channel *channel, uint8_t *data,
+                       uint32_t size) {
+  Link_Frame *frame = &channel->frame[channel->head];
+
+  if (channel->count == 0 || frame->arrival > this->now) {
+    return 0;
+  }
+  size = frame->size < size ? frame->size : size;
+  memcpy(data, frame->data, size);
+  channel->head = (channel->head + 1) % LINK_MAX_FRAMES;
+  channel->count--;
+  return size;
+}
+
+static int32_t Send(void *arg, const uint8_t *data, uint32_t size) {
+  Link *this = (Link *)arg;
+
+  Transmit(this, &this->toDevice, data, size);
+  return size;
+}
+
+/*!
+ * Run the device until a reply is delivered to the host, jumping the time
+ * to the next delivery once the device is idle.
+ */
+static int32_t Receive(void *arg, uint8_t *data, uint32_t size,
+                       uint32_t timeout) {
+  Link *this = (Link *)arg;
+  uint64_t deadline = this->now + (uint64_t)timeout * 1000;
+  uint32_t idle = 0;
+
+  while (true) {
+    int32_t length = Deliver(this, &this->toHost, data, size);
+    Link_Frame *next = &this->toDevice.frame[this->toDevice.head];
+    uint64_t event = UINT64_MAX;
+
+    if (length) {
+      return length;
+    }
+
+    /*The device runs until it stops taking frames and sending replies*/
+    if (idle < LINK_IDLE_STEPS) {
+      uint32_t pending = this->toDevice.count, replies = this->toHost.count;
+
+      this->Step(this->device);
+      idle = pending != this->toDevice.count ||
+                     replies != this->toHost.count
+                 ? 0
+                 : idle + 1;
+      continue;
+    }
+
+    if (this->toHost.count) {
+      event = this->toHost.frame[this->toHost.head].arrival;
+    }
+    if (this->toDevice.count && next->arrival > this->now &&
+        next->arrival < event) {
+      event = next->arrival;
+    }
+    if (event > deadline) {
+      this->now = deadline > this->now ? deadline : this->now;
+      return 0;
+    }
+    this->now = event > this->now ? event : this->now;
+    idle = 0;
+  }
+}
+
+static uint64_t GetTime(void *arg) { return ((Link *)arg)->now; }
+
+void Link_Initialize(Link *this, const Link_Config *config,
+                     void (*Step)(void *arg), void *device) {
+  memset(this, 0, sizeof(Link));
+  this->config = *config;
+  this->random = config->seed ? config->seed : 1;
+  this->Step = Step;
+  this->device = device;
+}
+
+void Link_Bind(Link *this, Flasher_Interface *interface) {
+  interface->arg = this;
+  interface->Send = Send;
+  interface->Receive = Receive;
+  interface->GetTime = GetTime;
+}
+
+int32_t Link_DeviceReceive(void *this, uint8_t *data, uint32_t size) {
+  return Deliver((Link *)this, &((Link *)this)->toDevice, data, size);
+}
+
+int32_t Link_DeviceSend(void *this, const uint8_t *data, uint32_t size) {
+  Transmit((Link *)this, &((Link *)this)->toHost, data, size);
+  return size;
+}
+
+uint32_t Link_DeviceTick(void *this) {
+  return (uint32_t)(((Link *)this)->now / 1000);
+}
+
+void Link_Advance(Link *this, uint64_t time) { this->now += time; }
+
+double Link_Capacity(const Link *this) { return this->config.baud / 10.0; }
@@ -0,0 +1,136 @@
+// Copyright Douglas Santos Reis.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef HOST_SIM_LINK_H_
+#define HOST_SIM_LINK_H_
+
+#include "Flasher.h"
+
+/*!
+ * Frames queued in each direction of the link, more are dropped.
+ */
+#define LINK_MAX_FRAMES 64
+
+/*!
+ * Header of each fragment on the wire, the size prefix of ::Transport.
+ */
+#define LINK_FRAGMENT_HEADER 2
+
+/*!
+ * Steps of the device without taking or sending a frame after which it's
+ * considered waiting for the host.
+ */
+#define LINK_IDLE_STEPS 64
+
+/*!
+ * The Link_Config struct describes a serial link.
+ */
+typedef struct {
+  uint32_t baud;    /*!< Bits per second, each byte takes 10 bits*/
+  uint32_t latency; /*!< Microseconds from the end of a frame on the wire to
+                       its delivery*/
+  uint32_t mtu; /*!< Biggest fragment, bigger frames are split and each
+                   fragment takes a ::LINK_FRAGMENT_HEADER. 0 for no limit*/
+  double bitErrorRate; /*!< Probability of each bit on the wire to flip, the
+                          frame check of the link drops a frame with errors*/
+  uint32_t seed;       /*!< Seed of the bit errors, runs are repeatable*/
+} Link_Config;
+
+/*!
+ * A frame on the way to the other end.
+ */
+typedef struct {
+  uint64_t arrival; /*!< Time it's delivered*/
+  uint32_t size;    /*!< Frame size*/
+  uint8_t data[sizeof(Flashboot_Frame)];
+} Link_Frame;
+
+/*!
+ * A direction of the link.
+ */
+typedef struct {
+  Link_Frame frame[LINK_MAX_FRAMES];
+  uint32_t head;  /*!< Next frame to be delivered*/
+  uint32_t count; /*!< Frames on the way*/
+  uint64_t free;  /*!< Time the wire finishes the frames sent*/
+} Link_Channel;
+
+/*!
+ * The Link struct connects a host flasher to a device loop in a virtual time.
+ * The device runs only while it has frames to take, so the time is the one
+ * spent on the wire and by the device costs added with ::Link_Advance.
+ */
+typedef struct {
+  Link_Config config;
+  uint64_t now;           /*!< Virtual time in microseconds*/
+  Link_Channel toDevice;  /*!< Frames sent by the host*/
+  Link_Channel toHost;    /*!< Frames sent by the device*/
+  uint32_t random;        /*!< State of the bit errors generator*/
+  void (*Step)(void *arg); /*!< Execute a step of the device*/
+  void *device;           /*!< Argument of Step*/
+  struct {
+    uint64_t frames;    /*!< Frames sent in both directions*/
+    uint64_t bytes;     /*!< Bytes of the frames sent*/
+    uint64_t wireBytes; /*!< Bytes on the wire, with the fragment headers*/
+    uint64_t dropped;   /*!< Frames dropped by bit errors or a full queue*/
+  } stats;
+} Link;
+
+/*!
+ * @brief Initialize a link, the time starts at 0.
+ * @param[in] this    Link to be initialized.
+ * @param[in] config  Link parameters.
+ * @param[in] Step    Execute a step of the device.
+ * @param[in] device  Argument of Step.
+ */
+void Link_Initialize(Link *this, const Link_Config *config,
+                     void (*Step)(void *arg), void *device);
+
+/*!
+ * @brief Fill the link and the clock of a ::Flasher_Interface with the host
+ * end of the link, the CRC is left to the caller.
+ * @param[in] this       Link initialized.
+ * @param[out] interface Interface used by the flasher.
+ */
+void Link_Bind(Link *this, Flasher_Interface *interface);
+
+/*!
+ * @brief Take the next frame delivered to the device.
+ * @param[in] this   Link initialized.
+ * @param[out] data  Receives the frame.
+ * @param[in] size   Buffer size.
+ * @return The frame size, 0 if none was delivered yet.
+ */
+int32_t Link_DeviceReceive(void *this, uint8_t *data, uint32_t size);
+
+/*!
+ * @brief Send a frame from the device to the host.
+ * @param[in] this  Link initialized.
+ * @param[in] data  Frame.
+ * @param[in] size  Frame size.
+ * @return The frame size.
+ */
+int32_t Link_DeviceSend(void *this, const uint8_t *data, uint32_t size);
+
+/*!
+ * @brief Current time in milliseconds, for the device.
+ * @param[in] this  Link initialized.
+ */
+uint32_t Link_DeviceTick(void *this);
+
+/*!
+ * @brief Advance the time, for the work done by the device.
+ * @param[in] this  Link initialized.
+ * @param[in] time  Microseconds spent.
+ */
+void Link_Advance(Link *this, uint64_t time);
+
+/*!
+ * @brief Payload the link carries in each direction.
+ * @param[in] this  Link initialized.
+ * @return Bytes per second.
+ */
+double Link_Capacity(const Link *this);
+
+#endif /* HOST_SIM_LINK_H_ */
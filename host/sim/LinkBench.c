@@ -0,0 +1,209 @@
+// Copyright Douglas Santos Reis.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+
+/*
+ * End-to-end update through a simulated link, the throughput achieved is
+ * compared to the capacity of the link for each combination of baud rate,
+ * latency and window. The memory operations take the time of a flash preset
+ * and the device is then reset to time its boot.
+ */
+
+#include "Device.h"
+#include "Link.h"
+#include "crc.h"
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char usage[] =
+    "usage: flashbootLinkBench [--baud <bps>] [--latency <us>] [--window <n>]\n"
+    "                          [--mtu <bytes>] [--ber <rate>] [--seed <n>]\n"
+    "                          [--size <bytes>] [--packet <bytes>]\n"
+    "                          [--timeout <ms>] [--retries <n>]\n"
+    "                          [--flash ideal|stm32g4|spi-nor]\n"
+    "Without --baud, --latency or --window a range of each one is run.\n";
+
+static uint32_t CalcCRC(void *arg, uint32_t initValue, const void *data,
+                        uint32_t size) {
+  return crc32(data, size, initValue);
+}
+
+/*!
+ * Update a blank device through the link, boot it and print a row of the
+ * results.
+ */
+static int Run(const Link_Config *config, uint8_t window,
+               const Flasher_Context *settings, const FlashModel_Config *flash,
+               Flasher_Image *image) {
+  static Flasher_Context flasher;
+  static FlashModel model;
+  static Device device;
+  static Link link;
+  Flasher_Interface interface = {.CalcCRC = CalcCRC};
+  Flashboot_Memory memory = {
+      .startAddress = image->address,
+      .size = (image->size / flash->sectorSize + 2) * flash->sectorSize,
+  };
+  Flashboot_eResult result;
+
+  FlashModel_Geometry(flash, &memory);
+  device = (Device){
+      .link = &link,
+      .Receive = Link_DeviceReceive,
+      .Send = Link_DeviceSend,
+      .GetTick = Link_DeviceTick,
+      .model = &model,
+  };
+  Link_Initialize(&link, config, Device_Step, &device);
+  FlashModel_Initialize(&model, flash, &link.now);
+  Link_Bind(&link, &interface);
+  if (Device_Initialize(&device, &memory) != Flashboot_eOK) {
+    return 1;
+  }
+  /*An older image is replaced, none of the sectors is blank*/
+  memset(device.flash, 0, memory.size);
+
+  Flasher_Initialize(&flasher, &interface);
+  flasher.window = window;
+  flasher.retries = settings->retries;
+  flasher.timeout = settings->timeout;
+  flasher.packetSize = settings->packetSize;
+  result = Flasher_Update(&flasher, image);
+
+  uint64_t elapsed = flasher.endTime - flasher.startTime;
+  double achieved = elapsed ? flasher.bytes * 1e6 / elapsed : 0;
+  double capacity = Link_Capacity(&link);
+  uint64_t programs = model.stats.programs, erases = model.stats.erases;
+  uint64_t readBytes = model.stats.readBytes, start = link.now;
+
+  /*The boot checks the image written, the steps are bounded in case the
+   * device waits for the host instead*/
+  if (result == Flashboot_eOK) {
+    Device_Reset(&device, false);
+    for (uint32_t i = 0; device.running && i < 1000000; i++) {
+      Device_Step(&device);
+    }
+  }
+
+  printf("%8u %8u %6u %6d %10.3f %10.1f %10.1f %6.1f%% %7u %7lu %9.1f "
+         "%8lu %6lu %8lu\n",
+         config->baud, config->latency, window, result, elapsed / 1e6,
+         capacity / 1024, achieved / 1024, 100 * achieved / capacity,
+         flasher.command[Flashboot_UpdateTransfer].retries,
+         link.stats.dropped, (link.now - start) / 1e3, programs, erases,
+         readBytes / 1024);
+
+  Device_Free(&device);
+  return result == Flashboot_eOK && device.bootAddress ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+  static const struct option options[] = {
+      {"baud", required_argument, NULL, 'b'},
+      {"latency", required_argument, NULL, 'l'},
+      {"window", required_argument, NULL, 'w'},
+      {"mtu", required_argument, NULL, 'm'},
+      {"ber", required_argument, NULL, 'e'},
+      {"seed", required_argument, NULL, 's'},
+      {"size", required_argument, NULL, 'S'},
+      {"packet", required_argument, NULL, 'p'},
+      {"timeout", required_argument, NULL, 't'},
+      {"retries", required_argument, NULL, 'r'},
+      {"flash", required_argument, NULL, 'f'},
+      {NULL, 0, NULL, 0},
+  };
+  uint32_t bauds[] = {115200, 921600, 12000000};
+  uint32_t latencies[] = {0, 1000, 4000};
+  uint32_t windows[] = {1, 4, 16};
+  uint32_t baudCount = 3, latencyCount = 3, windowCount = 3;
+  Link_Config config = {.seed = 1};
+  const FlashModel_Config *flash = FlashModel_Presets;
+  static Flasher_Context settings;
+  Flasher_Image image = {.address = 0x08000000, .size = 64 * 1024};
+  int option, failures = 0;
+
+  /*Only the settings of the flasher are taken, it has no interface*/
+  Flasher_Initialize(&settings, &(Flasher_Interface){0});
+
+  while ((option = getopt_long(argc, argv, "", options, NULL)) != -1) {
+    switch (option) {
+    case 'b':
+      bauds[0] = strtoul(optarg, NULL, 0);
+      baudCount = 1;
+      break;
+    case 'l':
+      latencies[0] = strtoul(optarg, NULL, 0);
+      latencyCount = 1;
+      break;
+    case 'w':
+      windows[0] = strtoul(optarg, NULL, 0);
+      windowCount = 1;
+      break;
+    case 'm':
+      config.mtu = strtoul(optarg, NULL, 0);
+      break;
+    case 'e':
+      config.bitErrorRate = strtod(optarg, NULL);
+      break;
+    case 's':
+      config.seed = strtoul(optarg, NULL, 0);
+      break;
+    case 'S':
+      image.size = strtoull(optarg, NULL, 0);
+      break;
+    case 'p':
+      settings.packetSize = strtoul(optarg, NULL, 0);
+      break;
+    case 't':
+      settings.timeout = strtoul(optarg, NULL, 0);
+      break;
+    case 'r':
+      settings.retries = strtoul(optarg, NULL, 0);
+      break;
+    case 'f':
+      flash = FlashModel_Find(optarg);
+      break;
+    default:
+      fputs(usage, stderr);
+      return 2;
+    }
+  }
+  if (flash == NULL || bauds[0] == 0 || windows[0] == 0 ||
+      windows[0] > FLASHER_MAX_WINDOW || settings.packetSize == 0 ||
+      settings.packetSize > PACKET_SIZE) {
+    fputs(usage, stderr);
+    return 2;
+  }
+
+  /*The content doesn't change the time, only the size does*/
+  image.data = malloc(image.size);
+  if (image.data == NULL) {
+    return 1;
+  }
+  for (uint64_t i = 0; i < image.size; i++) {
+    image.data[i] = (uint8_t)(i * 31 + 7);
+  }
+
+  printf("Image %" PRIu64 " bytes, packets of %u bytes, MTU %u, "
+         "bit error rate %g, %s flash\n",
+         image.size, settings.packetSize, config.mtu, config.bitErrorRate,
+         flash->name);
+  printf("%8s %8s %6s %6s %10s %10s %10s %7s %7s %7s %9s %8s %6s %8s\n",
+         "Baud", "Lat us", "Window", "Result", "Time s", "Cap KiB/s",
+         "Got KiB/s", "Eff", "Retries", "Dropped", "Boot ms", "Programs",
+         "Erases", "Read KiB");
+  for (uint32_t b = 0; b < baudCount; b++) {
+    for (uint32_t l = 0; l < latencyCount; l++) {
+      for (uint32_t w = 0; w < windowCount; w++) {
+        config.baud = bauds[b];
+        config.latency = latencies[l];
+        failures += Run(&config, windows[w], &settings, flash, &image);
+      }
+    }
+  }
+
+  free(image.data);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,87 @@
+// Copyright Douglas Santos Reis.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+
+/*
+ * Boot loader running on a memory in RAM, the frames are exchanged through
+ * the standard input and output as by ::Transport_Spawn. It stands for a
+ * device in the tests of the host tools.
+ */
+
+#include "Device.h"
+#include "Transport.h"
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+static int32_t Receive(void *link, uint8_t *data, uint32_t size) {
+  return Transport_ReadFrame(STDIN_FILENO, data, size, 1);
+}
+
+static int32_t Send(void *link, const uint8_t *data, uint32_t size) {
+  return Transport_WriteFrame(STDOUT_FILENO, data, size);
+}
+
+static uint32_t GetTick(void *link) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000 + ts.tv_nsec / (1000 * 1000);
+}
+
+int main(int argc, char **argv) {
+  static const struct option options[] = {
+      {"address", required_argument, NULL, 'a'},
+      {"size", required_argument, NULL, 's'},
+      {"page", required_argument, NULL, 'p'},
+      {"sector", required_argument, NULL, 'S'},
+      {NULL, 0, NULL, 0},
+  };
+  static Device device = {
+      .Receive = Receive,
+      .Send = Send,
+      .GetTick = GetTick,
+  };
+  Flashboot_Memory memory = {
+      .startAddress = 0x08000000,
+      .size = 256 * 1024,
+      .pageSize = 8,
+      .sectorSize = 2048,
+  };
+  int option;
+
+  while ((option = getopt_long(argc, argv, "", options, NULL)) != -1) {
+    switch (option) {
+    case 'a':
+      memory.startAddress = strtoull(optarg, NULL, 0);
+      break;
+    case 's':
+      memory.size = strtoull(optarg, NULL, 0);
+      break;
+    case 'p':
+      memory.pageSize = strtoul(optarg, NULL, 0);
+      break;
+    case 'S':
+      memory.sectorSize = strtoul(optarg, NULL, 0);
+      break;
+    default:
+      fprintf(stderr, "usage: flashbootSim [--address <address>] "
+                      "[--size <bytes>] [--page <bytes>] [--sector <bytes>]\n");
+      return 2;
+    }
+  }
+
+  if (Device_Initialize(&device, &memory) != Flashboot_eOK) {
+    return 1;
+  }
+  while (device.running) {
+    Device_Step(&device);
+  }
+  if (device.bootAddress) {
+    fprintf(stderr, "Boot=0x%" PRIX64 "\n", device.bootAddress);
+  }
+  Device_Free(&device);
+  return 0;
+}
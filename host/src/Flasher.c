@@ -0,0 +1,417 @@
+// Copyright Douglas Santos Reis.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "Flasher.h"
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*!
+ * A transfer packet waiting for its reply.
+ */
+typedef struct {
+  uint64_t offset;   /*!< Packet offset in the image*/
+  uint32_t size;     /*!< Packet size*/
+  uint64_t sentTime; /*!< Time the packet was sent, for its latency*/
+} Pending;
+
+static const char *commandName[FLASHER_COMMANDS] = {
+    [Flashboot_GetVersion] = "GetVersion",
+    [Flashboot_BootApplication] = "BootApplication",
+    [Flashboot_UpdateStart] = "UpdateStart",
+    [Flashboot_UpdateTransfer] = "UpdateTransfer",
+    [Flashboot_UpdateFinish] = "UpdateFinish",
+    [Flashboot_Result] = "Result",
+    [Flashboot_RangeCRC] = "RangeCRC",
+    [Flashboot_UpdateFill] = "UpdateFill",
+    [Flashboot_ReadMemory] = "ReadMemory",
+    [Flashboot_ReadData] = "ReadData",
+    [Flashboot_ReadAck] = "ReadAck",
+    [Flashboot_Batch] = "Batch",
+    [Flashboot_UpdateResume] = "UpdateResume",
+    [Flashboot_UpdateManifest] = "UpdateManifest",
+    [Flashboot_GenerationList] = "GenerationList",
+    [Flashboot_GenerationRestore] = "GenerationRestore",
+    [Flashboot_GetStats] = "GetStats",
+};
+
+static const char *stateName[Flashboot_StateCount] = {
+    [Flashboot_StateIdle] = "Idle",
+    [Flashboot_StateGetVersion] = "GetVersion",
+    [Flashboot_StateBoot] = "Boot",
+    [Flashboot_StateUpdateStart] = "UpdateStart",
+    [Flashboot_StateUpdateTransfer] = "UpdateTransfer",
+    [Flashboot_StateUpdateFinish] = "UpdateFinish",
+    [Flashboot_StateUpdateResume] = "UpdateResume",
+    [Flashboot_StateUpdateManifest] = "UpdateManifest",
+    [Flashboot_StateGenerationList] = "GenerationList",
+    [Flashboot_StateGenerationRestore] = "GenerationRestore",
+    [Flashboot_StateUpdateFill] = "UpdateFill",
+    [Flashboot_StateRangeCRC] = "RangeCRC",
+    [Flashboot_StateReadMemory] = "ReadMemory",
+    [Flashboot_StateReadStream] = "ReadStream",
+    [Flashboot_StateReadAck] = "ReadAck",
+    [Flashboot_StateBatch] = "Batch",
+    [Flashboot_StateCheckCRC] = "CheckCRC",
+    [Flashboot_StateCheckProgramMemory] = "CheckProgramMemory",
+    [Flashboot_StateCheckDataMemory] = "CheckDataMemory",
+    [Flashboot_StateCheckBackupMemory] = "CheckBackupMemory",
+    [Flashboot_StateBackupFW] = "BackupFW",
+    [Flashboot_StateGetStats] = "GetStats",
+};
+
+static uint64_t GetTime(Flasher_Context *this) {
+  return this->interface->GetTime(this->interface->arg);
+}
+
+/*!
+ * Record the latency of a reply.
+ * @param this       Struct initialized by ::Flasher_Initialize function.
+ * @param id         Command replied
+ * @param sentTime   Time the command was sent
+ */
+static void Record(Flasher_Context *this, Flashboot_CmdId id,
+                   uint64_t sentTime) {
+  Flasher_CommandStats *stats = &this->command[id];
+
+  stats->latency[stats->samples % FLASHER_MAX_SAMPLES] =
+      (uint32_t)(GetTime(this) - sentTime);
+  stats->samples++;
+  stats->count++;
+}
+
+static Flashboot_eResult Send(Flasher_Context *this, Flashboot_Frame *frame,
+                              uint32_t size) {
+  int32_t sent =
+      this->interface->Send(this->interface->arg, (uint8_t *)frame, size);
+  return sent == (int32_t)size ? Flashboot_eOK : Flashboot_eGeneralError;
+}
+
+/*!
+ * Wait for the next reply of the boot loader.
+ * @param this       Struct initialized by ::Flasher_Initialize function.
+ * @param reply      Receives the reply
+ * @return           ::Flashboot_eTimeoutError if it didn't arrive in time.
+ */
+static Flashboot_eResult Receive(Flasher_Context *this,
+                                 Flashboot_Frame *reply) {
+  int32_t size = this->interface->Receive(
+      this->interface->arg, (uint8_t *)reply, sizeof(*reply), this->timeout);
+
+  Flashboot_ASSERT(size < 0, Flashboot_eGeneralError);
+  Flashboot_ASSERT(size == 0, Flashboot_eTimeoutError);
+  return Flashboot_eOK;
+}
+
+/*!
+ * Result replied by the boot loader.
+ */
+static Flashboot_eResult ReplyResult(const Flashboot_Frame *reply) {
+  Flashboot_ASSERT(reply->id != Flashboot_Result, Flashboot_eProtocolError);
+  return (Flashboot_eResult)(int8_t)reply->payload.Result.result;
+}
+
+/*!
+ * Send a command and wait for its reply, the command is sent again if the
+ * reply doesn't arrive in time.
+ * @param this       Struct initialized by ::Flasher_Initialize function.
+ * @param frame      Command
+ * @param size       Command size
+ * @param reply      Receives the reply
+ * @return
+ */
+static Flashboot_eResult Request(Flasher_Context *this, Flashboot_Frame *frame,
+                                 uint32_t size, Flashboot_Frame *reply) {
+  Flashboot_eResult result = Flashboot_eTimeoutError;
+
+  for (uint8_t i = 0; result == Flashboot_eTimeoutError && i <= this->retries;
+       i++) {
+    uint64_t sentTime = GetTime(this);
+
+    this->command[frame->id].retries += i ? 1 : 0;
+    result = Send(this, frame, size);
+    if (result == Flashboot_eOK) {
+      result = Receive(this, reply);
+    }
+    if (result == Flashboot_eOK) {
+      Record(this, frame->id, sentTime);
+    }
+  }
+  return result;
+}
+
+static Flashboot_eResult SendPacket(Flasher_Context *this,
+                                    const Flasher_Image *image,
+                                    Pending *packet) {
+  Flashboot_Frame frame = {.id = Flashboot_UpdateTransfer};
+  uint32_t header = sizeof(frame.id) +
+                    sizeof(frame.payload.updateTransfer.packetID) +
+                    sizeof(frame.payload.updateTransfer.offset) +
+                    sizeof(frame.payload.updateTransfer.crc);
+  const uint8_t *data = image->data + packet->offset;
+
+  FLASHBOOT_U16_TO_ARRAY(packet->offset / this->packetSize,
+                         frame.payload.updateTransfer.packetID);
+  FLASHBOOT_U64_TO_ARRAY(packet->offset, frame.payload.updateTransfer.offset);
+  FLASHBOOT_U32_TO_ARRAY(this->interface->CalcCRC(this->interface->arg, 0,
+                                                  data, packet->size),
+                         frame.payload.updateTransfer.crc);
+  memcpy(frame.payload.updateTransfer.packet, data, packet->size);
+
+  packet->sentTime = GetTime(this);
+  return Send(this, &frame, header + packet->size);
+}
+
+/*!
+ * Transfer the image, the replies arrive in the order the packets were sent.
+ * The loader writes only the packet at its current offset, so a packet lost
+ * or rejected is sent again together with the ones after it, go-back-N, and
+ * the replies of the ones in flight are dropped.
+ * @param this       Struct initialized by ::Flasher_Initialize function.
+ * @param image      Image to be transferred
+ * @return
+ */
+static Flashboot_eResult Transfer(Flasher_Context *this,
+                                  const Flasher_Image *image) {
+  Flasher_CommandStats *stats = &this->command[Flashboot_UpdateTransfer];
+  Pending pending[FLASHER_MAX_WINDOW];
+  uint8_t window = this->window > FLASHER_MAX_WINDOW ? FLASHER_MAX_WINDOW
+                                                     : this->window;
+  uint8_t head = 0, count = 0, stale = 0, tries = 0;
+  Flashboot_eResult result = Flashboot_eOK;
+  uint64_t offset = 0, sent = 0;
+  Flashboot_Frame reply;
+
+  window = window ? window : 1;
+  while (result == Flashboot_eOK && (offset < image->size || count)) {
+    /*The window is filled before waiting for the replies*/
+    while (result == Flashboot_eOK && count < window && offset < image->size) {
+      Pending *packet = &pending[(head + count) % FLASHER_MAX_WINDOW];
+
+      packet->offset = offset;
+      packet->size = image->size - offset > this->packetSize
+                         ? this->packetSize
+                         : (uint32_t)(image->size - offset);
+      stats->retries += offset < sent ? 1 : 0;
+      result = SendPacket(this, image, packet);
+      offset += packet->size;
+      sent = offset > sent ? offset : sent;
+      count++;
+    }
+
+    if (result == Flashboot_eOK) {
+      result = Receive(this, &reply);
+    }
+
+    if (result == Flashboot_eTimeoutError && tries++ < this->retries) {
+      /*A frame was lost, the late replies are dropped and the packets in
+       * flight sent again*/
+      result = Flashboot_eOK;
+      while (this->interface->Receive(this->interface->arg, (uint8_t *)&reply,
+                                      sizeof(reply), 0) > 0) {
+      }
+      offset = pending[head].offset;
+      count = 0;
+      stale = 0;
+    } else if (result == Flashboot_eOK && stale) {
+      /*Reply of a packet sent before going back*/
+      stale--;
+    } else if (result == Flashboot_eOK) {
+      Pending packet = pending[head];
+
+      Record(this, Flashboot_UpdateTransfer, packet.sentTime);
+      head = (head + 1) % FLASHER_MAX_WINDOW;
+      count--;
+
+      result = ReplyResult(&reply);
+      if (result == Flashboot_eOK) {
+        this->bytes += packet.size;
+        tries = 0;
+      } else if (result == Flashboot_eRetransmitRequest &&
+                 tries++ < this->retries) {
+        /*The loader rejects the packets in flight until this one arrives*/
+        result = Flashboot_eOK;
+        offset = packet.offset;
+        stale = count;
+        count = 0;
+      }
+    }
+  }
+  return result;
+}
+
+Flashboot_eResult Flasher_Initialize(Flasher_Context *this,
+                                     const Flasher_Interface *interface) {
+  Flashboot_ASSERT(this == NULL || interface == NULL,
+                   Flashboot_eNullPointerError);
+
+  memset(this, 0, sizeof(Flasher_Context));
+  this->interface = interface;
+  this->window = 8;
+  this->retries = 3;
+  this->timeout = 1000;
+  this->packetSize = PACKET_SIZE;
+  return Flashboot_eOK;
+}
+
+Flashboot_eResult Flasher_GetVersion(Flasher_Context *this, uint32_t *boot,
+                                     uint32_t *app) {
+  Flashboot_Frame frame = {.id = Flashboot_GetVersion}, reply;
+  Flashboot_eResult result;
+
+  Flashboot_ASSERT(this == NULL || boot == NULL || app == NULL,
+                   Flashboot_eNullPointerError);
+
+  result = Request(this, &frame, sizeof(frame.id), &reply);
+  if (result == Flashboot_eOK) {
+    *boot = FLASHBOOT_ARRAY_TO_U32(reply.payload.version.boot);
+    *app = FLASHBOOT_ARRAY_TO_U32(reply.payload.version.app);
+  }
+  return result;
+}
+
+Flashboot_eResult Flasher_GetStats(Flasher_Context *this,
+                                   Flashboot_Stats *stats, bool reset) {
+  Flashboot_Frame frame = {.id = Flashboot_GetStats}, reply;
+  Flashboot_eResult result;
+
+  Flashboot_ASSERT(this == NULL || stats == NULL,
+                   Flashboot_eNullPointerError);
+
+  frame.payload.getStats.reset = reset;
+  result = Request(this, &frame,
+                   sizeof(frame.id) + sizeof(frame.payload.getStats), &reply);
+  if (result == Flashboot_eOK) {
+    memset(stats, 0, sizeof(*stats));
+    stats->bytesRead =
+        FLASHBOOT_ARRAY_TO_U64(reply.payload.statsResult.bytesRead);
+    stats->pagesWritten =
+        FLASHBOOT_ARRAY_TO_U32(reply.payload.statsResult.pagesWritten);
+    stats->sectorsErased =
+        FLASHBOOT_ARRAY_TO_U32(reply.payload.statsResult.sectorsErased);
+    stats->erasesSkipped =
+        FLASHBOOT_ARRAY_TO_U32(reply.payload.statsResult.erasesSkipped);
+    stats->crcBytes =
+        FLASHBOOT_ARRAY_TO_U64(reply.payload.statsResult.crcBytes);
+    stats->mbrProbes =
+        FLASHBOOT_ARRAY_TO_U32(reply.payload.statsResult.mbrProbes);
+    stats->retransmits =
+        FLASHBOOT_ARRAY_TO_U32(reply.payload.statsResult.retransmits);
+    for (uint8_t i = 0;
+         i < reply.payload.statsResult.states && i < Flashboot_StateCount;
+         i++) {
+      stats->stateTime[i] =
+          FLASHBOOT_ARRAY_TO_U32(reply.payload.statsResult.stateTime[i]);
+    }
+  }
+  return result;
+}
+
+Flashboot_eResult Flasher_Update(Flasher_Context *this,
+                                 const Flasher_Image *image) {
+  Flashboot_Frame frame = {.id = Flashboot_UpdateStart}, reply;
+  Flashboot_eResult result;
+
+  Flashboot_ASSERT(this == NULL || image == NULL || image->data == NULL,
+                   Flashboot_eNullPointerError);
+  Flashboot_ASSERT(this->packetSize == 0 || this->packetSize > PACKET_SIZE,
+                   Flashboot_eBadInputError);
+
+  this->bytes = 0;
+  this->startTime = GetTime(this);
+
+  FLASHBOOT_U64_TO_ARRAY(image->address,
+                         frame.payload.updateStart.startAddress);
+  FLASHBOOT_U64_TO_ARRAY(image->size, frame.payload.updateStart.size);
+  FLASHBOOT_U32_TO_ARRAY(image->version, frame.payload.updateStart.version);
+
+  /*The whole image is sent, the block size of a differential update is left
+   * out*/
+  result = Request(this, &frame,
+                   offsetof(Flashboot_Frame, payload.updateStart.blockSize),
+                   &reply);
+  if (result == Flashboot_eOK) {
+    result = ReplyResult(&reply);
+  }
+
+  if (result == Flashboot_eOK) {
+    result = Transfer(this, image);
+  }
+
+  if (result == Flashboot_eOK) {
+    uint32_t crc = this->interface->CalcCRC(this->interface->arg, 0,
+                                            image->data, image->size);
+
+    frame.id = Flashboot_UpdateFinish;
+    FLASHBOOT_U32_TO_ARRAY(crc, frame.payload.updateFinish.crc);
+    FLASHBOOT_U32_TO_ARRAY(image->version, frame.payload.updateFinish.version);
+    result = Request(this, &frame,
+                     sizeof(frame.id) + sizeof(frame.payload.updateFinish),
+                     &reply);
+  }
+  if (result == Flashboot_eOK) {
+    result = ReplyResult(&reply);
+  }
+
+  this->endTime = GetTime(this);
+  return result;
+}
+
+Flashboot_eResult Flasher_Boot(Flasher_Context *this) {
+  Flashboot_Frame frame = {.id = Flashboot_BootApplication};
+
+  Flashboot_ASSERT(this == NULL, Flashboot_eNullPointerError);
+  return Send(this, &frame, sizeof(frame.id));
+}
+
+static int CompareLatency(const void *a, const void *b) {
+  uint32_t left = *(const uint32_t *)a, right = *(const uint32_t *)b;
+  return (left > right) - (left < right);
+}
+
+void Flasher_Report(Flasher_Context *this, FILE *output) {
+  static uint32_t sorted[FLASHER_MAX_SAMPLES];
+  uint64_t elapsed = this->endTime - this->startTime;
+
+  fprintf(output, "Transferred %" PRIu64 " bytes in %.3f s, %.1f KiB/s\n",
+          this->bytes, elapsed / 1e6,
+          elapsed ? this->bytes * 1e6 / 1024 / elapsed : 0.0);
+  fprintf(output, "%-18s %8s %8s %10s %10s %10s\n", "Command", "Count",
+          "Retries", "p50 us", "p90 us", "p99 us");
+
+  for (uint32_t id = 0; id < FLASHER_COMMANDS; id++) {
+    const Flasher_CommandStats *stats = &this->command[id];
+    uint32_t count = stats->samples > FLASHER_MAX_SAMPLES ? FLASHER_MAX_SAMPLES
+                                                          : stats->samples;
+
+    if (stats->count == 0 && stats->retries == 0) {
+      continue;
+    }
+
+    memcpy(sorted, stats->latency, count * sizeof(sorted[0]));
+    qsort(sorted, count, sizeof(sorted[0]), CompareLatency);
+    fprintf(output, "%-18s %8u %8u %10u %10u %10u\n", commandName[id],
+            stats->count, stats->retries,
+            count ? sorted[(count - 1) * 50 / 100] : 0,
+            count ? sorted[(count - 1) * 90 / 100] : 0,
+            count ? sorted[(count - 1) * 99 / 100] : 0);
+  }
+}
+
+void Flasher_ReportStats(const Flashboot_Stats *stats, FILE *output) {
+  fprintf(output, "Bytes read %" PRIu64 ", CRC bytes %" PRIu64 "\n",
+          stats->bytesRead, stats->crcBytes);
+  fprintf(output, "Pages written %u, sectors erased %u, erases skipped %u\n",
+          stats->pagesWritten, stats->sectorsErased, stats->erasesSkipped);
+  fprintf(output, "MBR probes %u, retransmits %u\n", stats->mbrProbes,
+          stats->retransmits);
+  fprintf(output, "%-18s %10s\n", "State", "Time ms");
+
+  for (uint32_t id = 0; id < Flashboot_StateCount; id++) {
+    if (stats->stateTime[id] != 0) {
+      fprintf(output, "%-18s %10u\n", stateName[id], stats->stateTime[id]);
+    }
+  }
+}
@@ -0,0 +1,158 @@
+// Copyright Douglas Santos Reis.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef HOST_FLASHER_H_
+#define HOST_FLASHER_H_
+
+#include <Flashboot_Types.h>
+#include <stdio.h>
+
+/*!
+ * Biggest amount of transfer packets sent without waiting for their replies.
+ */
+#define FLASHER_MAX_WINDOW 32
+
+/*!
+ * Latency samples kept for each command, the percentiles are taken from the
+ * last ones.
+ */
+#define FLASHER_MAX_SAMPLES 4096
+
+/*!
+ * Amount of protocol commands, the statistics are kept by command id.
+ */
+#define FLASHER_COMMANDS (Flashboot_GetStats + 1)
+
+/*!
+ * The Flasher_Interface struct defines the link to the boot loader and the
+ * services of the host. Each call sends or receives a whole frame, the
+ * transport adds its own framing.
+ */
+typedef struct {
+  void *arg; /*!< Argument passed to every callback*/
+  /*!
+   * Send a frame to the boot loader.
+   * @return The size sent, negative on a link failure.
+   */
+  int32_t (*Send)(void *arg, const uint8_t *data, uint32_t size);
+  /*!
+   * Receive the next reply of the boot loader.
+   * @param timeout  Milliseconds to wait for the reply.
+   * @return The reply size, 0 on timeout, negative on a link failure.
+   */
+  int32_t (*Receive)(void *arg, uint8_t *data, uint32_t size,
+                     uint32_t timeout);
+  /*!
+   * Time used for the throughput and the latencies, in microseconds.
+   */
+  uint64_t (*GetTime)(void *arg);
+  /*!
+   * CRC of a packet, the same one calculated by the boot loader.
+   */
+  uint32_t (*CalcCRC)(void *arg, uint32_t initValue, const void *data,
+                      uint32_t size);
+} Flasher_Interface;
+
+/*!
+ * The Flasher_Image struct describes an image to be written.
+ */
+typedef struct {
+  uint64_t address; /*!< Address the image is written at*/
+  uint64_t size;    /*!< Image size*/
+  uint32_t version; /*!< Image version*/
+  uint8_t *data;    /*!< Image content*/
+} Flasher_Image;
+
+/*!
+ * Statistics of a protocol command.
+ */
+typedef struct {
+  uint32_t count;   /*!< Amount of replies received*/
+  uint32_t retries; /*!< Amount of frames sent again*/
+  uint32_t samples; /*!< Amount of latencies recorded, the ring keeps the last
+                       ::FLASHER_MAX_SAMPLES*/
+  uint32_t latency[FLASHER_MAX_SAMPLES]; /*!< Microseconds from the frame sent
+                                            to its reply*/
+} Flasher_CommandStats;
+
+/*!
+ * The Flasher_Context struct holds a session with a boot loader.
+ */
+typedef struct {
+  const Flasher_Interface *interface;
+  uint8_t window;   /*!< Transfer packets sent without waiting for a reply*/
+  uint8_t retries;  /*!< Times a frame is sent again before giving up*/
+  uint32_t timeout; /*!< Milliseconds waited for a reply*/
+  uint32_t packetSize; /*!< Payload of each transfer packet*/
+  uint64_t bytes;      /*!< Image bytes transferred*/
+  uint64_t startTime;  /*!< Start of the last update*/
+  uint64_t endTime;    /*!< End of the last update*/
+  Flasher_CommandStats command[FLASHER_COMMANDS];
+} Flasher_Context;
+
+/*!
+ * @brief Initialize a session with a boot loader.
+ * @param[in] this       Context struct that must be allocated by the host.
+ * @param[in] interface  Link and services of the host.
+ * @return See ::Flashboot_Result
+ */
+Flashboot_eResult Flasher_Initialize(Flasher_Context *this,
+                                     const Flasher_Interface *interface);
+
+/*!
+ * @brief Read the versions of the boot loader and of the application.
+ * @param[in] this   Struct initialized by ::Flasher_Initialize function.
+ * @param[out] boot  Receives the boot loader version.
+ * @param[out] app   Receives the application version.
+ * @return See ::Flashboot_Result
+ */
+Flashboot_eResult Flasher_GetVersion(Flasher_Context *this, uint32_t *boot,
+                                     uint32_t *app);
+
+/*!
+ * @brief Write an image, the packets are pipelined up to the window and the
+ * ones the boot loader asks for are sent again.
+ * @param[in] this   Struct initialized by ::Flasher_Initialize function.
+ * @param[in] image  Image to be written.
+ * @return See ::Flashboot_Result, the first error replied by the boot loader
+ * or ::Flashboot_eTimeoutError if it stopped replying.
+ */
+Flashboot_eResult Flasher_Update(Flasher_Context *this,
+                                 const Flasher_Image *image);
+
+/*!
+ * @brief Read the operation counters and the time spent in each state of the
+ * boot loader.
+ * @param[in] this   Struct initialized by ::Flasher_Initialize function.
+ * @param[out] stats Receives the counters, the states not reported are zero.
+ * @param[in] reset  Clear the counters of the boot loader after reading them.
+ * @return See ::Flashboot_Result
+ */
+Flashboot_eResult Flasher_GetStats(Flasher_Context *this,
+                                   Flashboot_Stats *stats, bool reset);
+
+/*!
+ * @brief Request the boot of the application, no reply is expected.
+ * @param[in] this   Struct initialized by ::Flasher_Initialize function.
+ * @return See ::Flashboot_Result
+ */
+Flashboot_eResult Flasher_Boot(Flasher_Context *this);
+
+/*!
+ * @brief Print the throughput of the last update and, for each command used,
+ * its count, retries and latency percentiles.
+ * @param[in] this   Struct initialized by ::Flasher_Initialize function.
+ * @param[in] output Stream the report is printed to.
+ */
+void Flasher_Report(Flasher_Context *this, FILE *output);
+
+/*!
+ * @brief Print the counters read by ::Flasher_GetStats and the time of each
+ * state that ran.
+ * @param[in] stats  Counters of the boot loader.
+ * @param[in] output Stream the report is printed to.
+ */
+void Flasher_ReportStats(const Flashboot_Stats *stats, FILE *output);
+
+#endif /* HOST_FLASHER_H_ */
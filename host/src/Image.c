@@ -0,0 +1,154 @@
+// Copyright Douglas Santos Reis.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "Image.h"
+#include <elf.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*!
+ * A loadable segment of an ELF file.
+ */
+typedef struct {
+  uint64_t address; /*!< Physical address*/
+  uint64_t offset;  /*!< Offset in the file*/
+  uint64_t size;    /*!< Size in the file, the rest of the segment is zeroed
+                       by the application*/
+} Segment;
+
+/*!
+ * Check a range of the file, written so the sums can't wrap.
+ * @return true if the range is inside the file.
+ */
+static bool InFile(uint64_t size, uint64_t offset, uint64_t length) {
+  return offset <= size && length <= size - offset;
+}
+
+/*!
+ * Read the segment of a program header.
+ * @return true if it's a loadable segment with content in the file.
+ */
+static bool ReadSegment(const uint8_t *file, uint64_t size, bool is64,
+                        uint64_t header, Segment *segment) {
+  if (is64) {
+    Elf64_Phdr phdr;
+
+    Flashboot_ASSERT(!InFile(size, header, sizeof(phdr)), false);
+    memcpy(&phdr, file + header, sizeof(phdr));
+    *segment = (Segment){phdr.p_paddr, phdr.p_offset, phdr.p_filesz};
+    return phdr.p_type == PT_LOAD && phdr.p_filesz;
+  } else {
+    Elf32_Phdr phdr;
+
+    Flashboot_ASSERT(!InFile(size, header, sizeof(phdr)), false);
+    memcpy(&phdr, file + header, sizeof(phdr));
+    *segment = (Segment){phdr.p_paddr, phdr.p_offset, phdr.p_filesz};
+    return phdr.p_type == PT_LOAD && phdr.p_filesz;
+  }
+}
+
+/*!
+ * Assemble the loadable segments of an ELF file in a single image.
+ * @return See ::Flashboot_Result
+ */
+static Flashboot_eResult LoadElf(const uint8_t *file, uint64_t size,
+                                 uint64_t limit, Flasher_Image *image) {
+  bool is64 = file[EI_CLASS] == ELFCLASS64;
+  uint64_t header, count, stride, start = UINT64_MAX, end = 0;
+  Segment segment;
+
+  Flashboot_ASSERT(size < sizeof(Elf64_Ehdr) || file[EI_DATA] != ELFDATA2LSB ||
+                       (file[EI_CLASS] != ELFCLASS32 && !is64),
+                   Flashboot_eBadInputError);
+
+  if (is64) {
+    const Elf64_Ehdr *ehdr = (const Elf64_Ehdr *)file;
+    header = ehdr->e_phoff;
+    count = ehdr->e_phnum;
+    stride = ehdr->e_phentsize;
+  } else {
+    const Elf32_Ehdr *ehdr = (const Elf32_Ehdr *)file;
+    header = ehdr->e_phoff;
+    count = ehdr->e_phnum;
+    stride = ehdr->e_phentsize;
+  }
+
+  /*The program headers shall be inside the file*/
+  Flashboot_ASSERT(stride == 0 || count > size / stride ||
+                       !InFile(size, header, count * stride),
+                   Flashboot_eBadInputError);
+
+  /*The image spans from the first to the last byte loaded*/
+  for (uint64_t i = 0; i < count; i++) {
+    if (ReadSegment(file, size, is64, header + i * stride, &segment)) {
+      Flashboot_ASSERT(!InFile(size, segment.offset, segment.size) ||
+                           segment.address > UINT64_MAX - segment.size,
+                       Flashboot_eBadInputError);
+      start = segment.address < start ? segment.address : start;
+      end = segment.address + segment.size > end
+                ? segment.address + segment.size
+                : end;
+    }
+  }
+  Flashboot_ASSERT(end == 0, Flashboot_eBadInputError);
+
+  /*Segments far apart would make an image bigger than the memory*/
+  Flashboot_ASSERT(end - start > limit, Flashboot_eAddressOutOfBoundsError);
+
+  image->address = start;
+  image->size = end - start;
+  image->data = malloc(image->size);
+  Flashboot_ASSERT(image->data == NULL, Flashboot_eBufferOverflowError);
+  memset(image->data, 0xFF, image->size);
+
+  for (uint64_t i = 0; i < count; i++) {
+    if (ReadSegment(file, size, is64, header + i * stride, &segment)) {
+      memcpy(image->data + (segment.address - start), file + segment.offset,
+             segment.size);
+    }
+  }
+  return Flashboot_eOK;
+}
+
+Flashboot_eResult Image_Load(const char *path, uint64_t address,
+                             uint64_t limit, Flasher_Image *image) {
+  Flashboot_eResult result = Flashboot_eOK;
+  FILE *input = fopen(path, "rb");
+  uint8_t *file = NULL;
+  long size = 0;
+
+  Flashboot_ASSERT(input == NULL, Flashboot_eBadInputError);
+
+  if (fseek(input, 0, SEEK_END) == 0 && (size = ftell(input)) > 0 &&
+      fseek(input, 0, SEEK_SET) == 0) {
+    file = malloc(size);
+  }
+  if (file == NULL || fread(file, 1, size, input) != (size_t)size) {
+    result = Flashboot_eBadInputError;
+  }
+  fclose(input);
+
+  memset(image, 0, sizeof(*image));
+  if (result == Flashboot_eOK && size >= SELFMAG &&
+      memcmp(file, ELFMAG, SELFMAG) == 0) {
+    result = LoadElf(file, size, limit, image);
+    free(file);
+  } else if (result == Flashboot_eOK && (uint64_t)size > limit) {
+    result = Flashboot_eAddressOutOfBoundsError;
+    free(file);
+  } else if (result == Flashboot_eOK) {
+    /*A raw binary is written as it is*/
+    image->address = address;
+    image->size = size;
+    image->data = file;
+  } else {
+    free(file);
+  }
+  return result;
+}
+
+void Image_Free(Flasher_Image *image) {
+  free(image->data);
+  image->data = NULL;
+}
@@ -0,0 +1,38 @@
+// Copyright Douglas Santos Reis.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef HOST_IMAGE_H_
+#define HOST_IMAGE_H_
+
+#include "Flasher.h"
+
+/*!
+ * Size of the memory an image is written to when it isn't given, a 128 Mbit
+ * serial NOR.
+ */
+#define IMAGE_DEFAULT_LIMIT (16 * 1024 * 1024)
+
+/*!
+ * @brief Load a raw binary or an ELF image.
+ * @details An ELF is loaded from the physical addresses of its loadable
+ * segments, the gaps between them are filled with 0xFF. Only little-endian
+ * ELF files, of 32 or 64 bits, are supported.
+ * @param[in] path     Image file.
+ * @param[in] address  Address of a raw binary, ignored for an ELF.
+ * @param[in] limit    Size of the memory the image is written to, a bigger
+ * image is refused before it's allocated.
+ * @param[out] image   Receives the image, its data is released by
+ * ::Image_Free.
+ * @return See ::Flashboot_Result
+ */
+Flashboot_eResult Image_Load(const char *path, uint64_t address,
+                             uint64_t limit, Flasher_Image *image);
+
+/*!
+ * @brief Release an image loaded by ::Image_Load.
+ * @param[in] image    Image to be released.
+ */
+void Image_Free(Flasher_Image *image);
+
+#endif /* HOST_IMAGE_H_ */
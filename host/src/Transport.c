@@ -0,0 +1,159 @@
+// Copyright Douglas Santos Reis.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+
+#define _GNU_SOURCE
+#include "Transport.h"
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+static const struct {
+  uint32_t baud;
+  speed_t speed;
+} speeds[] = {
+    {9600, B9600},     {19200, B19200},   {38400, B38400},
+    {57600, B57600},   {115200, B115200}, {230400, B230400},
+    {460800, B460800}, {921600, B921600},
+};
+
+/*!
+ * Wait for the stream to have data.
+ * @return 1 if it has, 0 on timeout, negative on failure.
+ */
+static int WaitData(int fd, uint32_t timeout) {
+  struct pollfd event = {.fd = fd, .events = POLLIN};
+  int ready = poll(&event, 1, timeout);
+
+  if (ready > 0 && !(event.revents & POLLIN)) {
+    return -1;
+  }
+  return ready;
+}
+
+/*!
+ * Read the exact amount of bytes, the timeout applies to each chunk.
+ * @return The size read, 0 on timeout, negative on failure.
+ */
+static int32_t ReadAll(int fd, uint8_t *data, uint32_t size,
+                       uint32_t timeout) {
+  uint32_t done = 0;
+
+  while (done < size) {
+    int ready = WaitData(fd, timeout);
+    ssize_t length = ready > 0 ? read(fd, data + done, size - done) : ready;
+
+    if (length <= 0) {
+      return length == 0 && ready == 0 ? 0 : -1;
+    }
+    done += length;
+  }
+  return done;
+}
+
+int32_t Transport_WriteFrame(int fd, const uint8_t *data, uint32_t size) {
+  uint8_t header[2];
+  FLASHBOOT_U16_TO_ARRAY(size, header);
+
+  if (write(fd, header, sizeof(header)) != sizeof(header) ||
+      write(fd, data, size) != (ssize_t)size) {
+    return -1;
+  }
+  return size;
+}
+
+int32_t Transport_ReadFrame(int fd, uint8_t *data, uint32_t size,
+                            uint32_t timeout) {
+  uint8_t header[2];
+  int32_t length = ReadAll(fd, header, sizeof(header), timeout);
+
+  if (length <= 0) {
+    return length;
+  }
+  length = FLASHBOOT_ARRAY_TO_U16(header);
+  if ((uint32_t)length > size) {
+    return -1;
+  }
+  return ReadAll(fd, data, length, timeout) == length ? length : -1;
+}
+
+static int32_t Send(void *arg, const uint8_t *data, uint32_t size) {
+  return Transport_WriteFrame(((Transport *)arg)->fd, data, size);
+}
+
+static int32_t Receive(void *arg, uint8_t *data, uint32_t size,
+                       uint32_t timeout) {
+  return Transport_ReadFrame(((Transport *)arg)->fd, data, size, timeout);
+}
+
+static uint64_t GetTime(void *arg) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+Flashboot_eResult Transport_OpenSerial(Transport *this, const char *path,
+                                       uint32_t baud) {
+  struct termios options;
+
+  this->pid = 0;
+  this->fd = open(path, O_RDWR | O_NOCTTY);
+  Flashboot_ASSERT(this->fd < 0, Flashboot_eBadInputError);
+
+  /*A pty doesn't have a baud rate, the raw mode is enough*/
+  if (tcgetattr(this->fd, &options) == 0) {
+    cfmakeraw(&options);
+    for (uint32_t i = 0; baud && i < sizeof(speeds) / sizeof(speeds[0]); i++) {
+      if (speeds[i].baud == baud) {
+        cfsetspeed(&options, speeds[i].speed);
+      }
+    }
+    tcsetattr(this->fd, TCSANOW, &options);
+  }
+  return Flashboot_eOK;
+}
+
+Flashboot_eResult Transport_Spawn(Transport *this, const char *command) {
+  int pair[2];
+
+  Flashboot_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0,
+                   Flashboot_eGeneralError);
+
+  this->pid = fork();
+  if (this->pid == 0) {
+    dup2(pair[1], STDIN_FILENO);
+    dup2(pair[1], STDOUT_FILENO);
+    close(pair[0]);
+    close(pair[1]);
+    execl("/bin/sh", "sh", "-c", command, (char *)NULL);
+    _exit(127);
+  }
+  close(pair[1]);
+  this->fd = pair[0];
+  if (this->pid < 0) {
+    close(pair[0]);
+    return Flashboot_eGeneralError;
+  }
+  return Flashboot_eOK;
+}
+
+void Transport_Close(Transport *this) {
+  close(this->fd);
+  if (this->pid > 0) {
+    /*The process ends when its input is closed*/
+    waitpid(this->pid, NULL, 0);
+  }
+}
+
+void Transport_Bind(Transport *this, Flasher_Interface *interface) {
+  interface->arg = this;
+  interface->Send = Send;
+  interface->Receive = Receive;
+  interface->GetTime = GetTime;
+}
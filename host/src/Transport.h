@@ -0,0 +1,74 @@
+// Copyright Douglas Santos Reis.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef HOST_TRANSPORT_H_
+#define HOST_TRANSPORT_H_
+
+#include "Flasher.h"
+#include <sys/types.h>
+
+/*!
+ * The Transport struct is a byte stream to the boot loader, a serial port or
+ * the standard input and output of a process. Each frame is preceded by its
+ * size in 2 bytes, as the frames of a batch.
+ */
+typedef struct {
+  int fd;    /*!< Stream descriptor*/
+  pid_t pid; /*!< Process spawned, 0 for a serial port*/
+} Transport;
+
+/*!
+ * @brief Open a serial port, or a pty, in raw mode.
+ * @param[in] this  Transport to be opened.
+ * @param[in] path  Device path.
+ * @param[in] baud  Baud rate, 0 to keep the current one.
+ * @return See ::Flashboot_Result
+ */
+Flashboot_eResult Transport_OpenSerial(Transport *this, const char *path,
+                                       uint32_t baud);
+
+/*!
+ * @brief Start a process, a device simulator or a bridge to another link,
+ * that exchanges the frames through its standard input and output.
+ * @param[in] this     Transport to be opened.
+ * @param[in] command  Shell command of the process.
+ * @return See ::Flashboot_Result
+ */
+Flashboot_eResult Transport_Spawn(Transport *this, const char *command);
+
+/*!
+ * @brief Close the stream and wait for the process spawned, if any.
+ * @param[in] this  Transport opened.
+ */
+void Transport_Close(Transport *this);
+
+/*!
+ * @brief Fill the link and the clock of a ::Flasher_Interface with the
+ * transport, the CRC is left to the caller.
+ * @param[in] this       Transport opened.
+ * @param[out] interface Interface used by the flasher.
+ */
+void Transport_Bind(Transport *this, Flasher_Interface *interface);
+
+/*!
+ * @brief Write a frame preceded by its size.
+ * @param[in] fd    Stream descriptor.
+ * @param[in] data  Frame.
+ * @param[in] size  Frame size.
+ * @return The frame size, negative on failure.
+ */
+int32_t Transport_WriteFrame(int fd, const uint8_t *data, uint32_t size);
+
+/*!
+ * @brief Read a frame preceded by its size.
+ * @param[in] fd       Stream descriptor.
+ * @param[out] data    Receives the frame.
+ * @param[in] size     Buffer size, a bigger frame is a failure.
+ * @param[in] timeout  Milliseconds to wait for the frame.
+ * @return The frame size, 0 on timeout, negative on failure.
+ */
+int32_t Transport_ReadFrame(int fd, uint8_t *data, uint32_t size,
+                            uint32_t timeout);
+
+#endif /* HOST_TRANSPORT_H_ */
@@ -0,0 +1,145 @@
+// Copyright Douglas Santos Reis.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "Flasher.h"
+#include "Image.h"
+#include "Transport.h"
+#include "crc.h"
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdlib.h>
+
+static const char usage[] =
+    "usage: flashbootHost (--port <path> [--baud <rate>] | --exec <command>)\n"
+    "                     [--address <address>] [--version <version>]\n"
+    "                     [--window <packets>] [--retries <count>]\n"
+    "                     [--timeout <ms>] [--memory-size <bytes>] [--stats]\n"
+    "                     [--boot] <image>\n"
+    "The image is a raw binary written at the address, or an ELF file. An\n"
+    "image bigger than the memory size, 16 MiB by default, is refused.\n";
+
+static uint32_t CalcCRC(void *arg, uint32_t initValue, const void *data,
+                        uint32_t size) {
+  return crc32(data, size, initValue);
+}
+
+int main(int argc, char **argv) {
+  static const struct option options[] = {
+      {"port", required_argument, NULL, 'p'},
+      {"baud", required_argument, NULL, 'b'},
+      {"exec", required_argument, NULL, 'e'},
+      {"address", required_argument, NULL, 'a'},
+      {"version", required_argument, NULL, 'v'},
+      {"window", required_argument, NULL, 'w'},
+      {"retries", required_argument, NULL, 'r'},
+      {"timeout", required_argument, NULL, 't'},
+      {"memory-size", required_argument, NULL, 'm'},
+      {"stats", no_argument, NULL, 's'},
+      {"boot", no_argument, NULL, 'B'},
+      {NULL, 0, NULL, 0},
+  };
+  static Flasher_Context flasher;
+  Flasher_Interface interface = {.CalcCRC = CalcCRC};
+  const char *port = NULL, *command = NULL;
+  uint32_t baud = 0, version = 0, window = 8, retries = 3, timeout = 1000;
+  uint32_t bootVersion, appVersion;
+  uint64_t address = 0, limit = IMAGE_DEFAULT_LIMIT;
+  bool boot = false, stats = false;
+  Flashboot_Stats counters;
+  Flasher_Image image;
+  Transport transport;
+  Flashboot_eResult result;
+  int option;
+
+  while ((option = getopt_long(argc, argv, "", options, NULL)) != -1) {
+    switch (option) {
+    case 'p':
+      port = optarg;
+      break;
+    case 'b':
+      baud = strtoul(optarg, NULL, 0);
+      break;
+    case 'e':
+      command = optarg;
+      break;
+    case 'a':
+      address = strtoull(optarg, NULL, 0);
+      break;
+    case 'v':
+      version = strtoul(optarg, NULL, 0);
+      break;
+    case 'w':
+      window = strtoul(optarg, NULL, 0);
+      break;
+    case 'r':
+      retries = strtoul(optarg, NULL, 0);
+      break;
+    case 't':
+      timeout = strtoul(optarg, NULL, 0);
+      break;
+    case 'm':
+      limit = strtoull(optarg, NULL, 0);
+      break;
+    case 's':
+      stats = true;
+      break;
+    case 'B':
+      boot = true;
+      break;
+    default:
+      fputs(usage, stderr);
+      return 2;
+    }
+  }
+  if (optind != argc - 1 || (port == NULL) == (command == NULL) ||
+      window == 0 || window > FLASHER_MAX_WINDOW) {
+    fputs(usage, stderr);
+    return 2;
+  }
+
+  if (Image_Load(argv[optind], address, limit, &image) != Flashboot_eOK) {
+    fprintf(stderr, "Can't load the image %s\n", argv[optind]);
+    return 1;
+  }
+  image.version = version;
+
+  result = port ? Transport_OpenSerial(&transport, port, baud)
+                : Transport_Spawn(&transport, command);
+  if (result != Flashboot_eOK) {
+    fprintf(stderr, "Can't open the link to the boot loader\n");
+    Image_Free(&image);
+    return 1;
+  }
+  Transport_Bind(&transport, &interface);
+
+  Flasher_Initialize(&flasher, &interface);
+  flasher.window = window;
+  flasher.retries = retries;
+  flasher.timeout = timeout;
+
+  result = Flasher_GetVersion(&flasher, &bootVersion, &appVersion);
+  if (result == Flashboot_eOK) {
+    printf("Boot loader version 0x%08X, application version 0x%08X\n",
+           bootVersion, appVersion);
+    printf("Writing %" PRIu64 " bytes at 0x%" PRIX64 ", version 0x%08X\n",
+           image.size, image.address, image.version);
+    result = Flasher_Update(&flasher, &image);
+  }
+  if (result == Flashboot_eOK && stats) {
+    result = Flasher_GetStats(&flasher, &counters, false);
+    if (result == Flashboot_eOK) {
+      Flasher_ReportStats(&counters, stdout);
+    }
+  }
+  if (result == Flashboot_eOK && boot) {
+    result = Flasher_Boot(&flasher);
+  }
+
+  printf("Result=%d\n", result);
+  Flasher_Report(&flasher, stdout);
+
+  Transport_Close(&transport);
+  Image_Free(&image);
+  return result == Flashboot_eOK ? 0 : 1;
+}
@@ -12,6 +12,20 @@
 
 void Flashboot_Test(Flashboot_Context *this);
 
+/*!
+ * Account the ticks since the last state started to that state, which stored
+ * its ::Flashboot_StateId when it ran.
+ * @param this       Struct initialized by ::Flashboot_Initialize function.
+ */
+static void AccountTime(Flashboot_Context *this) {
+  uint32_t now = this->interface->GetTick(this->arg);
+
+  if (this->timing.state < Flashboot_StateCount) {
+    this->stats.stateTime[this->timing.state] += now - this->timing.tick;
+  }
+  this->timing.tick = now;
+}
+
 Flashboot_eResult Flashboot_Initialize(Flashboot_Context *this, void *arg,
                                        const Flashboot_Interface *interface,
                                        Flashboot_Memory *progMem,
@@ -22,7 +36,8 @@ Flashboot_eResult Flashboot_Initialize(Flashboot_Context *this, void *arg,
       (this == NULL || interface == NULL || progMem == NULL || buffer == NULL),
       Flashboot_eNullPointerError);
 
-  Flashboot_ASSERT(size < progMem->sectorSize, Flashboot_eBufferOverflowError);
+  Flashboot_ASSERT(size < FLASHBOOT_MIN_WORK_BUFFER || size < progMem->pageSize,
+                   Flashboot_eBufferOverflowError);
 
   memset(this, 0, sizeof(Flashboot_Context));
 
@@ -31,6 +46,8 @@ Flashboot_eResult Flashboot_Initialize(Flashboot_Context *this, void *arg,
 
   this->dataMem = NULL;
   this->backupMem = NULL;
+  this->scratchMem = NULL;
+  this->generations.count = 1;
   this->update.memory = this->progMem = progMem;
   this->workBuffer = buffer;
   this->wbs = size;
@@ -39,6 +56,8 @@ Flashboot_eResult Flashboot_Initialize(Flashboot_Context *this, void *arg,
       0;
 
   this->Flashboot_State = State_CheckProgramMemory;
+  this->timing.state = Flashboot_StateCount;
+  this->timing.tick = interface->GetTick(arg);
 
   /*Set the timeout for command mode without receive any valid command*/
   Flashboot_SetTimeout(this, CONFIG_BOOT_TIMEOUT);
@@ -71,6 +90,143 @@ Flashboot_eResult Flashboot_SetBackupMemory(Flashboot_Context *this,
   return res;
 }
 
+Flashboot_eResult Flashboot_SetBackupGenerations(Flashboot_Context *this,
+                                                 uint8_t count) {
+  Flashboot_ASSERT(this == NULL || this->backupMem == NULL,
+                   Flashboot_eNullPointerError);
+  Flashboot_ASSERT(count == 0 || count > FLASHBOOT_MAX_GENERATIONS,
+                   Flashboot_eBadInputError);
+
+  /*The slots are split in whole sectors, with one of them for the records*/
+  Flashboot_ASSERT(count > 1 && (this->backupMem->sectorMap ||
+                                 this->backupMem->size / count <
+                                     2 * Flashboot_MaxSectorSize(
+                                             this->backupMem)),
+                   Flashboot_eBadInputError);
+  Flashboot_ASSERT(sizeof(Flashboot_GenerationRecord) +
+                           this->backupMem->pageSize >
+                       FLASHBOOT_MAX_PAGE_SIZE,
+                   Flashboot_eBufferOverflowError);
+
+  this->generations.count = count;
+  return Flashboot_eOK;
+}
+
+Flashboot_eResult Flashboot_GetGeneration(Flashboot_Context *this,
+                                          uint8_t age, Flashboot_MBR *mbr) {
+  Flashboot_ASSERT(this == NULL || mbr == NULL, Flashboot_eNullPointerError);
+  return Flashboot_ReadGeneration(this, age, mbr);
+}
+
+Flashboot_eResult Flashboot_RestoreGeneration(Flashboot_Context *this,
+                                              uint8_t age) {
+  Flashboot_ASSERT(this == NULL, Flashboot_eNullPointerError);
+  return Flashboot_CopyGeneration(this, age);
+}
+
+Flashboot_eResult Flashboot_ReadStats(Flashboot_Context *this,
+                                      Flashboot_Stats *stats) {
+  Flashboot_ASSERT(this == NULL || stats == NULL, Flashboot_eNullPointerError);
+
+  *stats = this->stats;
+  return Flashboot_eOK;
+}
+
+Flashboot_eResult Flashboot_ResetStats(Flashboot_Context *this) {
+  Flashboot_ASSERT(this == NULL, Flashboot_eNullPointerError);
+
+  memset(&this->stats, 0, sizeof(this->stats));
+  return Flashboot_eOK;
+}
+
+Flashboot_eResult Flashboot_SetScratchMemory(Flashboot_Context *this,
+                                             Flashboot_Memory *scratchMemory) {
+  Flashboot_eResult res = Flashboot_eOK;
+  Flashboot_ASSERT(this == NULL || scratchMemory == NULL,
+                   Flashboot_eNullPointerError);
+
+  this->scratchMem = scratchMemory;
+  return res;
+}
+
+Flashboot_eResult Flashboot_SetSlots(Flashboot_Context *this,
+                                     Flashboot_Memory *slotMemory,
+                                     Flashboot_Memory *recordMemory) {
+  Flashboot_ASSERT(this == NULL || slotMemory == NULL || recordMemory == NULL,
+                   Flashboot_eNullPointerError);
+
+  Flashboot_ASSERT(sizeof(Flashboot_SlotRecord) + recordMemory->pageSize >
+                       FLASHBOOT_MAX_PAGE_SIZE,
+                   Flashboot_eBufferOverflowError);
+
+  this->slots.memory[0] = this->progMem;
+  this->slots.memory[1] = slotMemory;
+  this->slots.record = recordMemory;
+
+  /*Without a record the slot is selected by the images*/
+  Flashboot_ReadSlotRecord(this);
+  return Flashboot_eOK;
+}
+
+Flashboot_eResult Flashboot_SetJournalMemory(Flashboot_Context *this,
+                                             Flashboot_Memory *journalMemory) {
+  Flashboot_ASSERT(this == NULL || journalMemory == NULL,
+                   Flashboot_eNullPointerError);
+
+  Flashboot_ASSERT(sizeof(Flashboot_JournalEntry) + journalMemory->pageSize >
+                       FLASHBOOT_MAX_PAGE_SIZE,
+                   Flashboot_eBufferOverflowError);
+
+  this->journal.memory = journalMemory;
+
+  /*The update in progress, if any, is kept until resumed or started again*/
+  Flashboot_ReadJournal(this);
+  return Flashboot_eOK;
+}
+
+Flashboot_eResult Flashboot_SetBlockCRC(Flashboot_Context *this,
+                                        uint32_t blockSize) {
+  Flashboot_ASSERT(this == NULL, Flashboot_eNullPointerError);
+
+  /*The blocks are repaired in whole pages*/
+  Flashboot_ASSERT(blockSize % this->progMem->pageSize,
+                   Flashboot_eAlignmentError);
+
+  this->blockSize = blockSize;
+  return Flashboot_eOK;
+}
+
+Flashboot_eResult Flashboot_SetVerifyPolicy(Flashboot_Context *this,
+                                            Flashboot_eVerify policy,
+                                            uint32_t bootCount,
+                                            bool successBoot) {
+  Flashboot_ASSERT(this == NULL, Flashboot_eNullPointerError);
+  Flashboot_ASSERT(policy > Flashboot_eVerifyHeader,
+                   Flashboot_eBadInputError);
+
+  /*A failed boot checks the whole image*/
+  this->verify.policy = successBoot ? policy : Flashboot_eVerifyFull;
+  this->verify.bootCount = bootCount;
+  return Flashboot_eOK;
+}
+
+Flashboot_eResult Flashboot_Rollback(Flashboot_Context *this) {
+  Flashboot_MBR mbr;
+  uint8_t slot;
+
+  Flashboot_ASSERT(this == NULL, Flashboot_eNullPointerError);
+  Flashboot_ASSERT(this->slots.record == NULL, Flashboot_eBadInputError);
+
+  /*The other slot shall hold an image*/
+  slot = this->slots.active ^ 1;
+  Flashboot_ASSERT(Flashboot_SearchForMBR(this, this->slots.memory[slot],
+                                          &mbr) != Flashboot_eOK,
+                   Flashboot_eGeneralError);
+
+  this->result = Flashboot_SwitchSlot(this, slot);
+  return this->result;
+}
+
 Flashboot_eResult Flashboot_Execute(Flashboot_Context *this) {
   Flashboot_eResult res = Flashboot_eOK;
 
@@ -78,6 +234,8 @@ Flashboot_eResult Flashboot_Execute(Flashboot_Context *this) {
 
   /*check if the next state is not null*/
   if (this->Flashboot_State) {
+    AccountTime(this);
+
     /*execute next state*/
     this->Flashboot_State(this);
     res = this->result;
@@ -99,27 +257,7 @@ Flashboot_eResult Flashboot_ProcessProtocol(Flashboot_Context *this,
   this->frameSize = size;
 
   /*Define the next state to be processed based on the command arrived.*/
-  switch (this->frame->id) {
-  case Flashboot_GetVersion:
-    this->Flashboot_State = State_GetVersion;
-    break;
-  case Flashboot_BootApplication:
-    this->Flashboot_State = State_CheckProgramMemory;
-    this->commandMode = false;
-    break;
-  case Flashboot_UpdateStart:
-    this->Flashboot_State = State_UpdateStart;
-    break;
-  case Flashboot_UpdateTransfer:
-    this->Flashboot_State = State_UpdateTransfer;
-    break;
-  case Flashboot_UpdateFinish:
-    this->Flashboot_State = State_UpdateFinish;
-    break;
-  default:
-    res = Flashboot_eProtocolError;
-    break;
-  }
+  res = Flashboot_SelectCommand(this);
 
   Flashboot_SetTimeout(this, CONFIG_BOOT_TIMEOUT);
   return res;
@@ -142,19 +280,49 @@ Flashboot_eResult Flashboot_Boot(Flashboot_Context *this) {
   return this->result;
 }
 
+/*!
+ * Memory that receives an update started or resumed by the application
+ * @param this       Struct initialized by ::Flashboot_Initialize function.
+ * @param selfUpdate True to load the data memory instead of the program one
+ * @return           The target memory, NULL if there's no data memory.
+ */
+static Flashboot_Memory *LoadTarget(Flashboot_Context *this,
+                                    const uint32_t selfUpdate) {
+  Flashboot_Memory *target = this->progMem;
+
+  if (selfUpdate && this->slots.record == NULL) {
+    target = this->dataMem;
+  }
+  return target ? Flashboot_UpdateTarget(this, target) : NULL;
+}
+
 Flashboot_eResult Flashboot_StartLoad(Flashboot_Context *this,
                                       const uint32_t selfUpdate,
-                                      const uint64_t address, uint32_t size) {
+                                      const uint64_t address, uint64_t size) {
   Flashboot_ASSERT((this == NULL), Flashboot_eNullPointerError);
 
-  Flashboot_Memory *target = this->progMem;
+  Flashboot_Memory *target = LoadTarget(this, selfUpdate);
+  Flashboot_ASSERT((target == NULL), Flashboot_eNullPointerError);
 
-  if (selfUpdate) {
-    Flashboot_ASSERT((this->dataMem == NULL), Flashboot_eNullPointerError);
-    target = this->dataMem;
-  }
+  this->result = Flashboot_FlashStart(this, target, address, size, 0, 0, 0);
+  return this->result;
+}
+
+Flashboot_eResult Flashboot_ResumeLoad(Flashboot_Context *this,
+                                       const uint32_t selfUpdate,
+                                       const uint64_t address, uint64_t size,
+                                       uint32_t version, uint64_t *offset) {
+  Flashboot_ASSERT((this == NULL || offset == NULL),
+                   Flashboot_eNullPointerError);
+
+  Flashboot_Memory *target = LoadTarget(this, selfUpdate);
+  Flashboot_ASSERT((target == NULL), Flashboot_eNullPointerError);
 
-  this->result = Flashboot_FlashStart(this, target, address, size);
+  this->result =
+      Flashboot_FlashResume(this, target, address, size, version, 0);
+  *offset = this->result == Flashboot_eOK
+                ? this->update.currentAddress - this->update.startAddress
+                : 0;
   return this->result;
 }
 
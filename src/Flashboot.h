@@ -64,6 +64,183 @@ Flashboot_eResult Flashboot_SetBackupMemory(Flashboot_Context *this,
                                             bool successBoot,
                                             Flashboot_Memory *backupMemory);
 
+/*!
+ * @brief Keep several generations of the application in the backup memory,
+ * so an older image can be restored.
+ * @details The backup memory is split into equal slots used as a ring, each
+ * one with the image, its MBR and, in its last sector, the record that dates
+ * it. Each new application is kept over the oldest image on its first boot,
+ * and the recovery tries the images from the newest to the oldest. The
+ * backup memory shall have sectors of a single size, see
+ * ::Flashboot_SetBackupMemory.
+ *
+ * @param[in] this          Context struct that must be allocated by the
+ * application.
+ * @param[in] count         Amount of generations, up to
+ * ::FLASHBOOT_MAX_GENERATIONS, 1 to keep only the last application.
+ *
+ * @return See ::Flashboot_Result
+ */
+Flashboot_eResult Flashboot_SetBackupGenerations(Flashboot_Context *this,
+                                                 uint8_t count);
+
+/*!
+ * @brief Read the MBR of a generation kept in the backup memory.
+ * @param[in] this     Struct initialized by ::Flashboot_Initialize function.
+ * @param[in] age      Generation, 0 for the newest image.
+ * @param[out] mbr     Receives the MBR of the image.
+ * @return See ::Flashboot_Result, ::Flashboot_eGeneralError if the
+ * generation has no image.
+ */
+Flashboot_eResult Flashboot_GetGeneration(Flashboot_Context *this,
+                                          uint8_t age, Flashboot_MBR *mbr);
+
+/*!
+ * @brief Copy a generation kept in the backup memory to the program memory,
+ * going back to any of the previous images.
+ * @param[in] this     Struct initialized by ::Flashboot_Initialize function.
+ * @param[in] age      Generation, 0 for the newest image.
+ * @return See ::Flashboot_Result
+ */
+Flashboot_eResult Flashboot_RestoreGeneration(Flashboot_Context *this,
+                                              uint8_t age);
+
+/*!
+ * @brief Read the counters of the operations done by the loader, as the bytes
+ * read, the pages written, the sectors erased and the ticks spent in each
+ * state, to see where the time of an update goes.
+ * @param[in] this     Struct initialized by ::Flashboot_Initialize function.
+ * @param[out] stats   Receives the counters.
+ * @return See ::Flashboot_Result
+ */
+Flashboot_eResult Flashboot_ReadStats(Flashboot_Context *this,
+                                      Flashboot_Stats *stats);
+
+/*!
+ * @brief Clear the counters of the operations done by the loader, they're
+ * cleared by ::Flashboot_Initialize too.
+ * @param[in] this     Struct initialized by ::Flashboot_Initialize function.
+ * @return See ::Flashboot_Result
+ */
+Flashboot_eResult Flashboot_ResetStats(Flashboot_Context *this);
+
+/*!
+ * Set a spare memory used to preserve the content of a sector bigger than the
+ * work buffer, when only a part of the sector is erased. The content is
+ * streamed through the work buffer to the scratch memory and back after the
+ * sector erase, so the RAM used doesn't scale with the sector size. The whole
+ * scratch memory is erased on each use, thus it's usually a single sector
+ * as big as the biggest sector of the other memories.
+ *
+ * @param[in] this          Context struct that must be allocated by the
+ * application.
+ * @param[in] scratchMemory Memory region reserved to the loader.
+ *
+ * @return See ::Flashboot_Result
+ */
+Flashboot_eResult Flashboot_SetScratchMemory(Flashboot_Context *this,
+                                             Flashboot_Memory *scratchMemory);
+
+/*!
+ * @brief Enable the A/B mode, the application is booted in place from one of
+ * two slots instead of copied into the program memory.
+ * @details The slot booted is selected by a small record, appended to its
+ * memory on each switch. The record memory shall have two sectors at least,
+ * its halves are erased in turns, so a reset during an erase keeps the
+ * current record. The updates are written in the slot not in use, at
+ * the same offset they'd have in the program memory, and switch the record
+ * when finished. The address of the slot is passed to
+ * Flashboot_Interface::Boot, so the image shall be position independent or
+ * the banks swapped by the hardware. When the image of the selected slot is
+ * corrupted the other one is booted.
+ *
+ * @param[in] this          Context struct that must be allocated by the
+ * application.
+ * @param[in] slotMemory    The second slot, the first one is the program
+ * memory.
+ * @param[in] recordMemory  Memory reserved to the slot-selection records.
+ *
+ * @return See ::Flashboot_Result
+ */
+Flashboot_eResult Flashboot_SetSlots(Flashboot_Context *this,
+                                     Flashboot_Memory *slotMemory,
+                                     Flashboot_Memory *recordMemory);
+
+/*!
+ * @brief Select the slot not in use to be booted, going back to the previous
+ * image in A/B mode.
+ * @param[in] this     Struct initialized by ::Flashboot_Initialize function.
+ * @return See ::Flashboot_Result, ::Flashboot_eGeneralError if the other slot
+ * has no image.
+ */
+Flashboot_eResult Flashboot_Rollback(Flashboot_Context *this);
+
+/*!
+ * @brief Enable the update journal, an update interrupted by a reset is
+ * resumed from its last checkpoint instead of started again.
+ * @details Each update records its session in the journal before the erase,
+ * and a checkpoint with the offset written so far and its CRC every
+ * ::FLASHBOOT_JOURNAL_INTERVAL bytes. The entries are appended to the journal
+ * memory, a half is erased only when the other one is full. A single sector
+ * is enough, but with two the last entry survives a reset during the erase.
+ * The host resumes with the Flashboot_UpdateResume command and continues
+ * from the offset replied, after checking the CRC up to it.
+ *
+ * @param[in] this          Context struct that must be allocated by the
+ * application.
+ * @param[in] journalMemory Memory reserved to the journal.
+ *
+ * @return See ::Flashboot_Result
+ */
+Flashboot_eResult Flashboot_SetJournalMemory(Flashboot_Context *this,
+                                             Flashboot_Memory *journalMemory);
+
+/*!
+ * Write a table with the CRC of each block of the images after their MBR, so
+ * the boot check stops at the first corrupted block and the recovery from the
+ * backup memory copies only the corrupted blocks.
+ * @details The table is written by each update before its MBR, images without
+ * a table are checked as a whole. A block size multiple of the sector size of
+ * the program memory avoids preserving the neighbour blocks on a repair.
+ *
+ * @param[in] this          Context struct that must be allocated by the
+ * application.
+ * @param[in] blockSize     Size of the blocks, multiple of the page size of
+ * the program memory, 0 to write no table.
+ *
+ * @return See ::Flashboot_Result
+ */
+Flashboot_eResult Flashboot_SetBlockCRC(Flashboot_Context *this,
+                                        uint32_t blockSize);
+
+/*!
+ * Select how much of the application is checked on each boot, trading the
+ * boot time for the coverage.
+ * @details The policies other than ::Flashboot_eVerifyFull need the CRC table
+ * of ::Flashboot_SetBlockCRC, images without it are always checked as a whole.
+ * The first boot after an image is written checks it as a whole and marks it
+ * verified after its table, a boot after a failed one checks it as a whole
+ * too.
+ * ::Flashboot_eVerifySampled checks ::FLASHBOOT_VERIFY_SAMPLES blocks selected
+ * by the boot count, so consecutive boots cover the whole image.
+ * In A/B mode each slot is checked this way before it's selected, an image
+ * found corrupted rolls back to the other slot.
+ *
+ * @param[in] this          Context struct that must be allocated by the
+ * application.
+ * @param[in] policy        Check done on each boot, see ::Flashboot_eVerify.
+ * @param[in] bootCount     Boots counted by the application, kept across
+ * resets.
+ * @param[in] successBoot   Indicate if the last boot was successfully, the
+ * whole image is checked if not.
+ *
+ * @return See ::Flashboot_Result
+ */
+Flashboot_eResult Flashboot_SetVerifyPolicy(Flashboot_Context *this,
+                                            Flashboot_eVerify policy,
+                                            uint32_t bootCount,
+                                            bool successBoot);
+
 /*!
  * @brief Execute the Flashboot in a cooperative way.
  * @param[in] this    Struct initialized by ::Flashboot_Initialize function.
@@ -89,7 +266,25 @@ Flashboot_eResult Flashboot_ProcessProtocol(Flashboot_Context *this,
  * @return See ::Flashboot_Result
  */
 Flashboot_eResult Flashboot_StartLoad(Flashboot_Context *this, bool selfUpdate,
-                                      const uint64_t address, uint32_t size);
+                                      const uint64_t address, uint64_t size);
+
+/*!
+ * @brief Resume the update interrupted by a reset, see
+ * ::Flashboot_SetJournalMemory.
+ * @param[in] this     Struct initialized by ::Flashboot_Initialize function.
+ * @param[in] selfUpdate The same passed to ::Flashboot_StartLoad.
+ * @param[in] address  The start address to load the FW.
+ * @param[in] size     FW size.
+ * @param[in] version  Version expected for the update, 0 for the updates
+ * started by ::Flashboot_StartLoad.
+ * @param[out] offset  Offset of the FW the slices shall continue from.
+ * @return See ::Flashboot_Result, ::Flashboot_eGeneralError if the journal
+ * doesn't record this update.
+ */
+Flashboot_eResult Flashboot_ResumeLoad(Flashboot_Context *this,
+                                       bool selfUpdate, const uint64_t address,
+                                       uint64_t size, uint32_t version,
+                                       uint64_t *offset);
 
 /*!
  * @brief Write a slice of the update process.
@@ -10,6 +10,11 @@
 
 #define PACKET_SIZE 256
 
+/*!
+ * Maximum amount of commands in a ::Flashboot_Batch frame.
+ */
+#define BATCH_MAX_COMMANDS 16
+
 /*!
  * The Flashboot_CmdId enumeration define the commands available for the LD
  * protocol.
@@ -25,8 +30,56 @@ typedef enum __attribute__((__packed__)) {
                          Flashboot_UpdateStart   command*/
   Flashboot_Result, /*!< Reply from the boot loader to the host application with
                  the execution status of a command*/
+  Flashboot_RangeCRC, /*!< Request the CRCs of a list of memory ranges*/
+  Flashboot_UpdateFill, /*!< Fill a region of the update with a constant value
+                           instead of transferring it*/
+  Flashboot_ReadMemory, /*!< Start streaming a memory range to the host*/
+  Flashboot_ReadData,   /*!< Slice of the memory range streamed to the host*/
+  Flashboot_ReadAck,    /*!< Acknowledge the slices received by the host*/
+  Flashboot_Batch, /*!< Several commands executed in order with a single
+                      reply*/
+  Flashboot_UpdateResume, /*!< Continue the update interrupted by a reset from
+                             the offset recorded by the journal*/
+  Flashboot_UpdateManifest, /*!< Start an update of several images streamed
+                               back to back*/
+  Flashboot_GenerationList, /*!< Request the images kept in the backup
+                               memory, from the newest to the oldest*/
+  Flashboot_GenerationRestore, /*!< Copy an image kept in the backup memory to
+                                  the program memory*/
+  Flashboot_GetStats, /*!< Request the counters of the operations done by the
+                         boot loader*/
 } Flashboot_CmdId;
 
+/*!
+ * The Flashboot_StateId enumeration identifies the states in the time spent
+ * per state, see Flashboot_Frame::statsResult.
+ */
+typedef enum {
+  Flashboot_StateIdle,
+  Flashboot_StateGetVersion,
+  Flashboot_StateBoot,
+  Flashboot_StateUpdateStart,
+  Flashboot_StateUpdateTransfer,
+  Flashboot_StateUpdateFinish,
+  Flashboot_StateUpdateResume,
+  Flashboot_StateUpdateManifest,
+  Flashboot_StateGenerationList,
+  Flashboot_StateGenerationRestore,
+  Flashboot_StateUpdateFill,
+  Flashboot_StateRangeCRC,
+  Flashboot_StateReadMemory,
+  Flashboot_StateReadStream,
+  Flashboot_StateReadAck,
+  Flashboot_StateBatch,
+  Flashboot_StateCheckCRC,
+  Flashboot_StateCheckProgramMemory,
+  Flashboot_StateCheckDataMemory,
+  Flashboot_StateCheckBackupMemory,
+  Flashboot_StateBackupFW,
+  Flashboot_StateGetStats,
+  Flashboot_StateCount, /*!< Amount of states*/
+} Flashboot_StateId;
+
 #pragma pack(push, 1)
 /*!
  * The Flashboot_Frame defines how the Flashboot protocol will format the data.
@@ -42,11 +95,25 @@ typedef struct {
 
     struct {
       uint8_t startAddress[8]; /*!< User application start address.*/
-      uint8_t size[4];         /*!< Total size of the user application.*/
+      uint8_t size[8];         /*!< Total size of the user application.*/
+      uint8_t version[4]; /*!< Optional, version expected for the update, it
+                             identifies the update to be resumed.*/
+      uint8_t blockSize[4]; /*!< Optional, block size of a differential update.
+                               The memory content is kept and only the blocks
+                               sent are erased and written again, 0 to erase
+                               the whole memory.*/
     } updateStart;
 
+    struct {
+      uint8_t startAddress[8]; /*!< User application start address.*/
+      uint8_t size[8];         /*!< Total size of the user application.*/
+      uint8_t version[4];      /*!< Version expected for the update.*/
+    } updateResume;
+
     struct {
       uint8_t packetID[2];         /*!< Packet Id.*/
+      uint8_t offset[8];           /*!< Packet offset from the start address.*/
+      uint8_t crc[4];              /*!< CRC of the packet payload.*/
       uint8_t packet[PACKET_SIZE]; /*!< Payload with a part of the user
                                       application.*/
     } updateTransfer;
@@ -56,9 +123,111 @@ typedef struct {
       uint8_t version[4]; /*!< User application version.*/
     } updateFinish;
 
+    struct {
+      uint8_t count; /*!< Amount of images, the first one is booted.*/
+      struct {
+        uint8_t address[8]; /*!< Image start address.*/
+        uint8_t size[8];    /*!< Image size.*/
+        uint8_t crc[4];     /*!< Image CRC.*/
+        uint8_t version[4]; /*!< Image version.*/
+      } image[PACKET_SIZE / 24];
+    } updateManifest;
+
+    struct {
+      uint8_t age; /*!< Generation restored, 0 for the newest image.*/
+    } generationRestore;
+
+    struct {
+      uint8_t reset; /*!< Optional, not 0 to clear the counters after they're
+                        replied.*/
+    } getStats;
+
+    struct {
+      uint8_t offset[8]; /*!< Region offset from the start address.*/
+      uint8_t size[8];   /*!< Region size.*/
+      uint8_t value;     /*!< Value of every byte of the region.*/
+    } updateFill;
+
+    struct {
+      uint8_t count; /*!< Amount of ranges.*/
+      struct {
+        uint8_t address[8];   /*!< Range start address.*/
+        uint8_t size[8];      /*!< Range size.*/
+        uint8_t blockSize[4]; /*!< Size of the blocks the range is split
+                                 into, 0 to get a single CRC of the range.*/
+      } range[PACKET_SIZE / 20];
+    } rangeCRC;
+
+    struct {
+      uint8_t address[8]; /*!< Range start address.*/
+      uint8_t size[8];    /*!< Range size.*/
+      uint8_t window;     /*!< Amount of slices sent without waiting for an
+                             acknowledge.*/
+    } readMemory;
+
+    struct {
+      uint8_t packetID[2];         /*!< Packet Id.*/
+      uint8_t offset[8];           /*!< Packet offset from the start address.*/
+      uint8_t crc[4];              /*!< CRC of the packet payload.*/
+      uint8_t packet[PACKET_SIZE]; /*!< Payload with a slice of the range.*/
+    } readData;
+
+    struct {
+      uint8_t packetID[2]; /*!< Id of the last packet received in order.*/
+    } readAck;
+
+    struct {
+      uint8_t frames[PACKET_SIZE]; /*!< Sequence of frames, each one preceded
+                                      by its size in 2 bytes. It may extend up
+                                      to the size of the received frame.*/
+    } batch;
+
     struct {
       uint8_t result; /*!< Command execution status result.*/
     } Result;
+
+    struct {
+      uint8_t result; /*!< Result of the first command failed, or OK.*/
+      uint8_t count;  /*!< Amount of commands executed.*/
+      uint8_t results[BATCH_MAX_COMMANDS]; /*!< Result of each command.*/
+    } batchResult;
+
+    struct {
+      uint8_t result; /*!< Command execution status result.*/
+      uint8_t count;  /*!< Amount of CRCs.*/
+      uint8_t crc[PACKET_SIZE / 4][4]; /*!< CRC of each block of the requested
+                                          ranges in order.*/
+    } rangeCRCResult;
+
+    struct {
+      uint8_t result;    /*!< Command execution status result.*/
+      uint8_t offset[8]; /*!< Offset the host shall continue from.*/
+      uint8_t crc[4];    /*!< CRC of the update up to the offset.*/
+    } updateResumeResult;
+
+    struct {
+      uint8_t result; /*!< Command execution status result.*/
+      uint8_t count;  /*!< Amount of generations.*/
+      struct {
+        uint8_t version[4]; /*!< Image version.*/
+        uint8_t size[8];    /*!< Image size, 0 if the generation has none.*/
+        uint8_t crc[4];     /*!< Image CRC.*/
+      } generation[PACKET_SIZE / 16];
+    } generationListResult;
+
+    struct {
+      uint8_t result;           /*!< Command execution status result.*/
+      uint8_t bytesRead[8];     /*!< Bytes read from the memories.*/
+      uint8_t pagesWritten[4];  /*!< Pages written.*/
+      uint8_t sectorsErased[4]; /*!< Sectors erased.*/
+      uint8_t erasesSkipped[4]; /*!< Sector erases skipped by a blank check.*/
+      uint8_t crcBytes[8];      /*!< Bytes the CRC was calculated over.*/
+      uint8_t mbrProbes[4];     /*!< Addresses probed looking for the MBR.*/
+      uint8_t retransmits[4];   /*!< Packets the host was asked to resend.*/
+      uint8_t states;           /*!< Amount of times in stateTime.*/
+      uint8_t stateTime[PACKET_SIZE / 8][4]; /*!< Milliseconds spent in each
+                                                state, by ::Flashboot_StateId*/
+    } statsResult;
   } payload;
 } Flashboot_Frame;
 #pragma pack(pop)
@@ -83,9 +252,8 @@ typedef struct {
  * Convert a 8 bytes array to a Int64
  */
 #define FLASHBOOT_ARRAY_TO_U64(_array)                                         \
-  (uint32_t)((_array[0] << 56) | (_array[1] << 48) | (_array[2] << 40) |       \
-             (_array[3] << 32)(_array[4] << 24) | (_array[5] << 16) |          \
-             (_array[6] << 8) | (_array[7] << 0))
+  (uint64_t)(((uint64_t)FLASHBOOT_ARRAY_TO_U32(_array) << 32) |                \
+             FLASHBOOT_ARRAY_TO_U32((_array + 4)))
 
 /*!
  * Convert Int64 to a 8 bytes array
@@ -10,6 +10,7 @@
 #include <stdint.h>
 
 typedef enum {
+  Flashboot_eRetransmitRequest = -11,
   Flashboot_eGeneralError = -10,
   Flashboot_eCRCError = -9,
   Flashboot_eNullPointerError = -8,
@@ -30,7 +31,22 @@ typedef enum {
  * before each boot.
  */
 #define MBR_MAGIC_KEY 0xFECABABE
+#define MBR_MAGIC_KEY_V2 0xFECABAB2
+#define MBR_MAGIC_KEY_COMPONENT 0xFECABAC0
 #define MBR_ALINGMENT 256
+
+/*!
+ * Check if a magic key identifies an MBR of any layout.
+ */
+#define MBR_IS_MAGIC_KEY(_key)                                                 \
+  ((_key) == MBR_MAGIC_KEY || (_key) == MBR_MAGIC_KEY_V2 ||                    \
+   (_key) == MBR_MAGIC_KEY_COMPONENT)
+
+/*!
+ * First MBR layout, the boot address and the size have 32 bits. It's still
+ * written when the image fits it, so the MBRs remain readable by the previous
+ * releases.
+ */
 typedef struct {
   uint32_t magicKey; /*!< Four bytes number used to identify the struct in the
                         memory. See ::MBR_MAGIC_KEY*/
@@ -43,8 +59,108 @@ typedef struct {
                    every boot to verify integrity*/
   uint64_t mbrAddress; /*!< Application start address */
   uint32_t rfu[1];     /*!< Reserved for future use*/
+} Flashboot_MBRv1;
+
+/*!
+ * MBR with 64 bits addresses and size, for images in big external storages.
+ * It's the layout written when the image doesn't fit ::Flashboot_MBRv1 and
+ * the one kept by the loader after reading an MBR of any layout. The
+ * components of a multi-image update have this layout with
+ * ::MBR_MAGIC_KEY_COMPONENT, they're never booted, and the addresses of their
+ * MBRs follow the MBR of the image booted.
+ */
+typedef struct {
+  uint32_t magicKey; /*!< Four bytes number used to identify the struct in the
+                        memory. See ::MBR_MAGIC_KEY_V2*/
+  uint32_t version;  /*!< Application version filled after received from host*/
+  uint64_t loadAddress; /*!< Storage start address */
+  uint64_t
+      bootAddress; /*!< Address in program memory where it shall be loaded*/
+  uint64_t size;   /*!< Application size*/
+  uint64_t mbrAddress; /*!< Application start address */
+  uint32_t crc; /*!< Application CRC calculated after the flash process and used
+                   every boot to verify integrity*/
+  uint32_t components; /*!< Amount of component MBR addresses, 64 bits each,
+                          after this MBR. They're checked before each boot*/
 } Flashboot_MBR;
 
+/*!
+ * The Flashboot_BlockTable struct heads the table of block CRCs of an image,
+ * see ::Flashboot_SetBlockCRC. It's aligned as an MBR after the MBR of the
+ * image and the addresses of its components, and followed by one CRC of 32
+ * bits per block. The blocks are aligned to their size, the first and the last
+ * ones may be shorter. The last CRC continues Flashboot_BlockTable::crc over
+ * the ones of the blocks.
+ */
+#define BLOCK_TABLE_MAGIC_KEY 0xB10CCBC0
+typedef struct {
+  uint32_t magicKey;  /*!< Identify a table, see ::BLOCK_TABLE_MAGIC_KEY*/
+  uint32_t blockSize; /*!< Size of the blocks*/
+  uint32_t count;     /*!< Amount of CRCs after the table*/
+  uint32_t crc;       /*!< CRC of the fields above*/
+} Flashboot_BlockTable;
+
+/*!
+ * Amount of blocks checked on each boot by ::Flashboot_eVerifySampled.
+ */
+#ifndef FLASHBOOT_VERIFY_SAMPLES
+#define FLASHBOOT_VERIFY_SAMPLES 1
+#endif
+
+/*!
+ * Check of the application done on each boot, see
+ * ::Flashboot_SetVerifyPolicy.
+ */
+typedef enum {
+  Flashboot_eVerifyFull = 0, /*!< The whole image is checked.*/
+  Flashboot_eVerifySampled,  /*!< ::FLASHBOOT_VERIFY_SAMPLES blocks of the CRC
+                                table are checked, rotating over the image.*/
+  Flashboot_eVerifyHeader,   /*!< Only the MBR and the CRC table are checked.*/
+} Flashboot_eVerify;
+
+/*!
+ * Biggest amount of images in a multi-image update, see
+ * ::Flashboot_UpdateManifest.
+ */
+#ifndef FLASHBOOT_MAX_IMAGES
+#define FLASHBOOT_MAX_IMAGES 4
+#endif
+
+/*!
+ * The Flashboot_Image struct describes an image of a multi-image update.
+ */
+typedef struct {
+  uint64_t address; /*!< Address the image is written at*/
+  uint64_t size;    /*!< Image size*/
+  uint32_t crc;     /*!< Image CRC*/
+  uint32_t version; /*!< Image version*/
+} Flashboot_Image;
+
+/*!
+ * Biggest page size supported, pages are assembled in the
+ * ::Flashboot_Context when a slice of the update doesn't end in a page
+ * boundary.
+ */
+#ifndef FLASHBOOT_MAX_PAGE_SIZE
+#define FLASHBOOT_MAX_PAGE_SIZE 256
+#endif
+
+/*!
+ * Smallest work buffer accepted, besides a page it holds the replies and the
+ * header of the frames streamed to the host. Sectors bigger than the work
+ * buffer are preserved through the scratch memory, see
+ * ::Flashboot_SetScratchMemory.
+ */
+#define FLASHBOOT_MIN_WORK_BUFFER 64
+
+/*!
+ * Amount of bytes of an update written between two checkpoints of the update
+ * journal, see ::Flashboot_SetJournalMemory.
+ */
+#ifndef FLASHBOOT_JOURNAL_INTERVAL
+#define FLASHBOOT_JOURNAL_INTERVAL 4096
+#endif
+
 /*!
  * The Interface struct is used for the Boot Loader to hold the callbacks that
  * implement platform dependent functions, thus the Boot Loader remains platform
@@ -61,6 +177,19 @@ typedef struct {
    */
   uint32_t (*WriteMemPage)(void *arg, uint64_t address, uint8_t *data);
 
+  /*!
+   * Optional, function shall write several pages at once. See
+   * Flashboot_Memory::writeBlockSize.
+   * @param arg       Void pointer to the argument passed during the
+   * initialization.
+   * @param address   Address of the first page.
+   * @param data      data to be written.
+   * @param size      Size of the data, multiple of the page size.
+   * @return          The amount of bytes written.
+   */
+  uint32_t (*WriteMem)(void *arg, uint64_t address, uint8_t *data,
+                       uint32_t size);
+
   /*!
    * Function shall read the memory.
    * @param arg       Void pointer to the argument passed during the
@@ -82,6 +211,17 @@ typedef struct {
    */
   uint32_t (*EraseMemSector)(void *arg, uint64_t address);
 
+  /*!
+   * Optional, function shall erase a block of memory bigger than a sector. See
+   * Flashboot_Memory::blockSizes.
+   * @param arg       Void pointer to the argument passed during the
+   * initialization.
+   * @param address   Address of the block, aligned to its size.
+   * @param size      Size of the block.
+   * @return          1 if the block was erased, 0 if not.
+   */
+  uint32_t (*EraseMemBlock)(void *arg, uint64_t address, uint32_t size);
+
   /*!
    * Function shall enable/disable the memory protection.
    * @param arg       Void pointer to the argument passed during the
@@ -146,17 +286,162 @@ typedef struct {
   void (*SetError)(void *arg, Flashboot_eResult error);
 } Flashboot_Interface;
 
+/*!
+ * Capability of a ::Flashboot_MemoryDriver whose memory is mapped in the
+ * address space, it's read and verified straight from the address instead of
+ * through Flashboot_MemoryDriver::ReadMem.
+ */
+#define FLASHBOOT_DRIVER_MAPPED_READ (1 << 0)
+
+/*!
+ * The Flashboot_MemoryDriver struct holds the callbacks of a specific memory,
+ * as the internal flash, a QSPI NOR or a RAM, so each one has its optimal
+ * driver and the callbacks don't need to decode the address. A callback not
+ * set is replaced by the one of the ::Flashboot_Interface.
+ */
+typedef struct {
+  /*! See Flashboot_Interface::WriteMemPage*/
+  uint32_t (*WriteMemPage)(void *arg, uint64_t address, uint8_t *data);
+  /*! See Flashboot_Interface::WriteMem*/
+  uint32_t (*WriteMem)(void *arg, uint64_t address, uint8_t *data,
+                       uint32_t size);
+  /*! See Flashboot_Interface::ReadMem*/
+  uint32_t (*ReadMem)(void *arg, uint64_t address, uint8_t *data,
+                      uint32_t size);
+  /*! See Flashboot_Interface::EraseMemSector*/
+  uint32_t (*EraseMemSector)(void *arg, uint64_t address);
+  /*! See Flashboot_Interface::EraseMemBlock*/
+  uint32_t (*EraseMemBlock)(void *arg, uint64_t address, uint32_t size);
+  /*! See Flashboot_Interface::ProtectMem*/
+  uint32_t (*ProtectMem)(void *arg, bool lock);
+  void *arg; /*!< Argument passed to the callbacks, when NULL the one passed
+                during the initialization is used.*/
+  uint32_t capabilities; /*!< Fast paths supported, as
+                            ::FLASHBOOT_DRIVER_MAPPED_READ */
+} Flashboot_MemoryDriver;
+
+/*!
+ * Flag of a ::Flashboot_Memory that programs bits from 1 to 0 without erasing,
+ * as NOR memories. Data that only clears bits of the current content is
+ * programmed in place and the sectors are erased only when the update reaches
+ * them and they're not blank.
+ */
+#define FLASHBOOT_MEMORY_BIT_CLEAR (1 << 0)
+
+/*!
+ * Flag of a ::Flashboot_Memory that is written without erasing, as eMMC, SD
+ * cards or battery-backed RAM. The erases and blank checks are skipped.
+ */
+#define FLASHBOOT_MEMORY_ERASE_FREE (1 << 1)
+
+/*!
+ * The Flashboot_SectorRegion struct describes a sequence of sectors with the
+ * same size in a ::Flashboot_Memory.
+ */
+typedef struct {
+  uint32_t count; /*!< Amount of sectors in the region */
+  uint32_t size;  /*!< Size of each sector in the region */
+} Flashboot_SectorRegion;
+
 /*! The Flashboot_MemoryConfig struct is used to hold the memory configuration.
  * As it is a platform dependent information it helps the Boot Loader to deal
  * with different memories types
  */
 typedef struct {
   uint64_t startAddress; /*!< Application memory area start address */
-  uint32_t size;         /*!< Application memory area size          */
+  uint64_t size;         /*!< Application memory area size          */
   uint32_t pageSize;     /*!< Minimum writable size                 */
   uint32_t sectorSize;   /*!< Minimum erasable size                 */
+  const Flashboot_SectorRegion
+      *sectorMap; /*!< Optional, regions of the memory from the start address
+                     when the sectors don't have all the same size. */
+  uint32_t sectorMapCount; /*!< Amount of regions in the sectorMap */
+  const uint32_t
+      *blockSizes; /*!< Optional, sizes bigger than a sector that can be erased
+                      at once by Flashboot_Interface::EraseMemBlock, as the
+                      block or chip erase of NOR memories. */
+  uint32_t blockSizeCount; /*!< Amount of sizes in blockSizes */
+  uint32_t flags; /*!< Memory features, as ::FLASHBOOT_MEMORY_BIT_CLEAR */
+  uint32_t writeBlockSize; /*!< Optional, preferred size of the writes done
+                              by Flashboot_Interface::WriteMem, multiple of
+                              the page size. */
+  const Flashboot_MemoryDriver
+      *driver; /*!< Optional, callbacks specific to this memory. */
 } Flashboot_Memory;
 
+/*!
+ * The Flashboot_SlotRecord struct selects the slot booted in A/B mode, see
+ * ::Flashboot_SetSlots. The records are appended to their memory, the one
+ * with the biggest sequence is the current.
+ */
+#define SLOT_RECORD_MAGIC_KEY 0x5107AB5E
+typedef struct {
+  uint32_t magicKey; /*!< Identify a record, see ::SLOT_RECORD_MAGIC_KEY*/
+  uint32_t sequence; /*!< Incremented on each record written*/
+  uint32_t active;   /*!< Slot booted, 0 for the program memory and 1 for the
+                        other slot*/
+  uint32_t crc;      /*!< CRC of the fields above*/
+} Flashboot_SlotRecord;
+
+/*!
+ * Biggest amount of image generations kept in the backup memory, see
+ * ::Flashboot_SetBackupGenerations.
+ */
+#ifndef FLASHBOOT_MAX_GENERATIONS
+#define FLASHBOOT_MAX_GENERATIONS 8
+#endif
+
+/*!
+ * The Flashboot_GenerationRecord struct dates the image of a slot of the
+ * backup memory, see ::Flashboot_SetBackupGenerations. The records are
+ * appended to the last sector of their slot, the slot with the biggest
+ * sequence keeps the newest image.
+ */
+#define GENERATION_RECORD_MAGIC_KEY 0x6E4E0B4C
+typedef struct {
+  uint32_t magicKey; /*!< Identify a record, see
+                        ::GENERATION_RECORD_MAGIC_KEY*/
+  uint32_t sequence; /*!< Incremented on each image stored in the ring*/
+  uint32_t crc;      /*!< CRC of the fields above*/
+} Flashboot_GenerationRecord;
+
+/*!
+ * The Flashboot_JournalEntry struct records the update in progress, see
+ * ::Flashboot_SetJournalMemory. The entries are appended to their memory, the
+ * one with the biggest sequence is the current.
+ */
+#define JOURNAL_MAGIC_KEY 0x10B5E55A
+typedef struct {
+  uint32_t magicKey;     /*!< Identify an entry, see ::JOURNAL_MAGIC_KEY*/
+  uint32_t sequence;     /*!< Incremented on each entry written*/
+  uint64_t startAddress; /*!< Address the update is written at*/
+  uint64_t bootAddress;  /*!< Boot address informed by the host*/
+  uint64_t size;         /*!< Update size, 0 when no update is in progress*/
+  uint64_t committed; /*!< Offset from the start address written and checked*/
+  uint32_t committedCRC; /*!< CRC of the update up to the committed offset*/
+  uint32_t version;      /*!< Version expected for the update*/
+  uint32_t imageCRC; /*!< CRC expected for the update, 0 when it's unknown*/
+  uint32_t crc;          /*!< CRC of the fields above*/
+} Flashboot_JournalEntry;
+
+/*!
+ * The Flashboot_Stats struct holds the counters of the operations done by the
+ * loader since it was initialized or the counters were reset.
+ */
+typedef struct {
+  uint64_t bytesRead;     /*!< Bytes read from the memories. */
+  uint32_t pagesWritten;  /*!< Pages written. */
+  uint32_t sectorsErased; /*!< Sectors erased, a block erase counts all the
+                             sectors of the block. */
+  uint32_t erasesSkipped; /*!< Sector erases skipped because a blank check
+                             found the sectors erased already. */
+  uint64_t crcBytes;      /*!< Bytes the CRC was calculated over. */
+  uint32_t mbrProbes;     /*!< Addresses probed looking for the MBR. */
+  uint32_t retransmits;   /*!< Packets the host was asked to resend. */
+  uint32_t stateTime[Flashboot_StateCount]; /*!< Ticks spent in each state, by
+                                               ::Flashboot_StateId. */
+} Flashboot_Stats;
+
 /*!
  * The Flashboot_Context struct defines the Boot Loader class with its
  * attributes and callbacks.
@@ -169,6 +454,7 @@ typedef struct {
       result; /*!< Used to hold the current status. See ::Flashboot_Result.*/
   bool commandMode;       /*!< Used to flag if the loader is in command mode.*/
   bool createBackup;      /*!< Check if backup is required.*/
+  bool batch; /*!< Replies are aggregated by a batch instead of sent.*/
   Flashboot_Frame *frame; /*!< Pointer to a received protocol frame. */
   uint32_t frameSize;     /*!< Received protocol frame size. */
   Flashboot_Memory
@@ -180,11 +466,28 @@ typedef struct {
   Flashboot_Memory
       *backupMem;                     /*!< Point to the backup memory which is
                                      initialized      by ::Flashboot_Initialize function. */
+  Flashboot_Memory
+      *scratchMem; /*!< Point to the memory used to preserve the content of
+                      sectors bigger than the work buffer. */
+  uint8_t memoryHint; /*!< Memory found by the last ::Flashboot_GetMemory
+                         call, it's checked first. */
   uint8_t *workBuffer;                /*!< Buffer for general use. */
   uint32_t wbs;                       /*!< Work buffer size. */
   uint32_t timeout;                   /*!< Hold the command mode timeout. */
+  uint32_t blockSize; /*!< Size of the blocks of the CRC table written with
+                         each image, 0 without a table. */
+  struct {
+    Flashboot_eVerify policy; /*!< Check done on this boot. */
+    uint32_t bootCount;       /*!< Selects the blocks sampled. */
+  } verify;
   Flashboot_MBR mbr;                  /*!< Copy of the MBR. */
   void (*Flashboot_State)(void *arg); /*!< Hold the current state function. */
+  Flashboot_Stats stats; /*!< Counters of the operations done. */
+  struct {
+    Flashboot_StateId state; /*!< State executed last, Flashboot_StateCount
+                                  before the first one. */
+    uint32_t tick;           /*!< Tick the last state started at. */
+  } timing;
 
   /*hold a update process information*/
   struct {
@@ -193,10 +496,65 @@ typedef struct {
     uint64_t startAddress; /*!< Hold the start address of the current update to
                               calculate the CRC in the end of the process. */
     uint64_t currentAddress; /*!< Point the current written address. */
-    uint32_t size; /*!< Hold the current update size to calculate the CRC in the
+    uint64_t erasedAddress;  /*!< End of the range ready to be programmed. */
+    uint32_t keepBlock; /*!< Block size of a differential update, which keeps
+                           the memory content the blocks sent don't reach. 0
+                           when the memory is erased by the start. */
+    uint64_t size; /*!< Hold the current update size to calculate the CRC in the
                       end of the process. */
     Flashboot_Memory *memory;
+    const Flashboot_MBR *origin; /*!< MBR of the image copied, its components
+                                    are listed by the copy. NULL for an update
+                                    from the host. */
+    uint8_t page[FLASHBOOT_MAX_PAGE_SIZE]; /*!< Assembly of the page that ends
+                                              after the current address. */
+    uint32_t pageFill; /*!< Amount of bytes assembled in page, which are before
+                          the current address but not written yet. */
   } update;
+
+  /*hold a memory read process information*/
+  struct {
+    uint64_t startAddress;   /*!< Start address of the range. */
+    uint64_t currentAddress; /*!< Next address to be sent. */
+    uint64_t endAddress;     /*!< End address of the range. */
+    uint64_t ackAddress;     /*!< Address of the next packet to be
+                                acknowledged, the stream goes back to it. */
+    uint32_t slice;          /*!< Payload of each packet but the last one. */
+    uint16_t packetID;       /*!< Id of the next packet to be sent. */
+    uint16_t ackID;          /*!< Id of the next packet to be acknowledged. */
+    uint8_t window; /*!< Amount of packets sent without an acknowledge. */
+  } read;
+  /*hold the A/B slots information*/
+  struct {
+    Flashboot_Memory *memory[2]; /*!< Slots, the first one is the program
+                                    memory. */
+    Flashboot_Memory *record;    /*!< Memory of the slot-selection records. */
+    uint64_t next;     /*!< Address of the next record to be written. */
+    uint32_t sequence; /*!< Sequence of the current record, 0 if none. */
+    uint8_t active;    /*!< Slot in use, the other one receives the updates. */
+  } slots;
+  /*hold the update journal information*/
+  struct {
+    Flashboot_Memory *memory;     /*!< Memory of the journal entries. */
+    Flashboot_JournalEntry entry; /*!< Current entry, its committed offset and
+                                     CRC are the running CRC of the update. */
+    uint64_t next; /*!< Address of the next entry to be written. */
+  } journal;
+  /*hold the backup generations information*/
+  struct {
+    Flashboot_Memory slot;   /*!< Slot of the backup memory in use. */
+    Flashboot_Memory record; /*!< Records of the slot in use. */
+    uint8_t count; /*!< Amount of slots the backup memory is split into. */
+  } generations;
+  /*hold the images of a multi-image update*/
+  struct {
+    Flashboot_Image image[FLASHBOOT_MAX_IMAGES]; /*!< Images in the order they
+                                                    are streamed, the first one
+                                                    is booted. */
+    uint64_t offset; /*!< Offset of the image being written in the stream. */
+    uint8_t count;   /*!< Amount of images, 0 for single image updates. */
+    uint8_t current; /*!< Image being written. */
+  } manifest;
 } Flashboot_Context;
 
 #define Flashboot_ASSERT(_x, _y)                                               \
@@ -3,130 +3,586 @@
 // SPDX-License-Identifier: Apache-2.0
 
 #include "Helper.h"
+#include "Flashboot_States.h"
 #include "Flashboot_Types.h"
 #include "config.h"
+#include <stddef.h>
 #include <string.h>
 
+/*!
+ * Argument of the driver callbacks
+ */
+#define DRIVER_ARG(_this, _driver)                                             \
+  ((_driver)->arg ? (_driver)->arg : (_this)->arg)
+
+/*!
+ * Check if a callback is available for a memory, either in its driver or in
+ * the interface
+ */
+#define HAS_CALLBACK(_this, _memory, _callback)                                \
+  (((_memory)->driver && (_memory)->driver->_callback) ||                      \
+   (_this)->interface->_callback)
+
+/*!
+ * Call a callback of the memory driver, or of the interface when the driver
+ * doesn't have it
+ */
+#define CALL_DRIVER(_this, _memory, _callback, ...)                            \
+  (((_memory)->driver && (_memory)->driver->_callback)                         \
+       ? (_memory)->driver->_callback(DRIVER_ARG(_this, (_memory)->driver),    \
+                                      __VA_ARGS__)                             \
+       : (_this)->interface->_callback((_this)->arg, __VA_ARGS__))
+
+/*!
+ * Biggest range calculated in place by a single Flashboot_Interface::CalcCRC
+ * call
+ */
+#define CRC_MAPPED_CHUNK 0x40000000
+
+uint32_t Flashboot_ReadMem(Flashboot_Context *this, uint64_t address,
+                           uint8_t *data, uint32_t size) {
+  uint32_t read = 0;
+
+  this->stats.bytesRead += size;
+
+  /*The memory is picked by the address, a read that runs past its end
+   * continues in the memory that follows*/
+  while (read < size) {
+    const Flashboot_Memory *memory =
+        Flashboot_GetMemory(this, address + read, 1);
+    uint32_t length = size - read, done;
+
+    if (memory == NULL) {
+      return read + this->interface->ReadMem(this->arg, address + read,
+                                             data + read, length);
+    }
+
+    uint64_t left = memory->startAddress + memory->size - (address + read);
+    length = left < length ? (uint32_t)left : length;
+    if (memory->driver &&
+        (memory->driver->capabilities & FLASHBOOT_DRIVER_MAPPED_READ)) {
+      memcpy(data + read, (const void *)(uintptr_t)(address + read), length);
+      done = length;
+    } else {
+      done = CALL_DRIVER(this, memory, ReadMem, address + read, data + read,
+                         length);
+    }
+
+    read += done;
+    if (done < length) {
+      break;
+    }
+  }
+  return read;
+}
+
+uint32_t Flashboot_ProtectMem(Flashboot_Context *this,
+                              const Flashboot_Memory *memory, bool lock) {
+  return CALL_DRIVER(this, memory, ProtectMem, lock);
+}
+
+/*!
+ * Check if a range is inside a memory
+ * @param memory     Memory, may be NULL
+ * @param address    Start address of the range
+ * @param size       Size of the range
+ * @return true if the range is inside the memory
+ */
+static bool InMemory(const Flashboot_Memory *memory, uint64_t address,
+                     uint64_t size) {
+  return memory && address >= memory->startAddress &&
+         address - memory->startAddress <= memory->size &&
+         size <= memory->size - (address - memory->startAddress);
+}
+
+/*!
+ * Find the memory written or erased by a range, the one being updated when it
+ * isn't known by the loader.
+ * @param this        Struct initialized by ::Flashboot_Initialize function.
+ * @param address    Start address of the range
+ * @param size       Size of the range
+ * @return The memory, NULL if the range is outside of all memories
+ */
+static const Flashboot_Memory *
+TargetMemory(Flashboot_Context *this, uint64_t address, uint64_t size) {
+  const Flashboot_Memory *memory = Flashboot_GetMemory(this, address, size);
+
+  if (memory == NULL && InMemory(this->update.memory, address, size)) {
+    memory = this->update.memory;
+  }
+  return memory;
+}
+
 Flashboot_eResult Flashboot_MemoryWrite(Flashboot_Context *this,
                                         uint64_t address, uint8_t *data,
                                         uint32_t size) {
+  const Flashboot_Memory *memory = TargetMemory(this, address, size);
+  uint32_t blockSize;
+
+  Flashboot_ASSERT(memory == NULL, Flashboot_eAddressOutOfBoundsError);
+
   /*Check if address if aligned*/
-  if (address % this->update.memory->pageSize ||
-      size % this->update.memory->pageSize) {
+  if (address % memory->pageSize || size % memory->pageSize) {
     return Flashboot_eAlignmentError;
   }
+  this->stats.pagesWritten += size / memory->pageSize;
+
+  /*Write several pages at once when the memory prefers blocks*/
+  blockSize =
+      memory->writeBlockSize - (memory->writeBlockSize % memory->pageSize);
+  while (HAS_CALLBACK(this, memory, WriteMem) && blockSize && size) {
+    uint32_t min = size > blockSize ? blockSize : size;
+
+    CALL_DRIVER(this, memory, WriteMem, address, data, min);
+    size -= min;
+    address += min;
+    data += min;
+  }
 
-  while (size >= this->update.memory->pageSize) {
+  while (size >= memory->pageSize) {
     /*write page*/
-    this->interface->WriteMemPage(this->arg, address, data);
+    CALL_DRIVER(this, memory, WriteMemPage, address, data);
 
     /*Calculate next page and the remaining size*/
-    size -= this->update.memory->pageSize;
-    address += this->update.memory->pageSize;
-    data += this->update.memory->pageSize;
+    size -= memory->pageSize;
+    address += memory->pageSize;
+    data += memory->pageSize;
   }
   return Flashboot_eOK;
 }
 
 /*!
- * Check if the sector is erased already
+ * Check if a range of the memory is erased already
  * @param this        Struct initialized by ::Flashboot_Initialize function.
  * @param address    Start address to be checked
+ * @param size       Size to be checked
  *
  * @return
  */
-static bool IsSectorErased(Flashboot_Context *this, uint64_t address) {
-  /*Define the last sector address based on the memory information*/
+static bool IsErased(Flashboot_Context *this, uint64_t address,
+                     uint32_t size) {
+  while (size) {
+    uint32_t min = size > this->wbs ? this->wbs : size;
 
-  this->interface->ReadMem(this->arg, address, this->workBuffer,
-                           this->update.memory->sectorSize);
-  uint32_t *word = (uint32_t *)this->workBuffer;
-  /*If is not erased, then return false*/
-  for (int i = 0; i < this->update.memory->sectorSize; i += sizeof(*word)) {
-    if (*word != 0xFFFFFFFF) {
-      return false;
+    Flashboot_ReadMem(this, address, this->workBuffer, min);
+    uint32_t *word = (uint32_t *)this->workBuffer;
+    /*If is not erased, then return false*/
+    for (int i = 0; i < min; i += sizeof(*word)) {
+      if (*word != 0xFFFFFFFF) {
+        return false;
+      }
+      word++;
     }
-    word++;
+    address += min;
+    size -= min;
   }
 
   return true;
 }
 
-Flashboot_eResult Flashboot_MemoryErase(Flashboot_Context *this,
-                                        uint64_t address, uint32_t size) {
-  /* Check if the address is the in beginning of a sector.
-   * If not, the useful content of the sector shall be back up
-   */
-  if (address % this->update.memory->sectorSize) {
-    /*+-----------------------------------------------------+
-          |xxxxxxxxxxxxfffffffffffffffffffffffffffxxxxxxxxxxxxxx|
-          +-----------------------------------------------------+
-          ^ <-Offset-->^<-------erase size----->^<--tail size-->|
-          |            |                        |               ^
-          |            |                        |               |
-          |            |                        +--tail         +-- next sector
-          |			 +--address
-          +--previous sector
-           */
-    uint32_t previousSector =
-        address - (address % this->update.memory->sectorSize);
-    uint32_t nextSector = previousSector + this->update.memory->sectorSize;
-    uint64_t offset = address - previousSector;
-    int32_t tailSize = this->update.memory->sectorSize - offset - size;
-    tailSize = tailSize < 0 ? 0 : tailSize;
-    uint32_t toEraseOnSector =
-        (size > (nextSector - address)) ? (nextSector - address) : size;
+/*!
+ * Erase a sector, counting it
+ * @param this        Struct initialized by ::Flashboot_Initialize function.
+ * @param memory     Memory of the sector
+ * @param sector     Sector address
+ * @return ::Flashboot_eGeneralError if the driver didn't erase it
+ */
+static Flashboot_eResult EraseSector(Flashboot_Context *this,
+                                     const Flashboot_Memory *memory,
+                                     uint64_t sector) {
+  this->stats.sectorsErased++;
+  return CALL_DRIVER(this, memory, EraseMemSector, sector)
+             ? Flashboot_eOK
+             : Flashboot_eGeneralError;
+}
+
+/*!
+ * Check if data can be programmed over the memory content without erasing,
+ * that is, if it only clears bits. The memory is read through the work buffer
+ * in reads that double up to its size, so a difference at the beginning is
+ * found with a short read. A small buffer is used if the data is in the work
+ * buffer.
+ * @param this        Struct initialized by ::Flashboot_Initialize function.
+ * @param address    Start address to be checked
+ * @param data       Data to be programmed, NULL to check if it's erased
+ * @param size       Size to be checked
+ *
+ * @return
+ */
+static bool CanProgram(Flashboot_Context *this, uint64_t address,
+                       const uint8_t *data, uint32_t size) {
+  uint8_t small[32];
+  uint8_t *buffer = this->workBuffer;
+  uint32_t limit = this->wbs, chunk = sizeof(small);
+
+  if (data && (uintptr_t)data < (uintptr_t)(this->workBuffer + this->wbs) &&
+      (uintptr_t)(data + size) > (uintptr_t)this->workBuffer) {
+    buffer = small;
+    limit = sizeof(small);
+  }
+
+  while (size) {
+    uint32_t min = size > chunk ? chunk : size;
+
+    Flashboot_ReadMem(this, address, buffer, min);
+    for (uint32_t i = 0; i < min; i++) {
+      uint8_t value = data ? data[i] : 0xFF;
+      if ((buffer[i] & value) != value) {
+        return false;
+      }
+    }
+    address += min;
+    size -= min;
+    data = data ? data + min : NULL;
+    chunk = chunk * 2 > limit ? limit : chunk * 2;
+  }
+
+  return true;
+}
+
+uint32_t Flashboot_GetSector(const Flashboot_Memory *memory, uint64_t address,
+                             uint64_t *sector) {
+  if (memory->sectorMap == NULL) {
+    *sector = address - (address % memory->sectorSize);
+    return memory->sectorSize;
+  }
+
+  *sector = memory->startAddress;
+  for (uint32_t i = 0; i < memory->sectorMapCount && address >= *sector;
+       i++) {
+    uint32_t size = memory->sectorMap[i].size;
+    uint64_t regionSize = (uint64_t)memory->sectorMap[i].count * size;
+
+    if (address < *sector + regionSize) {
+      *sector += (address - *sector) - ((address - *sector) % size);
+      return size;
+    }
+    *sector += regionSize;
+  }
+  return 0;
+}
+
+uint32_t Flashboot_MaxSectorSize(const Flashboot_Memory *memory) {
+  uint32_t size = memory->sectorSize;
+
+  for (uint32_t i = 0; memory->sectorMap && i < memory->sectorMapCount; i++) {
+    size = memory->sectorMap[i].size > size ? memory->sectorMap[i].size : size;
+  }
+  return size;
+}
+
+/*!
+ * Select the biggest erase that starts in a sector and doesn't go beyond the
+ * end of the range.
+ * @param this        Struct initialized by ::Flashboot_Initialize function.
+ * @param memory     Memory to be erased
+ * @param address    Sector address
+ * @param end        End of the range to be erased
+ * @param sectorSize Size of the sector
+ * @return           The erase size.
+ */
+static uint32_t GetEraseSize(Flashboot_Context *this,
+                             const Flashboot_Memory *memory, uint64_t address,
+                             uint64_t end, uint32_t sectorSize) {
+  uint32_t size = sectorSize;
+
+  for (uint32_t i = 0;
+       HAS_CALLBACK(this, memory, EraseMemBlock) && memory->blockSizes &&
+       i < memory->blockSizeCount;
+       i++) {
+    uint32_t block = memory->blockSizes[i];
+    if (block > size && (address % block) == 0 && address + block <= end) {
+      size = block;
+    }
+  }
+  return size;
+}
+
+/*!
+ * Copy a range of the memory to another through the work buffer
+ * @param this        Struct initialized by ::Flashboot_Initialize function.
+ * @param to         Destination address, already erased
+ * @param from       Source address
+ * @param size       Size to be copied
+ * @return
+ */
+static Flashboot_eResult CopyMemory(Flashboot_Context *this, uint64_t to,
+                                    uint64_t from, uint32_t size) {
+  uint32_t chunk = this->wbs - (this->wbs % this->update.memory->pageSize);
+  Flashboot_eResult result = Flashboot_eOK;
+
+  while (result == Flashboot_eOK && size) {
+    uint32_t min = size > chunk ? chunk : size;
+
+    Flashboot_ReadMem(this, from, this->workBuffer, min);
+    result = Flashboot_MemoryWrite(this, to, this->workBuffer, min);
+    to += min;
+    from += min;
+    size -= min;
+  }
+  return result;
+}
+
+/*!
+ * Write the erased value over a range of an erase-free memory, the rest of the
+ * pages it touches is kept
+ * @param this        Struct initialized by ::Flashboot_Initialize function.
+ * @param memory     Memory of the range
+ * @param address    Start address of the range
+ * @param size       Size of the range
+ * @return
+ */
+static Flashboot_eResult WriteErased(Flashboot_Context *this,
+                                     const Flashboot_Memory *memory,
+                                     uint64_t address, uint64_t size) {
+  uint32_t pageSize = memory->pageSize;
+  uint32_t chunk = this->wbs - (this->wbs % pageSize);
+  uint64_t page = address - (address % pageSize), end = address + size;
+  Flashboot_eResult result = Flashboot_eOK;
+
+  while (result == Flashboot_eOK && page < end) {
+    uint32_t length = end - page > chunk ? chunk : (uint32_t)(end - page);
+    uint64_t from = address > page ? address : page;
+
+    length += (pageSize - length % pageSize) % pageSize;
+    uint64_t to = page + length < end ? page + length : end;
+
+    Flashboot_ReadMem(this, page, this->workBuffer, length);
+    memset(this->workBuffer + (from - page), 0xFF, to - from);
+    result = Flashboot_MemoryWrite(this, page, this->workBuffer, length);
+    page += length;
+  }
+  return result;
+}
+
+/*!
+ * Erase a range that is going to be written, erase-free memories are just
+ * overwritten
+ * @param this        Struct initialized by ::Flashboot_Initialize function.
+ * @param address    Start address of the range
+ * @param size       Size of the range
+ * @return
+ */
+static Flashboot_eResult EraseBeforeWrite(Flashboot_Context *this,
+                                          uint64_t address, uint64_t size) {
+  const Flashboot_Memory *memory = TargetMemory(this, address, size);
 
+  Flashboot_ASSERT(memory == NULL, Flashboot_eAddressOutOfBoundsError);
+  if (memory->flags & FLASHBOOT_MEMORY_ERASE_FREE) {
+    return Flashboot_eOK;
+  }
+  return Flashboot_MemoryErase(this, address, size);
+}
+
+/*!
+ * Erase a part of a sector preserving the rest of its content
+ * @param this        Struct initialized by ::Flashboot_Initialize function.
+ * @param memory     Memory of the sector
+ * @param sector     Sector address
+ * @param sectorSize Sector size
+ * @param offset     Offset of the range to be erased in the sector
+ * @param size       Size of the range to be erased
+ * @return
+ */
+static Flashboot_eResult EraseInSector(Flashboot_Context *this,
+                                       const Flashboot_Memory *memory,
+                                       uint64_t sector, uint32_t sectorSize,
+                                       uint32_t offset, uint32_t size) {
+  uint32_t tailSize = sectorSize - offset - size;
+  Flashboot_eResult result;
+
+  if (sectorSize <= this->wbs) {
     /*Back-up useful content from the Sector*/
-    this->interface->ReadMem(this->arg, previousSector, this->workBuffer,
-                             this->update.memory->sectorSize);
+    Flashboot_ReadMem(this, sector, this->workBuffer, sectorSize);
 
     /*Erase sector*/
-    this->interface->EraseMemSector(this->arg, previousSector);
+    result = EraseSector(this, memory, sector);
 
     /*Restore the beginning of the Sector*/
-    Flashboot_MemoryWrite(this, previousSector, this->workBuffer, offset);
+    if (result == Flashboot_eOK) {
+      result = Flashboot_MemoryWrite(this, sector, this->workBuffer, offset);
+    }
 
     /*Restore the end of the Sector if there's something to restore*/
-    if (tailSize > 0)
-      Flashboot_MemoryWrite(this, nextSector - tailSize,
-                            this->workBuffer + offset + toEraseOnSector,
-                            tailSize);
+    if (result == Flashboot_eOK && tailSize > 0) {
+      result = Flashboot_MemoryWrite(this, sector + offset + size,
+                                     this->workBuffer + offset + size,
+                                     tailSize);
+    }
+    return result;
+  }
+
+  /*The sector doesn't fit in the work buffer, its content is kept in the
+   * scratch memory at the same offsets*/
+  Flashboot_ASSERT(this->scratchMem == NULL ||
+                       this->scratchMem->size < sectorSize,
+                   Flashboot_eBufferOverflowError);
+  uint64_t scratch = this->scratchMem->startAddress;
 
-    /*calc remaining size*/
-    size -= toEraseOnSector;
+  /*The scratch memory can't preserve itself*/
+  Flashboot_ASSERT(sector >= scratch &&
+                       sector - scratch < this->scratchMem->size,
+                   Flashboot_eBufferOverflowError);
 
-    // calc address of remaining memory to erase
-    address += toEraseOnSector;
+  result = EraseBeforeWrite(this, scratch, this->scratchMem->size);
+  if (result == Flashboot_eOK) {
+    result = CopyMemory(this, scratch, sector, offset);
+  }
+  if (result == Flashboot_eOK) {
+    result = CopyMemory(this, scratch + offset + size, sector + offset + size,
+                        tailSize);
   }
 
-  /*Erase the complete sectors*/
-  while (size >= this->update.memory->sectorSize) {
-    if (!IsSectorErased(this, address)) {
-      this->interface->EraseMemSector(this->arg, address);
-    }
-    /*next address*/
-    address += this->update.memory->sectorSize;
-    size -= this->update.memory->sectorSize;
-  };
+  /*Erase sector, only once its content is safe in the scratch memory*/
+  if (result == Flashboot_eOK) {
+    result = EraseSector(this, memory, sector);
+  }
 
-  // Check if there's remaining space to erase that doesn't fit in a sector.
-  if (size > 0) {
-    /*Back-up useful content in the end of the Sector*/
-    this->interface->ReadMem(this->arg, address + size, this->workBuffer,
-                             this->update.memory->sectorSize - size);
+  /*Restore the beginning and the end of the Sector*/
+  if (result == Flashboot_eOK) {
+    result = CopyMemory(this, sector, scratch, offset);
+  }
+  if (result == Flashboot_eOK) {
+    result = CopyMemory(this, sector + offset + size, scratch + offset + size,
+                        tailSize);
+  }
+  return result;
+}
+
+Flashboot_eResult Flashboot_MemoryErase(Flashboot_Context *this,
+                                        uint64_t address, uint64_t size) {
+  const Flashboot_Memory *memory = TargetMemory(this, address, size);
+  uint64_t end = address + size;
+
+  Flashboot_ASSERT(memory == NULL, Flashboot_eAddressOutOfBoundsError);
+
+  /*There are no sectors, the erased value is written over the range*/
+  if (memory->flags & FLASHBOOT_MEMORY_ERASE_FREE) {
+    return WriteErased(this, memory, address, size);
+  }
 
-    /*Erase the whole sector*/
-    this->interface->EraseMemSector(this->arg, address);
+  while (address < end) {
+    uint64_t sector;
+    uint32_t sectorSize = Flashboot_GetSector(memory, address, &sector);
 
-    /*Restore useful content to the end of the Sector*/
-    Flashboot_MemoryWrite(this, address + size, this->workBuffer,
-                          this->update.memory->sectorSize - size);
+    Flashboot_ASSERT(sectorSize == 0, Flashboot_eAddressOutOfBoundsError);
+
+    /* Check if the range covers the whole sector.
+     * If not, the useful content of the sector shall be back up
+     */
+    if (address != sector || sector + sectorSize > end) {
+      /*+-----------------------------------------------------+
+            |xxxxxxxxxxxxfffffffffffffffffffffffffffxxxxxxxxxxxxxx|
+            +-----------------------------------------------------+
+            ^ <-Offset-->^<-------erase size----->^<--tail size-->|
+            |            |                        |               ^
+            |            |                        |               |
+            |            |                        +--tail         +-- next
+            |            +--address                                   sector
+            +--sector
+             */
+      uint32_t offset = address - sector;
+      uint32_t toEraseOnSector = (end > sector + sectorSize)
+                                     ? sectorSize - offset
+                                     : (uint32_t)(end - address);
+      Flashboot_eResult result =
+          EraseInSector(this, memory, sector, sectorSize, offset,
+                        toEraseOnSector);
+
+      Flashboot_ASSERT(result != Flashboot_eOK, result);
+      address += toEraseOnSector;
+    } else {
+      /*Erase the complete sectors with the fewest erase operations*/
+      uint32_t eraseSize =
+          GetEraseSize(this, memory, address, end, sectorSize);
+
+      if (IsErased(this, address, eraseSize)) {
+        this->stats.erasesSkipped += eraseSize / sectorSize;
+      } else if (eraseSize == sectorSize) {
+        Flashboot_ASSERT(EraseSector(this, memory, address) != Flashboot_eOK,
+                         Flashboot_eGeneralError);
+      } else {
+        this->stats.sectorsErased += eraseSize / sectorSize;
+        Flashboot_ASSERT(
+            !CALL_DRIVER(this, memory, EraseMemBlock, address, eraseSize),
+            Flashboot_eGeneralError);
+      }
+      address += eraseSize;
+    }
   }
 
   return Flashboot_eOK;
 }
 
+Flashboot_eResult Flashboot_SelectCommand(Flashboot_Context *this) {
+  Flashboot_eResult res = Flashboot_eOK;
+
+  switch (this->frame->id) {
+  case Flashboot_GetVersion:
+    this->Flashboot_State = State_GetVersion;
+    break;
+  case Flashboot_BootApplication:
+    this->Flashboot_State = State_CheckProgramMemory;
+    this->commandMode = false;
+    break;
+  case Flashboot_UpdateStart:
+    this->Flashboot_State = State_UpdateStart;
+    break;
+  case Flashboot_UpdateTransfer:
+    this->Flashboot_State = State_UpdateTransfer;
+    break;
+  case Flashboot_UpdateFinish:
+    this->Flashboot_State = State_UpdateFinish;
+    break;
+  case Flashboot_RangeCRC:
+    this->Flashboot_State = State_RangeCRC;
+    break;
+  case Flashboot_UpdateFill:
+    this->Flashboot_State = State_UpdateFill;
+    break;
+  case Flashboot_ReadMemory:
+    this->Flashboot_State = State_ReadMemory;
+    break;
+  case Flashboot_ReadAck:
+    this->Flashboot_State = State_ReadAck;
+    break;
+  case Flashboot_UpdateResume:
+    this->Flashboot_State = State_UpdateResume;
+    break;
+  case Flashboot_UpdateManifest:
+    this->Flashboot_State = State_UpdateManifest;
+    break;
+  case Flashboot_GenerationList:
+    this->Flashboot_State = State_GenerationList;
+    break;
+  case Flashboot_GenerationRestore:
+    this->Flashboot_State = State_GenerationRestore;
+    break;
+  case Flashboot_GetStats:
+    this->Flashboot_State = State_GetStats;
+    break;
+  case Flashboot_Batch:
+    /*A batch can't be nested*/
+    res = this->batch ? Flashboot_eProtocolError : Flashboot_eOK;
+    this->Flashboot_State = this->batch ? this->Flashboot_State : State_Batch;
+    break;
+  default:
+    res = Flashboot_eProtocolError;
+    break;
+  }
+
+  return res;
+}
+
+uint32_t Flashboot_SendReply(Flashboot_Context *this, Flashboot_Frame *frame,
+                             uint32_t size) {
+  /*Inside a batch the results are aggregated in a single reply*/
+  if (this->batch) {
+    return size;
+  }
+  return this->interface->SendData(this->arg, (uint8_t *)frame, size);
+}
+
 Flashboot_eResult Flashboot_SetTimeout(Flashboot_Context *this,
                                        uint32_t timeout) {
   this->timeout = this->interface->GetTick(this->arg) + timeout;
@@ -140,16 +596,44 @@ Flashboot_eResult Flashboot_CheckTimeout(Flashboot_Context *this) {
   return Flashboot_eOK;
 }
 
+Flashboot_eResult Flashboot_ReadMBR(Flashboot_Context *this, uint64_t address,
+                                    Flashboot_MBR *mbr) {
+  union {
+    Flashboot_MBRv1 v1;
+    Flashboot_MBR v2;
+  } stored;
+
+  Flashboot_ReadMem(this, address, (uint8_t *)&stored, sizeof(stored));
+  if (stored.v2.magicKey == MBR_MAGIC_KEY_V2 ||
+      stored.v2.magicKey == MBR_MAGIC_KEY_COMPONENT) {
+    *mbr = stored.v2;
+    return Flashboot_eOK;
+  }
+  Flashboot_ASSERT(stored.v1.magicKey != MBR_MAGIC_KEY,
+                   Flashboot_eGeneralError);
+
+  /*The first layout is widened, its magic key tells where it came from*/
+  *mbr = (Flashboot_MBR){
+      .magicKey = stored.v1.magicKey,
+      .version = stored.v1.version,
+      .loadAddress = stored.v1.loadAddress,
+      .bootAddress = stored.v1.bootAddress,
+      .size = stored.v1.size,
+      .mbrAddress = stored.v1.mbrAddress,
+      .crc = stored.v1.crc,
+  };
+  return Flashboot_eOK;
+}
+
 Flashboot_eResult Flashboot_SearchForMBR(Flashboot_Context *this,
                                          Flashboot_Memory *mem,
                                          Flashboot_MBR *mbr) {
   /*Look for a valid application MBR*/
   uint64_t address = mem->startAddress;
   while (address < (mem->startAddress + mem->size - MBR_ALINGMENT)) {
-    this->interface->ReadMem(this->arg, address, (uint8_t *)mbr,
-                             sizeof(Flashboot_MBR));
-
-    if (mbr->magicKey == MBR_MAGIC_KEY && // Is MBR found?
+    this->stats.mbrProbes++;
+    if (Flashboot_ReadMBR(this, address, mbr) == Flashboot_eOK && // Is found?
+        mbr->magicKey != MBR_MAGIC_KEY_COMPONENT && // Is bootable?
         address == mbr->mbrAddress &&
         ((mbr->mbrAddress < mbr->loadAddress) ||
          (mbr->mbrAddress >= (mbr->loadAddress + mbr->size))) &&
@@ -164,142 +648,1887 @@ Flashboot_eResult Flashboot_SearchForMBR(Flashboot_Context *this,
   return Flashboot_eGeneralError;
 }
 
-Flashboot_eResult Flashboot_CopyToMemory(Flashboot_Context *this,
-                                         Flashboot_Memory *target,
-                                         Flashboot_MBR *mbr) {
-  uint64_t address = this->mbr.loadAddress, size = 0;
+Flashboot_eResult Flashboot_MemoryProgram(Flashboot_Context *this,
+                                          uint64_t address,
+                                          const uint8_t *data, uint32_t size) {
+  const Flashboot_Memory *memory = TargetMemory(this, address, size);
+  Flashboot_eResult result = Flashboot_eOK;
 
-  Flashboot_FlashStart(this, target, mbr->bootAddress, mbr->size);
+  Flashboot_ASSERT(memory == NULL, Flashboot_eAddressOutOfBoundsError);
 
-  /*Copy to program memory*/
-  while (this->result == Flashboot_eOK &&
-         address < (this->mbr.loadAddress + this->mbr.size)) {
-    size = this->interface->ReadMem(this->arg, address,
-                                    (uint8_t *)this->workBuffer, this->wbs);
-    Flashboot_FlashWrite(this, this->workBuffer, size);
-    address += size;
+  /*Erase-free memories are just overwritten*/
+  if (!(memory->flags & FLASHBOOT_MEMORY_ERASE_FREE) &&
+      (!(memory->flags & FLASHBOOT_MEMORY_BIT_CLEAR) ||
+       !CanProgram(this, address, data, size))) {
+    result = Flashboot_MemoryErase(this, address, size);
   }
-
-  if (this->result == Flashboot_eOK) {
-    Flashboot_FlashFinish(this, this->mbr.crc, this->mbr.version);
+  if (result == Flashboot_eOK) {
+    result = Flashboot_MemoryWrite(this, address, (uint8_t *)data, size);
   }
-
-  return this->result;
+  return result;
 }
 
-Flashboot_eResult Flashboot_FlashStart(Flashboot_Context *this,
-                                       Flashboot_Memory *target,
-                                       const uint64_t bootAddress,
-                                       uint32_t size) {
-  this->result = Flashboot_eAddressOutOfBoundsError;
+Flashboot_eResult Flashboot_InvalidateMBR(Flashboot_Context *this,
+                                          uint64_t address) {
+  const Flashboot_Memory *memory =
+      TargetMemory(this, address, sizeof(Flashboot_MBR));
+  uint8_t magicKey[FLASHBOOT_MAX_PAGE_SIZE];
+  uint32_t size = sizeof(((Flashboot_MBR *)0)->magicKey);
+  uint32_t pageSize;
 
-  /*Check if address if aligned*/
-  Flashboot_ASSERT((bootAddress % this->progMem->pageSize) ||
-                       (size % this->progMem->pageSize),
-                   Flashboot_eAlignmentError);
+  Flashboot_ASSERT(memory == NULL, Flashboot_eAddressOutOfBoundsError);
+  pageSize = memory->pageSize;
+  if (!(memory->flags &
+        (FLASHBOOT_MEMORY_BIT_CLEAR | FLASHBOOT_MEMORY_ERASE_FREE))) {
+    return Flashboot_MemoryErase(this, address, sizeof(Flashboot_MBR));
+  }
 
-  /*Check if address and size are valid and erase the memory if positive*/
-  if ((bootAddress >= this->progMem->startAddress) &&
-      (size <= this->progMem->size)) {
-    this->update.memory = target;
-    this->update.size = size;
-    this->update.bootAddress = bootAddress;
-    this->update.startAddress = target->startAddress;
+  /*Clear the magic key in place, the rest of the page is kept*/
+  size = size % pageSize ? size + pageSize - (size % pageSize) : size;
+  Flashboot_ASSERT(size > sizeof(magicKey), Flashboot_eBufferOverflowError);
+  Flashboot_ReadMem(this, address, magicKey, size);
+  memset(magicKey, 0x00, sizeof(((Flashboot_MBR *)0)->magicKey));
+  return Flashboot_MemoryProgram(this, address, magicKey, size);
+}
 
-    if (this->progMem->startAddress == target->startAddress) {
-      this->update.startAddress = bootAddress;
-    }
+/*!
+ * Invalidate all the MBRs of a memory
+ * @param this        Struct initialized by ::Flashboot_Initialize function.
+ * @param mem        Memory to be searched
+ * @return
+ */
+static Flashboot_eResult InvalidateMBRs(Flashboot_Context *this,
+                                       Flashboot_Memory *mem) {
+  Flashboot_eResult result = Flashboot_eOK;
+  uint64_t address = mem->startAddress;
+  uint32_t magicKey;
 
-    this->update.currentAddress = this->update.startAddress;
+  while (result == Flashboot_eOK &&
+         address < (mem->startAddress + mem->size - MBR_ALINGMENT)) {
+    Flashboot_ReadMem(this, address, (uint8_t *)&magicKey, sizeof(magicKey));
+    if (MBR_IS_MAGIC_KEY(magicKey)) {
+      result = Flashboot_InvalidateMBR(this, address);
+    }
+    address += MBR_ALINGMENT;
+  }
+  return result;
+}
 
-    /*Disable flash projection*/
-    this->interface->ProtectMem(this->arg, false);
+/*!
+ * Erase the sectors of a ::FLASHBOOT_MEMORY_BIT_CLEAR memory as the update
+ * reaches them, unless they're blank already. Memories erased by
+ * ::Flashboot_FlashStart are ready up to their end. A differential update
+ * erases the blocks it reaches instead, the rest of their sectors is kept.
+ * @param this        Struct initialized by ::Flashboot_Initialize function.
+ * @param end        End of the range to be programmed
+ * @return ::Flashboot_eGeneralError if a sector wasn't erased
+ */
+static Flashboot_eResult PrepareSectors(Flashboot_Context *this,
+                                        uint64_t end) {
+  const Flashboot_Memory *memory = this->update.memory;
+  uint32_t keepBlock = this->update.keepBlock;
 
-    /*Erase the whole application flash area*/
-    this->result = Flashboot_MemoryErase(
-        this, this->update.memory->startAddress, this->update.memory->size);
+  if (keepBlock && this->update.erasedAddress < end) {
+    uint64_t block = this->update.startAddress +
+                     (end - this->update.startAddress + keepBlock - 1) /
+                         keepBlock * keepBlock;
+    uint64_t address = this->update.erasedAddress;
+    Flashboot_eResult result = Flashboot_eOK;
 
-    if (this->result != Flashboot_eOK) {
-      this->interface->ProtectMem(this->arg, true);
-      this->update.size = this->update.startAddress =
-          this->update.currentAddress = 0;
+    block = block < memory->startAddress + memory->size
+                ? block
+                : memory->startAddress + memory->size;
+    if (CanProgram(this, address, NULL, block - address)) {
+      this->stats.erasesSkipped++;
+    } else {
+      result = Flashboot_MemoryErase(this, address, block - address);
     }
+    this->update.erasedAddress = block;
+    return result;
   }
 
-  return this->result;
-}
-
-Flashboot_eResult Flashboot_FlashWrite(Flashboot_Context *this,
-                                       const uint8_t *data,
-                                       uint32_t size) { // TODO: init result
-  if (this->update.currentAddress >= this->update.memory->startAddress &&
-      this->update.currentAddress + size <
-          this->update.memory->startAddress + this->update.memory->size) {
-    /*Write packet in the memory*/
-    this->result = Flashboot_MemoryWrite(this, this->update.currentAddress,
-                                         (uint8_t *)data, size);
+  while (this->update.erasedAddress < end) {
+    uint64_t sector;
+    uint32_t sectorSize =
+        Flashboot_GetSector(memory, this->update.erasedAddress, &sector);
 
-    /*If ok, calculate the next address*/
-    if (this->result == Flashboot_eOK) {
-      this->update.currentAddress += size;
+    if (sectorSize == 0) {
+      break;
+    }
+    if (CanProgram(this, this->update.erasedAddress, NULL,
+                   sector + sectorSize - this->update.erasedAddress)) {
+      this->stats.erasesSkipped++;
+    } else {
+      Flashboot_ASSERT(EraseSector(this, memory, sector) != Flashboot_eOK,
+                       Flashboot_eGeneralError);
     }
+    this->update.erasedAddress = sector + sectorSize;
   }
-
-  return this->result;
+  return Flashboot_eOK;
 }
 
-Flashboot_eResult Flashboot_FlashFinish(Flashboot_Context *this,
-                                        const uint32_t crc, uint32_t version) {
-  /*Calculate the CRC of the received binary*/
-  uint32_t _crc =
-      Flashboot_CalcCRC(this, this->update.startAddress, this->update.size);
+/*!
+ * Write a slice of the update, preparing the sectors it reaches
+ * @param this        Struct initialized by ::Flashboot_Initialize function.
+ * @param address    Start address to write
+ * @param data       Data to be written
+ * @param size       Data size
+ * @return
+ */
+static Flashboot_eResult UpdateWrite(Flashboot_Context *this,
+                                     uint64_t address, const uint8_t *data,
+                                     uint32_t size) {
+  Flashboot_eResult result = PrepareSectors(this, address + size);
 
-  /*If CRC mismatch erase the memory and return error to the host */
-  if (_crc != crc) {
-    this->result = Flashboot_eCRCError;
-    Flashboot_MemoryErase(this, this->update.startAddress, this->update.size);
-  } else {
-    /*Generate MBR*/
-    Flashboot_MBR mbr = {
-        .magicKey = MBR_MAGIC_KEY,
-        .version = version,
-        .loadAddress = this->update.startAddress,
-        .bootAddress = this->update.bootAddress,
-        .size = this->update.size,
-        .crc = crc,
-    };
+  Flashboot_ASSERT(result != Flashboot_eOK, result);
+  return Flashboot_MemoryWrite(this, address, (uint8_t *)data, size);
+}
 
-    uint64_t endAddress = this->update.startAddress + this->update.size;
-    mbr.mbrAddress =
-        ((endAddress % MBR_ALINGMENT) == 0)
-            ? endAddress
-            : endAddress + MBR_ALINGMENT - (endAddress % MBR_ALINGMENT);
-    this->result = Flashboot_MemoryWrite(this, mbr.mbrAddress, (uint8_t *)&mbr,
-                                         sizeof(mbr));
-  }
+Flashboot_Memory *Flashboot_GetMemory(Flashboot_Context *this,
+                                      uint64_t address, uint64_t size) {
+  Flashboot_Memory *memories[] = {this->progMem,         this->dataMem,
+                                  this->backupMem,       this->scratchMem,
+                                  this->slots.memory[1], this->slots.record,
+                                  this->journal.memory};
+  uint8_t count = sizeof(memories) / sizeof(memories[0]);
 
-  /*Enable memory protection*/
-  this->interface->ProtectMem(this->arg, true);
-  this->update.size = this->update.startAddress = this->update.currentAddress =
-      0;
+  /*The accesses mostly follow each other in the same memory*/
+  if (this->memoryHint < count &&
+      InMemory(memories[this->memoryHint], address, size)) {
+    return memories[this->memoryHint];
+  }
 
-  return this->result;
+  for (uint8_t i = 0; i < count; i++) {
+    if (InMemory(memories[i], address, size)) {
+      this->memoryHint = i;
+      return memories[i];
+    }
+  }
+  return NULL;
 }
 
-uint32_t Flashboot_CalcCRC(Flashboot_Context *this, uint64_t address,
-                           uint32_t size) {
-  uint32_t crc = 0;
+/*!
+ * Continue a CRC over a memory range of any size, in chunks that fit
+ * Flashboot_Interface::CalcCRC.
+ * @param this       Struct initialized by ::Flashboot_Initialize function.
+ * @param crc        CRC of the data before the range
+ * @param address    Range start address
+ * @param size       Range size
+ * @return           The CRC of the data before and of the range.
+ */
+static uint32_t ContinueCRC(Flashboot_Context *this, uint32_t crc,
+                            uint64_t address, uint64_t size) {
+  const Flashboot_Memory *memory = Flashboot_GetMemory(this, address, size);
+  bool mapped = memory && memory->driver &&
+                (memory->driver->capabilities & FLASHBOOT_DRIVER_MAPPED_READ);
 
   do {
-    uint32_t min = size > this->update.memory->sectorSize
-                       ? this->update.memory->sectorSize
-                       : size;
+    uint32_t min;
 
-    this->interface->ReadMem(this->arg, address, this->workBuffer, min);
-    crc = this->interface->CalcCRC(this->arg, crc, this->workBuffer, min);
+    if (mapped) {
+      /*A mapped memory is calculated in place*/
+      min = size > CRC_MAPPED_CHUNK ? CRC_MAPPED_CHUNK : size;
+      this->stats.bytesRead += min;
+      crc = Flashboot_DataCRC(this, crc, (void *)(uintptr_t)address, min);
+    } else {
+      min = size > this->update.memory->sectorSize
+                ? this->update.memory->sectorSize
+                : size;
+      min = min > this->wbs ? this->wbs : min;
+
+      Flashboot_ReadMem(this, address, this->workBuffer, min);
+      crc = Flashboot_DataCRC(this, crc, this->workBuffer, min);
+    }
     size -= min;
     address += min;
   } while (size);
 
   return crc;
 }
+
+/*!
+ * Space taken by a record appended to a memory, a whole number of pages
+ * @param memory     Memory of the records
+ * @param size       Record size
+ * @return           The record size rounded up to the page size.
+ */
+static uint32_t RecordSize(const Flashboot_Memory *memory, uint32_t size) {
+  return size + (memory->pageSize - size % memory->pageSize) %
+                    memory->pageSize;
+}
+
+/*!
+ * Read the current record of a memory where the records are appended. A
+ * record starts with its magic key and sequence and ends with the CRC of the
+ * fields before it, the valid one with the biggest sequence is the current.
+ * @param this        Struct initialized by ::Flashboot_Initialize function.
+ * @param memory     Memory of the records
+ * @param magicKey   Magic key of the records
+ * @param record     Receives the current record
+ * @param size       Record size
+ * @param next       Receives the address of the next record to be written
+ * @return           The sequence of the current record, 0 if there's none.
+ */
+static uint32_t ReadRecord(Flashboot_Context *this,
+                           const Flashboot_Memory *memory, uint32_t magicKey,
+                           void *record, uint32_t size, uint64_t *next) {
+  uint32_t stride = RecordSize(memory, size);
+  uint64_t address = memory->startAddress;
+  uint32_t entry[FLASHBOOT_MAX_PAGE_SIZE / sizeof(uint32_t)];
+  uint32_t sequence = 0;
+
+  *next = memory->startAddress;
+  while (address + stride <= memory->startAddress + memory->size) {
+    Flashboot_ReadMem(this, address, (uint8_t *)entry, size);
+    if (entry[0] == magicKey && entry[1] > sequence &&
+        entry[size / sizeof(uint32_t) - 1] ==
+            Flashboot_DataCRC(this, 0, entry, size - sizeof(uint32_t))) {
+      sequence = entry[1];
+      memcpy(record, entry, size);
+      *next = address + stride;
+    }
+    address += stride;
+  }
+  return sequence;
+}
+
+/*!
+ * Start of the second half of a memory where the records are appended, on a
+ * sector boundary. The halves are erased in turns, so the current record is
+ * kept until the next one is written in the other half.
+ * @param memory     Memory of the records
+ * @return           The start of the second half, the end of the memory if it
+ *                   has a single sector.
+ */
+static uint64_t RecordHalf(const Flashboot_Memory *memory) {
+  uint64_t sector;
+
+  Flashboot_GetSector(memory, memory->startAddress + memory->size / 2,
+                      &sector);
+  return sector > memory->startAddress ? sector
+                                       : memory->startAddress + memory->size;
+}
+
+/*!
+ * Append a record to its memory, a half of the memory is erased only when the
+ * other one is full. The CRC of the record is calculated here.
+ * @param this        Struct initialized by ::Flashboot_Initialize function.
+ * @param memory     Memory of the records
+ * @param next       Address of the next record, updated after the write
+ * @param record     Record to be written, see ::ReadRecord
+ * @param size       Record size
+ * @return
+ */
+static Flashboot_eResult AppendRecord(Flashboot_Context *this,
+                                      Flashboot_Memory *memory,
+                                      uint64_t *next, const void *record,
+                                      uint32_t size) {
+  uint32_t stride = RecordSize(memory, size);
+  uint64_t address = *next;
+  uint64_t half = RecordHalf(memory);
+  uint64_t start = memory->startAddress;
+  uint64_t end = memory->startAddress + memory->size;
+  uint32_t entry[FLASHBOOT_MAX_PAGE_SIZE / sizeof(uint32_t)];
+  Flashboot_eResult result = Flashboot_eOK;
+
+  Flashboot_ASSERT(stride > sizeof(entry), Flashboot_eBufferOverflowError);
+  memset(entry, 0xFF, stride);
+  memcpy(entry, record, size);
+  entry[size / sizeof(uint32_t) - 1] =
+      Flashboot_DataCRC(this, 0, entry, size - sizeof(uint32_t));
+
+  /*Half where the current record is, the next address is the end of the
+   * first half when it's full*/
+  if (address <= half) {
+    end = half;
+  } else {
+    start = half;
+  }
+  if (address + stride > end ||
+      (!(memory->flags & FLASHBOOT_MEMORY_ERASE_FREE) &&
+       !CanProgram(this, address, NULL, stride))) {
+    /*The record is written at the beginning of the other half, a memory of a
+     * single sector is erased as a whole*/
+    if (half < memory->startAddress + memory->size) {
+      end = start == half ? half : memory->startAddress + memory->size;
+      start = start == half ? memory->startAddress : half;
+    }
+    address = start;
+    result = Flashboot_MemoryErase(this, start, end - start);
+  }
+  if (result == Flashboot_eOK) {
+    result = Flashboot_MemoryWrite(this, address, (uint8_t *)entry, stride);
+  }
+  if (result == Flashboot_eOK) {
+    *next = address + stride;
+  }
+  return result;
+}
+
+Flashboot_eResult Flashboot_ReadSlotRecord(Flashboot_Context *this) {
+  Flashboot_SlotRecord record;
+
+  this->slots.active = 0;
+  this->slots.sequence =
+      ReadRecord(this, this->slots.record, SLOT_RECORD_MAGIC_KEY, &record,
+                 sizeof(record), &this->slots.next);
+  if (this->slots.sequence) {
+    this->slots.active = record.active & 1;
+  }
+  return this->slots.sequence ? Flashboot_eOK : Flashboot_eGeneralError;
+}
+
+Flashboot_eResult Flashboot_SwitchSlot(Flashboot_Context *this, uint8_t slot) {
+  Flashboot_SlotRecord record = {
+      .magicKey = SLOT_RECORD_MAGIC_KEY,
+      .sequence = this->slots.sequence + 1,
+      .active = slot,
+  };
+  Flashboot_eResult result;
+
+  Flashboot_ProtectMem(this, this->slots.record, false);
+  result = AppendRecord(this, this->slots.record, &this->slots.next, &record,
+                        sizeof(record));
+  Flashboot_ProtectMem(this, this->slots.record, true);
+
+  if (result == Flashboot_eOK) {
+    this->slots.sequence = record.sequence;
+    this->slots.active = slot;
+  }
+  return result;
+}
+
+Flashboot_eResult Flashboot_ReadJournal(Flashboot_Context *this) {
+  if (ReadRecord(this, this->journal.memory, JOURNAL_MAGIC_KEY,
+                 &this->journal.entry, sizeof(this->journal.entry),
+                 &this->journal.next) == 0) {
+    memset(&this->journal.entry, 0, sizeof(this->journal.entry));
+  }
+  return this->journal.entry.size ? Flashboot_eOK : Flashboot_eGeneralError;
+}
+
+/*!
+ * Append the current entry to the journal, if there's one
+ * @param this        Struct initialized by ::Flashboot_Initialize function.
+ * @return
+ */
+static Flashboot_eResult WriteJournal(Flashboot_Context *this) {
+  if (this->journal.memory == NULL) {
+    return Flashboot_eOK;
+  }
+  this->journal.entry.magicKey = JOURNAL_MAGIC_KEY;
+  this->journal.entry.sequence++;
+  return AppendRecord(this, this->journal.memory, &this->journal.next,
+                      &this->journal.entry, sizeof(this->journal.entry));
+}
+
+/*!
+ * Record in the journal how far the update was written once it advanced a
+ * ::FLASHBOOT_JOURNAL_INTERVAL. The range written since the previous
+ * checkpoint is read back to continue the running CRC, so the host can check
+ * the region kept when the update is resumed.
+ * @param this        Struct initialized by ::Flashboot_Initialize function.
+ * @return
+ */
+static Flashboot_eResult Checkpoint(Flashboot_Context *this) {
+  Flashboot_JournalEntry *entry = &this->journal.entry;
+  uint64_t committed = this->update.currentAddress - this->update.pageFill -
+                       this->update.startAddress;
+
+  /*Multi-image and differential updates are started again instead of
+   * resumed*/
+  if (this->journal.memory == NULL || this->manifest.count ||
+      this->update.keepBlock ||
+      committed < entry->committed + FLASHBOOT_JOURNAL_INTERVAL) {
+    return Flashboot_eOK;
+  }
+
+  entry->committedCRC =
+      ContinueCRC(this, entry->committedCRC,
+                  this->update.startAddress + entry->committed,
+                  committed - entry->committed);
+  entry->committed = committed;
+  return WriteJournal(this);
+}
+
+Flashboot_eResult Flashboot_SelectSlot(Flashboot_Context *this) {
+  Flashboot_MBR mbr[2];
+  bool found[2];
+  uint8_t preferred = this->slots.active;
+
+  for (uint8_t i = 0; i < 2; i++) {
+    found[i] = Flashboot_SearchForMBR(this, this->slots.memory[i], &mbr[i]) ==
+               Flashboot_eOK;
+  }
+
+  /*Without a record the newest image is preferred*/
+  if (this->slots.sequence == 0) {
+    preferred = found[1] && (!found[0] || mbr[1].version > mbr[0].version);
+  }
+
+  /*A corrupted image rolls back to the other slot, each slot is checked as
+   * the verification policy selects*/
+  for (uint8_t i = 0; i < 2; i++) {
+    uint8_t slot = preferred ^ i;
+
+    if (found[slot] &&
+        Flashboot_VerifyImage(this, &mbr[slot]) == Flashboot_eOK) {
+      this->mbr = mbr[slot];
+      this->slots.active = slot;
+      return Flashboot_eOK;
+    }
+  }
+  return Flashboot_eGeneralError;
+}
+
+Flashboot_Memory *Flashboot_UpdateTarget(Flashboot_Context *this,
+                                         Flashboot_Memory *memory) {
+  if (this->slots.record) {
+    return this->slots.memory[this->slots.active ^ 1];
+  }
+  return memory;
+}
+
+/*!
+ * Address an update is written at in a target memory, the program memory and
+ * the other slot keep the offset of the boot address.
+ * @param this        Struct initialized by ::Flashboot_Initialize function.
+ * @param target      Memory that receives the update
+ * @param bootAddress Boot address of the update
+ * @return            The start address of the update.
+ */
+static uint64_t UpdateStartAddress(Flashboot_Context *this,
+                                   const Flashboot_Memory *target,
+                                   uint64_t bootAddress) {
+  if (this->progMem->startAddress == target->startAddress) {
+    return bootAddress;
+  } else if (this->slots.record && target == this->slots.memory[1]) {
+    /*The image keeps its offset in the other slot*/
+    return target->startAddress + bootAddress - this->progMem->startAddress;
+  }
+  return target->startAddress;
+}
+
+Flashboot_eResult Flashboot_CopyToMemory(Flashboot_Context *this,
+                                         Flashboot_Memory *target,
+                                         Flashboot_MBR *mbr) {
+  uint64_t address = this->mbr.loadAddress, size = 0;
+
+  /*A copy interrupted by a reset continues from its last checkpoint, the
+   * sectors copied already are neither erased nor written again*/
+  if (Flashboot_FlashResume(this, target, mbr->bootAddress, mbr->size,
+                            mbr->version, mbr->crc) == Flashboot_eOK) {
+    address += this->update.currentAddress - this->update.startAddress;
+  } else {
+    Flashboot_FlashStart(this, target, mbr->bootAddress, mbr->size,
+                         mbr->version, mbr->crc, 0);
+  }
+  this->update.origin = mbr;
+
+  /*Copy to program memory*/
+  while (this->result == Flashboot_eOK &&
+         address < (this->mbr.loadAddress + this->mbr.size)) {
+    size = this->mbr.loadAddress + this->mbr.size - address;
+    size = size < this->wbs ? size : this->wbs;
+
+    /*The sectors are prepared before the work buffer holds the data, their
+     * check reads through it*/
+    this->result = PrepareSectors(this, this->update.currentAddress + size);
+    if (this->result != Flashboot_eOK) {
+      break;
+    }
+    size = Flashboot_ReadMem(this, address, (uint8_t *)this->workBuffer,
+                             (uint32_t)size);
+    Flashboot_FlashWrite(this, this->workBuffer, size);
+    address += size;
+  }
+
+  if (this->result == Flashboot_eOK) {
+    Flashboot_FlashFinish(this, this->mbr.crc, this->mbr.version);
+  }
+
+  return this->result;
+}
+
+/*!
+ * Prepare the memory of an update being started, erasing it or invalidating
+ * the previous binaries as its flags require. The memory of a differential
+ * update is kept, its blocks are erased when the update reaches them.
+ * @param this        Struct initialized by ::Flashboot_Initialize function.
+ * @param target     Memory of the update
+ * @return
+ */
+static Flashboot_eResult PrepareTarget(Flashboot_Context *this,
+                                       Flashboot_Memory *target) {
+  Flashboot_eResult result;
+
+  if (target->flags & FLASHBOOT_MEMORY_ERASE_FREE) {
+    /*Nothing to erase, only the previous binaries are invalidated*/
+    this->update.erasedAddress = target->startAddress + target->size;
+    result = InvalidateMBRs(this, target);
+  } else if (this->update.keepBlock) {
+    this->update.erasedAddress = this->update.startAddress;
+    result = InvalidateMBRs(this, target);
+  } else if (target->flags & FLASHBOOT_MEMORY_BIT_CLEAR) {
+    /*The sectors are erased when the update reaches them, only the
+     * previous binaries are invalidated now and the beginning of the first
+     * sector is kept*/
+    uint64_t sector;
+    this->update.erasedAddress =
+        Flashboot_GetSector(target, this->update.startAddress, &sector) +
+        sector;
+    result = InvalidateMBRs(this, target);
+
+    if (result == Flashboot_eOK &&
+        !CanProgram(this, this->update.startAddress, NULL,
+                    this->update.erasedAddress - this->update.startAddress)) {
+      result = Flashboot_MemoryErase(
+          this, this->update.startAddress,
+          this->update.erasedAddress - this->update.startAddress);
+    }
+  } else {
+    /*Erase the whole application flash area*/
+    this->update.erasedAddress = target->startAddress + target->size;
+    result = Flashboot_MemoryErase(this, this->update.memory->startAddress,
+                                   this->update.memory->size);
+  }
+  return result;
+}
+
+Flashboot_eResult Flashboot_FlashStart(Flashboot_Context *this,
+                                       Flashboot_Memory *target,
+                                       const uint64_t bootAddress,
+                                       uint64_t size, uint32_t version,
+                                       uint32_t crc, uint32_t keepBlock) {
+  this->result = Flashboot_eAddressOutOfBoundsError;
+
+  /*Check if address if aligned*/
+  Flashboot_ASSERT((bootAddress % this->progMem->pageSize),
+                   Flashboot_eAlignmentError);
+
+  /*The blocks of a differential update are written in whole pages*/
+  Flashboot_ASSERT((keepBlock % target->pageSize), Flashboot_eAlignmentError);
+
+  /*Check if a page fits in the assembly buffer*/
+  Flashboot_ASSERT(target->pageSize > FLASHBOOT_MAX_PAGE_SIZE,
+                   Flashboot_eBufferOverflowError);
+
+  /*Check if address and size are valid and erase the memory if positive,
+   * the image runs from the program memory and shall fit in the memory it's
+   * written to, as the other slot*/
+  uint64_t start = UpdateStartAddress(this, target, bootAddress);
+  if (InMemory(this->progMem, bootAddress, size) &&
+      InMemory(target, start, size)) {
+    this->update.memory = target;
+    this->update.size = size;
+    this->update.bootAddress = bootAddress;
+    this->update.startAddress = start;
+    this->update.currentAddress = this->update.startAddress;
+    this->update.pageFill = 0;
+    this->update.keepBlock = keepBlock;
+    this->update.origin = NULL;
+    this->manifest.count = 0;
+
+    /*Disable flash projection*/
+    Flashboot_ProtectMem(this, target, false);
+
+    /*The session is recorded before the erase, an update interrupted before
+     * its first checkpoint is started again when resumed*/
+    this->journal.entry = (Flashboot_JournalEntry){
+        .sequence = this->journal.entry.sequence,
+        .startAddress = this->update.startAddress,
+        .bootAddress = bootAddress,
+        .size = size,
+        .version = version,
+        .imageCRC = crc,
+    };
+    this->result = Flashboot_eOK;
+    if (this->journal.memory) {
+      Flashboot_ProtectMem(this, this->journal.memory, false);
+      this->result = WriteJournal(this);
+    }
+
+    /*Without its record the update couldn't be resumed, it isn't started*/
+    if (this->result == Flashboot_eOK) {
+      this->result = PrepareTarget(this, target);
+    }
+
+    if (this->result != Flashboot_eOK) {
+      Flashboot_ProtectMem(this, target, true);
+      if (this->journal.memory) {
+        Flashboot_ProtectMem(this, this->journal.memory, true);
+      }
+      this->update.size = this->update.startAddress =
+          this->update.currentAddress = 0;
+    }
+  }
+
+  return this->result;
+}
+
+Flashboot_eResult Flashboot_FlashResume(Flashboot_Context *this,
+                                        Flashboot_Memory *target,
+                                        const uint64_t bootAddress,
+                                        uint64_t size, uint32_t version,
+                                        uint32_t crc) {
+  const Flashboot_JournalEntry *entry = &this->journal.entry;
+  uint64_t address, end;
+
+  this->result = Flashboot_eGeneralError;
+
+  /*Only the update recorded by the journal is resumed*/
+  Flashboot_ASSERT(this->journal.memory == NULL || entry->size == 0 ||
+                       entry->bootAddress != bootAddress ||
+                       entry->size != size || entry->version != version ||
+                       entry->imageCRC != crc ||
+                       entry->startAddress !=
+                           UpdateStartAddress(this, target, bootAddress),
+                   this->result);
+
+  /*Nothing was kept, the update is started again*/
+  if (entry->committed == 0) {
+    return Flashboot_FlashStart(this, target, bootAddress, size, version,
+                                crc, 0);
+  }
+
+  this->update.memory = target;
+  this->update.size = size;
+  this->update.bootAddress = bootAddress;
+  this->update.startAddress = entry->startAddress;
+  this->update.currentAddress = entry->startAddress + entry->committed;
+  this->update.pageFill = 0;
+  this->update.keepBlock = 0;
+  this->update.origin = NULL;
+
+  /*Disable flash projection*/
+  Flashboot_ProtectMem(this, target, false);
+  Flashboot_ProtectMem(this, this->journal.memory, false);
+
+  /*What was written after the checkpoint is erased again, the checkpoints
+   * are page aligned*/
+  address = this->update.currentAddress;
+  end = target->startAddress + target->size;
+  this->update.erasedAddress = end;
+  this->result = Flashboot_eOK;
+  if (target->flags & FLASHBOOT_MEMORY_BIT_CLEAR) {
+    uint64_t sector;
+    this->update.erasedAddress =
+        Flashboot_GetSector(target, address, &sector) + sector;
+    if (!CanProgram(this, address, NULL,
+                    this->update.erasedAddress - address)) {
+      this->result = Flashboot_MemoryErase(
+          this, address, this->update.erasedAddress - address);
+    }
+  } else if (!(target->flags & FLASHBOOT_MEMORY_ERASE_FREE)) {
+    this->result = Flashboot_MemoryErase(this, address, end - address);
+  }
+
+  if (this->result != Flashboot_eOK) {
+    Flashboot_ProtectMem(this, target, true);
+    Flashboot_ProtectMem(this, this->journal.memory, true);
+    this->update.size = this->update.startAddress =
+        this->update.currentAddress = 0;
+  }
+  return this->result;
+}
+
+/*!
+ * Write the page being assembled padded with the erased value.
+ * @param this        Struct initialized by ::Flashboot_Initialize function.
+ * @return
+ */
+static Flashboot_eResult FlushPage(Flashboot_Context *this) {
+  uint32_t pageSize = this->update.memory->pageSize;
+
+  if (this->update.pageFill == 0) {
+    return Flashboot_eOK;
+  }
+
+  memset(this->update.page + this->update.pageFill, 0xFF,
+         pageSize - this->update.pageFill);
+  this->update.pageFill = 0;
+
+  return UpdateWrite(
+      this,
+      this->update.currentAddress - (this->update.currentAddress % pageSize),
+      this->update.page, pageSize);
+}
+
+Flashboot_eResult Flashboot_FlashWrite(Flashboot_Context *this,
+                                       const uint8_t *data, uint32_t size) {
+  uint32_t pageSize = this->update.memory->pageSize;
+  uint32_t length = 0;
+
+  this->result = Flashboot_eAddressOutOfBoundsError;
+
+  if (this->update.currentAddress >= this->update.memory->startAddress &&
+      this->update.currentAddress + size <
+          this->update.memory->startAddress + this->update.memory->size) {
+    this->result = Flashboot_eOK;
+
+    /*Complete the page assembled from the previous slices*/
+    if (this->update.pageFill) {
+      length = pageSize - this->update.pageFill;
+      length = size < length ? size : length;
+      memcpy(this->update.page + this->update.pageFill, data, length);
+      this->update.pageFill += length;
+      this->update.currentAddress += length;
+      data += length;
+      size -= length;
+
+      if (this->update.pageFill == pageSize) {
+        this->update.pageFill = 0;
+        this->result = UpdateWrite(this, this->update.currentAddress - pageSize,
+                                   this->update.page, pageSize);
+      }
+    }
+
+    /*Write the whole pages in a single burst straight from the slice*/
+    length = size - (size % pageSize);
+    if (this->result == Flashboot_eOK && length) {
+      this->result =
+          UpdateWrite(this, this->update.currentAddress, data, length);
+      this->update.currentAddress += length;
+      data += length;
+      size -= length;
+    }
+
+    /*Keep the tail until the next slice completes the page*/
+    if (this->result == Flashboot_eOK && size) {
+      memcpy(this->update.page, data, size);
+      this->update.pageFill = size;
+      this->update.currentAddress += size;
+    }
+
+    if (this->result == Flashboot_eOK) {
+      this->result = Checkpoint(this);
+    }
+  }
+
+  return this->result;
+}
+
+/*!
+ * Rewrite a region of the update already written, with a retransmitted
+ * packet
+ * @param this        Struct initialized by ::Flashboot_Initialize function.
+ * @param address    Start address of the region
+ * @param data       Packet data
+ * @param size       Packet size
+ * @return
+ */
+static Flashboot_eResult Rewrite(Flashboot_Context *this, uint64_t address,
+                                 const uint8_t *data, uint32_t size) {
+  /*Nothing to do if the region in memory already matches the packet*/
+  if (Flashboot_CalcCRC(this, address, size) ==
+      Flashboot_DataCRC(this, 0, data, size)) {
+    return Flashboot_eOK;
+  }
+
+  /*The running CRC is calculated again by the next checkpoint*/
+  if (address < this->update.startAddress + this->journal.entry.committed) {
+    this->journal.entry.committed = this->journal.entry.committedCRC = 0;
+  }
+  return Flashboot_MemoryProgram(this, address, data, size);
+}
+
+/*!
+ * Continue a differential update after the blocks the host didn't send, their
+ * content is kept. The stream shall be at the end of a block.
+ * @param this        Struct initialized by ::Flashboot_Initialize function.
+ * @param address    Start address of the next block sent
+ * @return           True if the update continues from the address.
+ */
+static bool SkipBlocks(Flashboot_Context *this, uint64_t address) {
+  const Flashboot_Memory *memory = this->update.memory;
+  uint32_t keepBlock = this->update.keepBlock;
+
+  if (keepBlock == 0 || this->update.pageFill ||
+      address >= memory->startAddress + memory->size ||
+      (this->update.currentAddress - this->update.startAddress) % keepBlock ||
+      (address - this->update.startAddress) % keepBlock) {
+    return false;
+  }
+
+  this->update.currentAddress = address;
+  if (this->update.erasedAddress < address) {
+    this->update.erasedAddress = address;
+  }
+  return true;
+}
+
+Flashboot_eResult Flashboot_FlashWriteAt(Flashboot_Context *this,
+                                         uint64_t offset, const uint8_t *data,
+                                         uint32_t size) {
+  uint64_t address = this->update.startAddress + offset;
+
+  /*In order packet, just continue the stream*/
+  if (address == this->update.currentAddress) {
+    return Flashboot_FlashWrite(this, data, size);
+  }
+
+  /*A previous packet was lost, ask the host to resume from the current
+   * address, unless the blocks before the packet are kept*/
+  this->result = Flashboot_eRetransmitRequest;
+  if (address > this->update.currentAddress) {
+    return SkipBlocks(this, address) ? Flashboot_FlashWrite(this, data, size)
+                                     : this->result;
+  }
+
+  /*Retransmission of a region already written, only the region is rewritten*/
+  this->result = Flashboot_eAddressOutOfBoundsError;
+  if (address + size <=
+      this->update.currentAddress - this->update.pageFill) {
+    this->result = Rewrite(this, address, data, size);
+  }
+
+  return this->result;
+}
+
+Flashboot_eResult Flashboot_FlashFill(Flashboot_Context *this,
+                                      uint64_t offset, uint64_t size,
+                                      uint8_t value) {
+  uint32_t pageSize = this->update.memory->pageSize;
+  uint32_t chunk = this->wbs - (this->wbs % pageSize);
+  uint64_t length = 0;
+
+  /*Regions are filled in order as the packets of the update*/
+  this->result = Flashboot_eRetransmitRequest;
+  if (this->update.startAddress + offset != this->update.currentAddress &&
+      (this->update.startAddress + offset < this->update.currentAddress ||
+       !SkipBlocks(this, this->update.startAddress + offset))) {
+    return this->result;
+  }
+
+  this->result = Flashboot_eAddressOutOfBoundsError;
+  if (this->update.currentAddress + size >=
+      this->update.memory->startAddress + this->update.memory->size) {
+    return this->result;
+  }
+
+  this->result = Flashboot_eOK;
+
+  /*Complete the page assembled from the previous slices*/
+  if (this->update.pageFill) {
+    length = pageSize - this->update.pageFill;
+    length = size < length ? size : length;
+    memset(this->workBuffer, value, length);
+    this->result = Flashboot_FlashWrite(this, this->workBuffer, length);
+    size -= length;
+  }
+
+  /*The memory after the current address was erased by ::Flashboot_FlashStart,
+   * or is prepared as the update reaches it, so only a value other than the
+   * erased one has to be programmed. Erase-free memories are always written*/
+  bool write = value != 0xFF ||
+               (this->update.memory->flags & FLASHBOOT_MEMORY_ERASE_FREE);
+  length = size - (size % pageSize);
+  if (this->result == Flashboot_eOK && length) {
+    /*The sectors are prepared before the work buffer holds the value, their
+     * check reads through it*/
+    this->result = PrepareSectors(this, this->update.currentAddress + length);
+  }
+  if (this->result == Flashboot_eOK && length && write) {
+    memset(this->workBuffer, value, chunk);
+  }
+  while (this->result == Flashboot_eOK && length) {
+    uint32_t min = length > chunk ? chunk : length;
+    if (write) {
+      this->result = UpdateWrite(this, this->update.currentAddress,
+                                 this->workBuffer, min);
+    }
+    this->update.currentAddress += min;
+    length -= min;
+    size -= min;
+  }
+
+  /*Keep the tail until the next slice completes the page*/
+  if (this->result == Flashboot_eOK && size) {
+    memset(this->update.page, value, size);
+    this->update.pageFill = size;
+    this->update.currentAddress += size;
+  }
+
+  if (this->result == Flashboot_eOK) {
+    this->result = Checkpoint(this);
+  }
+
+  return this->result;
+}
+
+/*!
+ * Address of the MBR of an image, the first one aligned after it
+ * @param end        End address of the image
+ * @return           The MBR address.
+ */
+static uint64_t MBRAddress(uint64_t end) {
+  return ((end % MBR_ALINGMENT) == 0) ? end
+                                      : end + MBR_ALINGMENT -
+                                            (end % MBR_ALINGMENT);
+}
+
+/*!
+ * Write the MBR of the update, the first layout is kept while the image fits
+ * it.
+ * @param this        Struct initialized by ::Flashboot_Initialize function.
+ * @param mbr        MBR to be written at its address
+ * @param components Addresses of the component MBRs written after it, see
+ * Flashboot_MBR::components
+ * @return
+ */
+static Flashboot_eResult WriteMBR(Flashboot_Context *this,
+                                  const Flashboot_MBR *mbr,
+                                  const uint64_t *components) {
+  Flashboot_MBRv1 v1 = {
+      .magicKey = MBR_MAGIC_KEY,
+      .version = mbr->version,
+      .loadAddress = mbr->loadAddress,
+      .bootAddress = (uint32_t)mbr->bootAddress,
+      .size = (uint32_t)mbr->size,
+      .crc = mbr->crc,
+      .mbrAddress = mbr->mbrAddress,
+  };
+
+  uint8_t record[sizeof(*mbr) + sizeof(*components) * FLASHBOOT_MAX_IMAGES];
+
+  if (mbr->components) {
+    Flashboot_ASSERT(mbr->components >= FLASHBOOT_MAX_IMAGES,
+                     Flashboot_eBufferOverflowError);
+    memcpy(record, mbr, sizeof(*mbr));
+    memcpy(record + sizeof(*mbr), components,
+           sizeof(*components) * mbr->components);
+    return UpdateWrite(this, mbr->mbrAddress, record,
+                       sizeof(*mbr) + sizeof(*components) * mbr->components);
+  }
+  if (mbr->magicKey != MBR_MAGIC_KEY_V2 || mbr->bootAddress > UINT32_MAX ||
+      mbr->size > UINT32_MAX) {
+    return UpdateWrite(this, mbr->mbrAddress, (const uint8_t *)mbr,
+                       sizeof(*mbr));
+  }
+  return UpdateWrite(this, mbr->mbrAddress, (uint8_t *)&v1, sizeof(v1));
+}
+
+/*!
+ * Read the addresses of the component MBRs listed after the MBR of an image.
+ * @param this        Struct initialized by ::Flashboot_Initialize function.
+ * @param mbr        MBR of the image
+ * @param components Receives Flashboot_MBR::components addresses
+ * @return
+ */
+static Flashboot_eResult ReadComponents(Flashboot_Context *this,
+                                        const Flashboot_MBR *mbr,
+                                        uint64_t *components) {
+  Flashboot_ASSERT(mbr->components >= FLASHBOOT_MAX_IMAGES,
+                   Flashboot_eBufferOverflowError);
+
+  if (mbr->components) {
+    Flashboot_ReadMem(this, mbr->mbrAddress + sizeof(*mbr),
+                      (uint8_t *)components,
+                      sizeof(*components) * mbr->components);
+  }
+  return Flashboot_eOK;
+}
+
+/*!
+ * Address of the block CRC table of an image, the first one aligned after its
+ * MBR and the addresses of its components.
+ * @param mbr        MBR of the image
+ * @return           The table address.
+ */
+static uint64_t BlockTableAddress(const Flashboot_MBR *mbr) {
+  return MBRAddress(mbr->mbrAddress + sizeof(*mbr) +
+                    sizeof(uint64_t) * mbr->components);
+}
+
+/*!
+ * End of the block of an image that starts at an address
+ * @param address    Block start address
+ * @param end        End address of the image
+ * @param blockSize  Size of the blocks
+ * @return           The block end address.
+ */
+static uint64_t BlockEnd(uint64_t address, uint64_t end, uint32_t blockSize) {
+  uint64_t next = address - (address % blockSize) + blockSize;
+
+  return next < end ? next : end;
+}
+
+/*!
+ * Amount of blocks of an image
+ * @param mbr        MBR of the image
+ * @param blockSize  Size of the blocks
+ * @return           The amount of blocks.
+ */
+static uint32_t BlockCount(const Flashboot_MBR *mbr, uint32_t blockSize) {
+  uint64_t first = mbr->loadAddress - (mbr->loadAddress % blockSize);
+
+  return (uint32_t)((mbr->loadAddress + mbr->size - first + blockSize - 1) /
+                    blockSize);
+}
+
+/*!
+ * Read the block CRC table of an image and check it matches the image, its
+ * entries are checked against the CRC that follows them
+ * @param this        Struct initialized by ::Flashboot_Initialize function.
+ * @param mbr        MBR of the image
+ * @param table      Receives the table
+ * @return
+ */
+static Flashboot_eResult ReadBlockTable(Flashboot_Context *this,
+                                        const Flashboot_MBR *mbr,
+                                        Flashboot_BlockTable *table) {
+  uint64_t address = BlockTableAddress(mbr) + sizeof(*table);
+  uint32_t crc;
+
+  Flashboot_ReadMem(this, BlockTableAddress(mbr), (uint8_t *)table,
+                    sizeof(*table));
+  Flashboot_ASSERT(table->magicKey != BLOCK_TABLE_MAGIC_KEY ||
+                       table->crc != Flashboot_DataCRC(
+                                         this, 0, table,
+                                         offsetof(Flashboot_BlockTable, crc)),
+                   Flashboot_eGeneralError);
+  Flashboot_ASSERT(table->blockSize == 0 ||
+                       table->count != BlockCount(mbr, table->blockSize),
+                   Flashboot_eGeneralError);
+
+  Flashboot_ReadMem(this, address + sizeof(crc) * (uint64_t)table->count,
+                    (uint8_t *)&crc, sizeof(crc));
+  Flashboot_ASSERT(crc != ContinueCRC(this, table->crc, address,
+                                      sizeof(crc) * (uint64_t)table->count),
+                   Flashboot_eGeneralError);
+  return Flashboot_eOK;
+}
+
+/*!
+ * Address of the pages after the block CRC table of an image, a word
+ * programmed once the image is checked as a whole, see
+ * ::Flashboot_SetVerifyPolicy.
+ * @param memory     Memory of the image
+ * @param mbr        MBR of the image
+ * @param table      Block CRC table of the image
+ * @return           The page address.
+ */
+static uint64_t VerifiedAddress(const Flashboot_Memory *memory,
+                                const Flashboot_MBR *mbr,
+                                const Flashboot_BlockTable *table) {
+  uint64_t address = BlockTableAddress(mbr) + sizeof(*table) +
+                     sizeof(uint32_t) * ((uint64_t)table->count + 1);
+
+  return address +
+         (memory->pageSize - (address % memory->pageSize)) % memory->pageSize;
+}
+
+/*!
+ * Append data to the page assembled after the current address of the update,
+ * the page is written once full.
+ * @param this        Struct initialized by ::Flashboot_Initialize function.
+ * @param data       Data to be appended
+ * @param size       Data size
+ * @return
+ */
+static Flashboot_eResult AppendPage(Flashboot_Context *this, const void *data,
+                                    uint32_t size) {
+  uint32_t pageSize = this->update.memory->pageSize;
+  const uint8_t *bytes = data;
+  Flashboot_eResult result = Flashboot_eOK;
+
+  while (result == Flashboot_eOK && size) {
+    uint32_t length = pageSize - this->update.pageFill;
+
+    length = size < length ? size : length;
+    memcpy(this->update.page + this->update.pageFill, bytes, length);
+    this->update.pageFill += length;
+    this->update.currentAddress += length;
+    bytes += length;
+    size -= length;
+
+    if (this->update.pageFill == pageSize) {
+      this->update.pageFill = 0;
+      result = UpdateWrite(this, this->update.currentAddress - pageSize,
+                           this->update.page, pageSize);
+    }
+  }
+  return result;
+}
+
+/*!
+ * Write the block CRC table of the update, see ::Flashboot_SetBlockCRC. A
+ * table that doesn't fit the memory is left out, the image is then checked as
+ * a whole.
+ * @param this        Struct initialized by ::Flashboot_Initialize function.
+ * @param mbr        MBR of the update
+ * @return
+ */
+static Flashboot_eResult WriteBlockTable(Flashboot_Context *this,
+                                         const Flashboot_MBR *mbr) {
+  const Flashboot_Memory *memory = this->update.memory;
+  uint64_t address = mbr->loadAddress, end = address + mbr->size;
+  uint32_t markSize = RecordSize(memory, sizeof(uint32_t));
+  Flashboot_BlockTable table = {
+      .magicKey = BLOCK_TABLE_MAGIC_KEY,
+      .blockSize = this->blockSize,
+      .count = BlockCount(mbr, this->blockSize),
+  };
+  Flashboot_eResult result;
+
+  table.crc =
+      Flashboot_DataCRC(this, 0, &table, offsetof(Flashboot_BlockTable, crc));
+  this->update.currentAddress = BlockTableAddress(mbr);
+  this->update.pageFill = 0;
+  if (VerifiedAddress(memory, mbr, &table) + markSize >
+      memory->startAddress + memory->size) {
+    return Flashboot_eOK;
+  }
+
+  /*The entries are followed by their CRC, continuing the one of the table*/
+  uint32_t tableCRC = table.crc;
+
+  result = AppendPage(this, &table, sizeof(table));
+  while (result == Flashboot_eOK && address < end) {
+    uint64_t next = BlockEnd(address, end, table.blockSize);
+    uint32_t crc = Flashboot_CalcCRC(this, address, next - address);
+
+    tableCRC = Flashboot_DataCRC(this, tableCRC, &crc, sizeof(crc));
+    result = AppendPage(this, &crc, sizeof(crc));
+    address = next;
+  }
+  if (result == Flashboot_eOK) {
+    result = AppendPage(this, &tableCRC, sizeof(tableCRC));
+  }
+  if (result == Flashboot_eOK) {
+    result = FlushPage(this);
+  }
+
+  /*The pages that mark the image verified are left blank*/
+  if (result == Flashboot_eOK &&
+      (memory->flags & FLASHBOOT_MEMORY_ERASE_FREE)) {
+    memset(this->update.page, 0xFF, markSize);
+    result = UpdateWrite(this, this->update.currentAddress, this->update.page,
+                         markSize);
+  } else if (result == Flashboot_eOK) {
+    result = PrepareSectors(this, this->update.currentAddress + markSize);
+  }
+  return result;
+}
+
+Flashboot_eResult Flashboot_FlashFinish(Flashboot_Context *this,
+                                        const uint32_t crc, uint32_t version) {
+  Flashboot_eResult result;
+
+  /*Write the last slice that didn't fill a page*/
+  this->result = FlushPage(this);
+
+  /*Calculate the CRC of the received binary, continuing the running CRC of
+   * the journal*/
+  uint64_t committed = this->journal.entry.committed;
+  uint32_t _crc = this->journal.entry.committedCRC;
+
+  if (committed > this->update.size) {
+    committed = _crc = 0;
+  }
+  if (this->result == Flashboot_eOK) {
+    _crc = ContinueCRC(this, _crc, this->update.startAddress + committed,
+                       this->update.size - committed);
+    if (_crc != crc) {
+      this->result = Flashboot_eCRCError;
+    }
+  }
+
+  /*If the last page or the CRC failed erase the memory and return error to
+   * the host */
+  if (this->result != Flashboot_eOK) {
+    Flashboot_MemoryErase(this, this->update.startAddress, this->update.size);
+  } else {
+    /*Generate MBR*/
+    Flashboot_MBR mbr = {
+        .magicKey = MBR_MAGIC_KEY_V2,
+        .version = version,
+        .loadAddress = this->update.startAddress,
+        .bootAddress = this->update.bootAddress,
+        .size = this->update.size,
+        .crc = crc,
+    };
+
+    uint64_t components[FLASHBOOT_MAX_IMAGES];
+
+    mbr.mbrAddress = MBRAddress(this->update.startAddress + this->update.size);
+
+    /*A copied image keeps the components listed by its source*/
+    this->result = Flashboot_eOK;
+    if (this->update.origin) {
+      mbr.components = this->update.origin->components;
+      this->result = ReadComponents(this, this->update.origin, components);
+    }
+
+    /*The last blocks of a differential update may be kept, the trailer is
+     * prepared from the MBR*/
+    if (this->update.keepBlock && this->update.erasedAddress < mbr.mbrAddress) {
+      this->update.erasedAddress = mbr.mbrAddress;
+    }
+
+    /*The table is written before the MBR that commits the image*/
+    if (this->result == Flashboot_eOK && this->blockSize) {
+      this->result = WriteBlockTable(this, &mbr);
+    }
+    if (this->result == Flashboot_eOK) {
+      this->result = WriteMBR(this, &mbr, components);
+    }
+
+    /*In A/B mode the new image is booted from its slot*/
+    for (uint8_t i = 0; this->slots.record && i < 2; i++) {
+      if (this->result == Flashboot_eOK &&
+          this->update.memory == this->slots.memory[i]) {
+        this->result = Flashboot_SwitchSlot(this, i);
+      }
+    }
+  }
+
+  /*The session is over, successful or not*/
+  if (this->journal.memory) {
+    this->journal.entry = (Flashboot_JournalEntry){
+        .sequence = this->journal.entry.sequence};
+    result = WriteJournal(this);
+    this->result = this->result == Flashboot_eOK ? result : this->result;
+    Flashboot_ProtectMem(this, this->journal.memory, true);
+  }
+
+  /*Enable memory protection*/
+  Flashboot_ProtectMem(this, this->update.memory, true);
+  this->update.size = this->update.startAddress = this->update.currentAddress =
+      0;
+  this->update.keepBlock = 0;
+
+  return this->result;
+}
+
+Flashboot_eResult Flashboot_RefreshBackup(Flashboot_Context *this,
+                                          Flashboot_Memory *target,
+                                          const Flashboot_MBR *mbr) {
+  uint32_t pageSize = target->pageSize;
+  uint64_t start = UpdateStartAddress(this, target, mbr->bootAddress);
+  uint64_t address = start, end = start + mbr->size;
+  Flashboot_MBR backup = {
+      .magicKey = MBR_MAGIC_KEY_V2,
+      .version = mbr->version,
+      .loadAddress = start,
+      .bootAddress = mbr->bootAddress,
+      .size = mbr->size,
+      .crc = mbr->crc,
+      .mbrAddress = MBRAddress(end),
+      .components = mbr->components,
+  };
+  uint64_t components[FLASHBOOT_MAX_IMAGES];
+  uint32_t record = sizeof(backup) + sizeof(*components) * mbr->components;
+
+  /*The components listed by the image are listed by its backup*/
+  this->result = ReadComponents(this, mbr, components);
+  Flashboot_ASSERT(this->result != Flashboot_eOK, this->result);
+
+  /*Check if the image and its MBR fit the memory*/
+  Flashboot_ASSERT(start % pageSize ||
+                       backup.mbrAddress + record >
+                           target->startAddress + target->size,
+                   Flashboot_eAddressOutOfBoundsError);
+
+  /*The sectors are compared in whole pages*/
+  end += (pageSize - end % pageSize) % pageSize;
+  this->update.memory = target;
+  this->update.erasedAddress = target->startAddress + target->size;
+  this->update.keepBlock = 0;
+
+  /*Disable flash projection*/
+  Flashboot_ProtectMem(this, target, false);
+
+  /*The previous image isn't valid while it's refreshed, an interrupted
+   * refresh is compared again on the next boot*/
+  this->result = InvalidateMBRs(this, target);
+
+  /*Only the sectors that differ from the program memory are erased and
+   * copied*/
+  while (this->result == Flashboot_eOK && address < end) {
+    uint64_t sector, source = mbr->loadAddress + (address - start);
+    uint32_t length = Flashboot_GetSector(target, address, &sector);
+
+    length = sector + length > end ? end - address : sector + length - address;
+    if (Flashboot_CalcCRC(this, address, length) !=
+        Flashboot_CalcCRC(this, source, length)) {
+      this->result = EraseBeforeWrite(this, address, length);
+      if (this->result == Flashboot_eOK) {
+        this->result = CopyMemory(this, address, source, length);
+      }
+    }
+    address += length;
+  }
+
+  /*The MBR is written over a blank range*/
+  if (this->result == Flashboot_eOK &&
+      !CanProgram(this, backup.mbrAddress, NULL, record)) {
+    this->result = EraseBeforeWrite(this, backup.mbrAddress, record);
+  }
+
+  if (this->result == Flashboot_eOK &&
+      Flashboot_CalcCRC(this, start, mbr->size) != mbr->crc) {
+    this->result = Flashboot_eCRCError;
+  }
+  if (this->result == Flashboot_eOK) {
+    this->result = WriteMBR(this, &backup, components);
+  }
+
+  /*Enable memory protection*/
+  Flashboot_ProtectMem(this, target, true);
+  return this->result;
+}
+
+/*!
+ * Select a slot of the backup memory, the records of its generation are kept
+ * in its last sector. A single generation takes the whole backup memory.
+ * @param this        Struct initialized by ::Flashboot_Initialize function.
+ * @param index      Slot index
+ * @return           The memory of the slot.
+ */
+static Flashboot_Memory *GenerationSlot(Flashboot_Context *this,
+                                        uint8_t index) {
+  Flashboot_Memory *slot = &this->generations.slot;
+  uint32_t sector = Flashboot_MaxSectorSize(this->backupMem);
+  uint64_t size = this->backupMem->size / this->generations.count;
+
+  if (this->generations.count <= 1) {
+    return this->backupMem;
+  }
+
+  size -= size % sector;
+  *slot = *this->backupMem;
+  slot->startAddress += index * size;
+  slot->size = size - sector;
+  this->generations.record = *slot;
+  this->generations.record.startAddress += slot->size;
+  this->generations.record.size = sector;
+  return slot;
+}
+
+/*!
+ * Read the record of a slot of the backup memory.
+ * @param this        Struct initialized by ::Flashboot_Initialize function.
+ * @param index      Slot index
+ * @param next       Receives the address of the next record to be written
+ * @return           The sequence of the image of the slot, 0 if it has none.
+ */
+static uint32_t GenerationSequence(Flashboot_Context *this, uint8_t index,
+                                   uint64_t *next) {
+  Flashboot_GenerationRecord record;
+
+  GenerationSlot(this, index);
+  if (this->generations.count <= 1) {
+    return 0;
+  }
+  return ReadRecord(this, &this->generations.record,
+                    GENERATION_RECORD_MAGIC_KEY, &record, sizeof(record),
+                    next);
+}
+
+/*!
+ * Look for the slot of the backup memory with the newest image.
+ * @param this        Struct initialized by ::Flashboot_Initialize function.
+ * @param sequence   Receives the sequence of the newest image, 0 if none
+ * @return           The slot index.
+ */
+static uint8_t NewestGeneration(Flashboot_Context *this, uint32_t *sequence) {
+  uint8_t newest = 0;
+  uint64_t next;
+
+  *sequence = 0;
+  for (uint8_t i = 0; i < this->generations.count; i++) {
+    uint32_t current = GenerationSequence(this, i, &next);
+    if (current > *sequence) {
+      *sequence = current;
+      newest = i;
+    }
+  }
+  return newest;
+}
+
+Flashboot_eResult Flashboot_ReadGeneration(Flashboot_Context *this,
+                                           uint8_t age, Flashboot_MBR *mbr) {
+  uint8_t count = this->generations.count;
+  uint32_t sequence;
+  uint8_t newest;
+
+  Flashboot_ASSERT(this->backupMem == NULL || age >= count,
+                   Flashboot_eBadInputError);
+
+  /*The older images are in the slots before the newest one*/
+  newest = NewestGeneration(this, &sequence);
+  return Flashboot_SearchForMBR(
+      this, GenerationSlot(this, (newest + count - age) % count), mbr);
+}
+
+Flashboot_eResult Flashboot_StoreGeneration(Flashboot_Context *this,
+                                            const Flashboot_MBR *mbr) {
+  uint8_t count = this->generations.count;
+  Flashboot_GenerationRecord record = {
+      .magicKey = GENERATION_RECORD_MAGIC_KEY,
+  };
+  uint8_t index = NewestGeneration(this, &record.sequence);
+  Flashboot_Memory *slot = GenerationSlot(this, index);
+  uint64_t address = MBRAddress(UpdateStartAddress(this, slot,
+                                                   mbr->bootAddress) +
+                                mbr->size);
+  Flashboot_MBR stored;
+  uint64_t next;
+
+  /*The application is mostly the newest image, its MBR is read in place
+   * before the slots are searched*/
+  if (InMemory(slot, address, sizeof(stored)) &&
+      Flashboot_ReadMBR(this, address, &stored) == Flashboot_eOK &&
+      stored.mbrAddress == address && stored.crc == mbr->crc &&
+      stored.size == mbr->size) {
+    return Flashboot_eOK;
+  }
+
+  /*An image is kept once, whatever its age*/
+  for (uint8_t i = 0; i < count; i++) {
+    if (i != index &&
+        Flashboot_SearchForMBR(this, GenerationSlot(this, i), &stored) ==
+            Flashboot_eOK &&
+        stored.crc == mbr->crc) {
+      return Flashboot_eOK;
+    }
+  }
+
+  /*The oldest image is replaced, a refresh interrupted by a reset keeps the
+   * record of the previous image and is done again on the next boot*/
+  index = record.sequence ? (index + 1) % count : 0;
+  this->result =
+      Flashboot_RefreshBackup(this, GenerationSlot(this, index), mbr);
+
+  if (this->result == Flashboot_eOK && count > 1) {
+    record.sequence++;
+    GenerationSequence(this, index, &next);
+    Flashboot_ProtectMem(this, &this->generations.record, false);
+    this->result = AppendRecord(this, &this->generations.record, &next,
+                                &record, sizeof(record));
+    Flashboot_ProtectMem(this, &this->generations.record, true);
+  }
+  return this->result;
+}
+
+Flashboot_eResult Flashboot_CopyGeneration(Flashboot_Context *this,
+                                           uint8_t age) {
+  this->result = Flashboot_ReadGeneration(this, age, &this->mbr);
+
+  /*A corrupted image isn't copied over the application*/
+  if (this->result == Flashboot_eOK &&
+      Flashboot_CalcCRC(this, this->mbr.loadAddress, this->mbr.size) !=
+          this->mbr.crc) {
+    this->result = Flashboot_eCRCError;
+  }
+  if (this->result == Flashboot_eOK) {
+    this->result = Flashboot_CopyToMemory(this, this->progMem, &this->mbr);
+  }
+  return this->result;
+}
+
+/*!
+ * End of the range taken by an image of a multi-image update, with its MBR
+ * and, for the image booted, the addresses of the component MBRs.
+ * @param this        Struct initialized by ::Flashboot_Initialize function.
+ * @param index      Image index in the manifest
+ * @return           The end address of the range.
+ */
+static uint64_t ImageEnd(Flashboot_Context *this, uint8_t index) {
+  const Flashboot_Image *image = &this->manifest.image[index];
+  uint64_t end =
+      MBRAddress(image->address + image->size) + sizeof(Flashboot_MBR);
+
+  return index ? end : end + sizeof(uint64_t) * (this->manifest.count - 1);
+}
+
+/*!
+ * Point the update to an image of a multi-image update, its range was erased
+ * by ::Flashboot_ManifestStart.
+ * @param this        Struct initialized by ::Flashboot_Initialize function.
+ * @param index      Image index in the manifest
+ */
+static void BeginImage(Flashboot_Context *this, uint8_t index) {
+  const Flashboot_Image *image = &this->manifest.image[index];
+
+  this->update.memory = Flashboot_GetMemory(this, image->address, image->size);
+  this->update.size = image->size;
+  this->update.bootAddress = this->update.startAddress =
+      this->update.currentAddress = image->address;
+  this->update.erasedAddress =
+      this->update.memory->startAddress + this->update.memory->size;
+  this->update.pageFill = 0;
+  this->update.keepBlock = 0;
+  this->manifest.current = index;
+}
+
+/*!
+ * Check the images of a multi-image update, each one shall fit a memory
+ * without overlapping the others and the first one is booted from the
+ * program memory.
+ * @param this        Struct initialized by ::Flashboot_Initialize function.
+ * @return
+ */
+static Flashboot_eResult CheckManifest(Flashboot_Context *this) {
+  uint8_t count = this->manifest.count;
+
+  Flashboot_ASSERT(count == 0 || count > FLASHBOOT_MAX_IMAGES ||
+                       this->slots.record,
+                   Flashboot_eBadInputError);
+
+  for (uint8_t i = 0; i < count; i++) {
+    const Flashboot_Image *image = &this->manifest.image[i];
+    uint64_t end = ImageEnd(this, i);
+    const Flashboot_Memory *memory =
+        Flashboot_GetMemory(this, image->address, end - image->address);
+
+    Flashboot_ASSERT(memory == NULL || (i == 0 && memory != this->progMem),
+                     Flashboot_eAddressOutOfBoundsError);
+    Flashboot_ASSERT(image->address % memory->pageSize,
+                     Flashboot_eAlignmentError);
+    Flashboot_ASSERT(memory->pageSize > FLASHBOOT_MAX_PAGE_SIZE,
+                     Flashboot_eBufferOverflowError);
+    for (uint8_t j = 0; j < i; j++) {
+      Flashboot_ASSERT(image->address < ImageEnd(this, j) &&
+                           this->manifest.image[j].address < end,
+                       Flashboot_eAddressOutOfBoundsError);
+    }
+  }
+  return Flashboot_eOK;
+}
+
+Flashboot_eResult Flashboot_ManifestStart(Flashboot_Context *this) {
+  uint8_t count = this->manifest.count;
+
+  /*Every image is checked before anything is erased*/
+  this->result = CheckManifest(this);
+
+  /*The previous images of each memory are invalidated and the range of each
+   * image erased, the sectors shared by two images or erased already are
+   * skipped*/
+  for (uint8_t i = 0; this->result == Flashboot_eOK && i < count; i++) {
+    const Flashboot_Image *image = &this->manifest.image[i];
+    bool invalidated = false;
+
+    BeginImage(this, i);
+    for (uint8_t j = 0; j < i; j++) {
+      invalidated |= this->update.memory ==
+                     Flashboot_GetMemory(this, this->manifest.image[j].address,
+                                         this->manifest.image[j].size);
+    }
+
+    Flashboot_ProtectMem(this, this->update.memory, false);
+    if (!invalidated) {
+      this->result = InvalidateMBRs(this, this->update.memory);
+    }
+    if (this->result == Flashboot_eOK) {
+      this->result = EraseBeforeWrite(this, image->address,
+                                      ImageEnd(this, i) - image->address);
+    }
+  }
+
+  this->manifest.offset = 0;
+  if (this->result == Flashboot_eOK) {
+    BeginImage(this, 0);
+  } else {
+    this->manifest.count = 0;
+    this->update.size = this->update.startAddress =
+        this->update.currentAddress = 0;
+  }
+  return this->result;
+}
+
+Flashboot_eResult Flashboot_ManifestWrite(Flashboot_Context *this,
+                                          uint64_t offset, const uint8_t *data,
+                                          uint64_t size, uint8_t value) {
+  const Flashboot_Image *image = this->manifest.image;
+  uint64_t written = this->manifest.offset + this->update.currentAddress -
+                     this->update.startAddress;
+  uint64_t base = 0;
+
+  /*A previous packet was lost, ask the host to resume from the current
+   * offset. The regions are filled in order*/
+  this->result = Flashboot_eRetransmitRequest;
+  if (offset > written || (offset < written && data == NULL)) {
+    return this->result;
+  }
+
+  /*Retransmission of a region already written, split at the end of each
+   * image. The tail of the stream still in the page being assembled is
+   * replaced there, what follows the stream position continues it*/
+  this->result = Flashboot_eOK;
+  while (this->result == Flashboot_eOK && offset < written && size) {
+    uint64_t address, length, flushed = UINT64_MAX;
+
+    while (offset >= base + image->size) {
+      base += image->size;
+      image++;
+    }
+    if (image == &this->manifest.image[this->manifest.current]) {
+      flushed = this->update.currentAddress - this->update.pageFill;
+    }
+
+    address = image->address + offset - base;
+    length = base + image->size - offset;
+    length = written - offset < length ? written - offset : length;
+    length = size < length ? size : length;
+    if (address >= flushed) {
+      memcpy(this->update.page + (address - flushed), data, length);
+    } else {
+      length = flushed - address < length ? flushed - address : length;
+      this->result = Rewrite(this, address, data, (uint32_t)length);
+    }
+    offset += length;
+    data += length;
+    size -= length;
+  }
+
+  /*The images are streamed back to back*/
+  while (this->result == Flashboot_eOK && size) {
+    uint64_t length = this->update.startAddress + this->update.size -
+                      this->update.currentAddress;
+
+    if (length == 0) {
+      this->result = Flashboot_eAddressOutOfBoundsError;
+      if (this->manifest.current + 1 < this->manifest.count) {
+        this->result = FlushPage(this);
+        this->manifest.offset += this->update.size;
+        BeginImage(this, this->manifest.current + 1);
+      }
+      continue;
+    }
+
+    length = size < length ? size : length;
+    if (data) {
+      this->result = Flashboot_FlashWrite(this, data, length);
+      data += length;
+    } else {
+      this->result = Flashboot_FlashFill(
+          this, this->update.currentAddress - this->update.startAddress,
+          length, value);
+    }
+    size -= length;
+  }
+  return this->result;
+}
+
+Flashboot_eResult Flashboot_ManifestFinish(Flashboot_Context *this) {
+  const Flashboot_Image *image = this->manifest.image;
+  uint8_t count = this->manifest.count;
+  uint64_t components[FLASHBOOT_MAX_IMAGES];
+
+  /*Write the last slice that didn't fill a page*/
+  this->result = FlushPage(this);
+
+  /*Every image shall match its CRC before any MBR is written*/
+  for (uint8_t i = 0; this->result == Flashboot_eOK && i < count; i++) {
+    if (Flashboot_CalcCRC(this, image[i].address, image[i].size) !=
+        image[i].crc) {
+      this->result = Flashboot_eCRCError;
+    }
+  }
+
+  /*The components are committed first, the MBR of the image booted lists
+   * them and commits the whole update*/
+  for (uint8_t i = count; this->result == Flashboot_eOK && i-- > 0;) {
+    Flashboot_MBR mbr = {
+        .magicKey = i ? MBR_MAGIC_KEY_COMPONENT : MBR_MAGIC_KEY_V2,
+        .version = image[i].version,
+        .loadAddress = image[i].address,
+        .bootAddress = image[i].address,
+        .size = image[i].size,
+        .mbrAddress = MBRAddress(image[i].address + image[i].size),
+        .crc = image[i].crc,
+        .components = i ? 0 : count - 1,
+    };
+
+    components[i] = mbr.mbrAddress;
+    BeginImage(this, i);
+    this->result = WriteMBR(this, &mbr, &components[1]);
+  }
+
+  for (uint8_t i = 0; i < count; i++) {
+    BeginImage(this, i);
+
+    /*If a CRC mismatch erase the images*/
+    if (this->result == Flashboot_eCRCError) {
+      Flashboot_MemoryErase(this, image[i].address, image[i].size);
+    }
+
+    /*Enable memory protection*/
+    Flashboot_ProtectMem(this, this->update.memory, true);
+  }
+
+  this->manifest.count = 0;
+  this->update.size = this->update.startAddress = this->update.currentAddress =
+      0;
+  return this->result;
+}
+
+Flashboot_eResult Flashboot_CheckComponents(Flashboot_Context *this,
+                                            const Flashboot_MBR *mbr) {
+  Flashboot_ASSERT(mbr->components >= FLASHBOOT_MAX_IMAGES,
+                   Flashboot_eGeneralError);
+
+  for (uint32_t i = 0; i < mbr->components; i++) {
+    Flashboot_MBR component;
+    uint64_t address;
+
+    Flashboot_ReadMem(this,
+                      mbr->mbrAddress + sizeof(*mbr) + i * sizeof(address),
+                      (uint8_t *)&address, sizeof(address));
+    Flashboot_ASSERT(
+        Flashboot_ReadMBR(this, address, &component) != Flashboot_eOK ||
+            component.magicKey != MBR_MAGIC_KEY_COMPONENT ||
+            component.mbrAddress != address ||
+            Flashboot_CalcCRC(this, component.loadAddress, component.size) !=
+                component.crc,
+        Flashboot_eCRCError);
+  }
+  return Flashboot_eOK;
+}
+
+Flashboot_eResult Flashboot_CheckBlocks(Flashboot_Context *this,
+                                        const Flashboot_MBR *mbr,
+                                        const Flashboot_BlockTable *table,
+                                        uint32_t first, uint32_t count) {
+  uint64_t address = mbr->loadAddress, end = address + mbr->size;
+  uint64_t entry = BlockTableAddress(mbr) + sizeof(*table);
+
+  /*The check stops at the first corrupted block*/
+  for (uint32_t i = 0; address < end && (i < first || i - first < count);
+       i++) {
+    uint64_t next = BlockEnd(address, end, table->blockSize);
+    uint32_t crc;
+
+    if (i >= first) {
+      Flashboot_ReadMem(this, entry, (uint8_t *)&crc, sizeof(crc));
+      Flashboot_ASSERT(Flashboot_CalcCRC(this, address, next - address) !=
+                           crc,
+                       Flashboot_eCRCError);
+    }
+    address = next;
+    entry += sizeof(crc);
+  }
+  return Flashboot_eOK;
+}
+
+Flashboot_eResult Flashboot_VerifyImage(Flashboot_Context *this,
+                                        const Flashboot_MBR *mbr) {
+  Flashboot_Memory *memory =
+      Flashboot_GetMemory(this, mbr->loadAddress, mbr->size);
+  Flashboot_eVerify policy = this->verify.policy;
+  uint32_t samples = FLASHBOOT_VERIFY_SAMPLES;
+  Flashboot_BlockTable table;
+  Flashboot_eResult result;
+  uint64_t verified;
+  uint32_t mark;
+
+  /*Without a table the image is checked as a whole*/
+  if (memory == NULL || ReadBlockTable(this, mbr, &table) != Flashboot_eOK) {
+    return Flashboot_CalcCRC(this, mbr->loadAddress, mbr->size) == mbr->crc
+               ? Flashboot_eOK
+               : Flashboot_eCRCError;
+  }
+
+  /*The first boot after the image was written checks every block and marks
+   * it verified, the next ones follow the policy*/
+  verified = VerifiedAddress(memory, mbr, &table);
+  Flashboot_ReadMem(this, verified, (uint8_t *)&mark, sizeof(mark));
+  if (policy == Flashboot_eVerifyFull || mark != 0) {
+    result = Flashboot_CheckBlocks(this, mbr, &table, 0, table.count);
+    if (result == Flashboot_eOK && policy != Flashboot_eVerifyFull) {
+      uint32_t markSize = RecordSize(memory, sizeof(uint32_t));
+
+      memset(this->update.page, 0, markSize);
+      Flashboot_ProtectMem(this, memory, false);
+      result = CanProgram(this, verified, NULL, markSize)
+                   ? Flashboot_MemoryWrite(this, verified, this->update.page,
+                                           markSize)
+                   : Flashboot_MemoryProgram(this, verified, this->update.page,
+                                             markSize);
+      Flashboot_ProtectMem(this, memory, true);
+    }
+    return result;
+  }
+
+  /*A few blocks are checked on each boot, covering the whole image after
+   * some boots*/
+  if (policy == Flashboot_eVerifySampled) {
+    uint32_t rounds = (table.count + samples - 1) / samples;
+    return Flashboot_CheckBlocks(this, mbr, &table,
+                                 (this->verify.bootCount % rounds) * samples,
+                                 samples);
+  }
+  return Flashboot_eOK;
+}
+
+Flashboot_eResult Flashboot_RepairBlocks(Flashboot_Context *this,
+                                         const Flashboot_MBR *backup) {
+  uint32_t pageSize = this->progMem->pageSize;
+  Flashboot_BlockTable table;
+  Flashboot_MBR mbr;
+  bool repaired = false;
+
+  /*The program memory shall keep the image of the backup, with its table*/
+  Flashboot_ASSERT(
+      Flashboot_SearchForMBR(this, this->progMem, &mbr) != Flashboot_eOK ||
+          mbr.crc != backup->crc || mbr.size != backup->size ||
+          ReadBlockTable(this, &mbr, &table) != Flashboot_eOK,
+      Flashboot_eGeneralError);
+
+  uint64_t address = mbr.loadAddress, end = address + mbr.size;
+  uint64_t entry = BlockTableAddress(&mbr) + sizeof(table);
+
+  this->update.memory = this->progMem;
+  this->result = Flashboot_eOK;
+
+  /*Disable flash projection*/
+  Flashboot_ProtectMem(this, this->progMem, false);
+
+  /*Only the corrupted blocks are erased and copied from the backup*/
+  while (this->result == Flashboot_eOK && address < end) {
+    uint64_t next = BlockEnd(address, end, table.blockSize);
+    uint32_t crc, length = (uint32_t)(next - address);
+
+    Flashboot_ReadMem(this, entry, (uint8_t *)&crc, sizeof(crc));
+    if (Flashboot_CalcCRC(this, address, length) != crc) {
+      repaired = true;
+      length += (pageSize - (length % pageSize)) % pageSize;
+      this->result = EraseBeforeWrite(this, address, length);
+      if (this->result == Flashboot_eOK) {
+        this->result =
+            CopyMemory(this, address,
+                       backup->loadAddress + (address - mbr.loadAddress),
+                       length);
+      }
+    }
+    address = next;
+    entry += sizeof(crc);
+  }
+
+  /*Enable memory protection*/
+  Flashboot_ProtectMem(this, this->progMem, true);
+
+  /*Without a corrupted block the image failed for another reason, it's
+   * copied as a whole*/
+  if (this->result == Flashboot_eOK && !repaired) {
+    this->result = Flashboot_eGeneralError;
+  }
+  if (this->result == Flashboot_eOK) {
+    this->result = Flashboot_CheckBlocks(this, &mbr, &table, 0, table.count);
+  }
+  return this->result;
+}
+
+uint32_t Flashboot_CalcCRC(Flashboot_Context *this, uint64_t address,
+                           uint64_t size) {
+  return ContinueCRC(this, 0, address, size);
+}
+
+uint32_t Flashboot_DataCRC(Flashboot_Context *this, uint32_t crc,
+                           const void *data, uint32_t size) {
+  this->stats.crcBytes += size;
+  return this->interface->CalcCRC(this->arg, crc, (void *)data, size);
+}
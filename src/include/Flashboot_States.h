@@ -42,6 +42,72 @@ void State_UpdateTransfer(void *arg);
  */
 void State_UpdateFinish(void *arg);
 
+/*!
+ * Process Update Resume command
+ * @param arg  Library context struct
+ */
+void State_UpdateResume(void *arg);
+
+/*!
+ * Process Update Manifest command
+ * @param arg  Library context struct
+ */
+void State_UpdateManifest(void *arg);
+
+/*!
+ * Process Generation List command
+ * @param arg  Library context struct
+ */
+void State_GenerationList(void *arg);
+
+/*!
+ * Process Generation Restore command
+ * @param arg  Library context struct
+ */
+void State_GenerationRestore(void *arg);
+
+/*!
+ * Process Get Stats command
+ * @param arg  Library context struct
+ */
+void State_GetStats(void *arg);
+
+/*!
+ * Process Update Fill command
+ * @param arg  Library context struct
+ */
+void State_UpdateFill(void *arg);
+
+/*!
+ * Reply the CRCs of a list of memory ranges
+ * @param arg  Library context struct
+ */
+void State_RangeCRC(void *arg);
+
+/*!
+ * Process Read Memory command
+ * @param arg  Library context struct
+ */
+void State_ReadMemory(void *arg);
+
+/*!
+ * Send the next slice of the range being read while the window allows
+ * @param arg  Library context struct
+ */
+void State_ReadStream(void *arg);
+
+/*!
+ * Process Read Ack command
+ * @param arg  Library context struct
+ */
+void State_ReadAck(void *arg);
+
+/*!
+ * Execute the commands of a batch in order and reply all the results
+ * @param arg  Library context struct
+ */
+void State_Batch(void *arg);
+
 /*!
  * Check if the application CRC is valid
  * @param arg  Library context struct
@@ -20,6 +20,28 @@ Flashboot_eResult Flashboot_MemoryWrite(Flashboot_Context *this,
                                         uint64_t address, uint8_t *data,
                                         uint32_t size);
 
+/*!
+ * Read the memory through the driver of the memory that contains the address,
+ * a read past the end of the memory is split at its end
+ * @param this        Struct initialized by ::Flashboot_Initialize function.
+ * @param address    Start read address
+ * @param data       Buffer to receive the data
+ * @param size       Size to be read
+ * @return           The amount of bytes read.
+ */
+uint32_t Flashboot_ReadMem(Flashboot_Context *this, uint64_t address,
+                           uint8_t *data, uint32_t size);
+
+/*!
+ * Enable/disable the protection of a memory through its driver
+ * @param this        Struct initialized by ::Flashboot_Initialize function.
+ * @param memory     Memory to be protected
+ * @param lock       True to enable protection and False to disable.
+ * @return
+ */
+uint32_t Flashboot_ProtectMem(Flashboot_Context *this,
+                              const Flashboot_Memory *memory, bool lock);
+
 /*!
  * Erase a space of the memory taking in consideration it limitations
  * @param this        Struct initialized by ::Flashboot_Initialize function.
@@ -28,7 +50,65 @@ Flashboot_eResult Flashboot_MemoryWrite(Flashboot_Context *this,
  * @return
  */
 Flashboot_eResult Flashboot_MemoryErase(Flashboot_Context *this,
-                                        uint64_t address, uint32_t size);
+                                        uint64_t address, uint64_t size);
+
+/*!
+ * Program data over a range that may not be erased. Memories with
+ * ::FLASHBOOT_MEMORY_BIT_CLEAR are programmed in place when the data only
+ * clears bits, otherwise the range is erased before.
+ * @param this        Struct initialized by ::Flashboot_Initialize function.
+ * @param address    Start address to write
+ * @param data       Data to be written, it can't be in the work buffer
+ * @param size       Data size
+ * @return
+ */
+Flashboot_eResult Flashboot_MemoryProgram(Flashboot_Context *this,
+                                          uint64_t address,
+                                          const uint8_t *data, uint32_t size);
+
+/*!
+ * Invalidate a MBR, so the binary is not booted anymore
+ * @param this        Struct initialized by ::Flashboot_Initialize function.
+ * @param address    MBR address
+ * @return
+ */
+Flashboot_eResult Flashboot_InvalidateMBR(Flashboot_Context *this,
+                                          uint64_t address);
+
+/*!
+ * Find the sector that contains an address
+ * @param memory     Memory description
+ * @param address    Address in the sector
+ * @param sector     Receives the sector address
+ * @return           The sector size, 0 if the address is not in the sector map.
+ */
+uint32_t Flashboot_GetSector(const Flashboot_Memory *memory, uint64_t address,
+                             uint64_t *sector);
+
+/*!
+ * Size of the biggest sector of a memory
+ * @param memory     Memory description
+ * @return           The sector size.
+ */
+uint32_t Flashboot_MaxSectorSize(const Flashboot_Memory *memory);
+
+/*!
+ * Select the state that processes the command in the frame received
+ * @param this        Struct initialized by ::Flashboot_Initialize function.
+ * @return            ::Flashboot_eProtocolError if the command is unknown.
+ */
+Flashboot_eResult Flashboot_SelectCommand(Flashboot_Context *this);
+
+/*!
+ * Send a reply to the host, unless it's part of a batch which has a single
+ * reply.
+ * @param this        Struct initialized by ::Flashboot_Initialize function.
+ * @param frame       Reply frame
+ * @param size        Reply size
+ * @return            The amount of bytes sent.
+ */
+uint32_t Flashboot_SendReply(Flashboot_Context *this, Flashboot_Frame *frame,
+                             uint32_t size);
 
 /*!
  * Set a timeout
@@ -46,24 +126,303 @@ Flashboot_eResult Flashboot_SetTimeout(Flashboot_Context *this,
  */
 Flashboot_eResult Flashboot_CheckTimeout(Flashboot_Context *this);
 
+/*!
+ * Read the MBR at an address, whatever its layout
+ * @param this        Struct initialized by ::Flashboot_Initialize function.
+ * @param address    MBR address
+ * @param mbr        Receives the MBR in the ::Flashboot_MBR layout
+ * @return           ::Flashboot_eGeneralError if there's no MBR.
+ */
+Flashboot_eResult Flashboot_ReadMBR(Flashboot_Context *this, uint64_t address,
+                                    Flashboot_MBR *mbr);
+
 Flashboot_eResult Flashboot_SearchForMBR(Flashboot_Context *this,
                                          Flashboot_Memory *mem,
                                          Flashboot_MBR *mbr);
 
+/*!
+ * Read the slot-selection records and keep the current one
+ * @param this       Struct initialized by ::Flashboot_Initialize function.
+ * @return           ::Flashboot_eGeneralError if there's no valid record.
+ */
+Flashboot_eResult Flashboot_ReadSlotRecord(Flashboot_Context *this);
+
+/*!
+ * Append a record that selects the slot to be booted
+ * @param this       Struct initialized by ::Flashboot_Initialize function.
+ * @param slot       Slot index, 0 for the program memory
+ * @return
+ */
+Flashboot_eResult Flashboot_SwitchSlot(Flashboot_Context *this, uint8_t slot);
+
+/*!
+ * Select the slot to be booted and load its MBR. The slot of the record is
+ * preferred, or the one with the newest image when there's no record, and
+ * the other one is booted when its image is corrupted.
+ * @param this       Struct initialized by ::Flashboot_Initialize function.
+ * @return           ::Flashboot_eGeneralError if no slot has a valid image.
+ */
+Flashboot_eResult Flashboot_SelectSlot(Flashboot_Context *this);
+
+/*!
+ * Read the update journal and keep its current entry
+ * @param this       Struct initialized by ::Flashboot_Initialize function.
+ * @return           ::Flashboot_eGeneralError if no update is in progress.
+ */
+Flashboot_eResult Flashboot_ReadJournal(Flashboot_Context *this);
+
+/*!
+ * Memory that receives an update, in A/B mode it's the slot not in use
+ * @param this       Struct initialized by ::Flashboot_Initialize function.
+ * @param memory     Memory that receives the update otherwise
+ * @return           The target memory.
+ */
+Flashboot_Memory *Flashboot_UpdateTarget(Flashboot_Context *this,
+                                         Flashboot_Memory *memory);
+
+/*!
+ * Find the memory known by the loader that contains a range
+ * @param this       Struct initialized by ::Flashboot_Initialize function.
+ * @param address    Range start address
+ * @param size       Range size
+ * @return           The memory or NULL if the range isn't inside a memory.
+ */
+Flashboot_Memory *Flashboot_GetMemory(Flashboot_Context *this,
+                                      uint64_t address, uint64_t size);
+
 Flashboot_eResult Flashboot_CopyToMemory(Flashboot_Context *this,
                                          Flashboot_Memory *mem,
                                          Flashboot_MBR *mbr);
 
+/*!
+ * Refresh the copy of the application kept in a memory, only the sectors that
+ * differ from the program memory are erased and copied, then its MBR is
+ * written.
+ * @param this       Struct initialized by ::Flashboot_Initialize function.
+ * @param target     Memory that keeps the copy
+ * @param mbr        MBR of the application in the program memory
+ * @return
+ */
+Flashboot_eResult Flashboot_RefreshBackup(Flashboot_Context *this,
+                                          Flashboot_Memory *target,
+                                          const Flashboot_MBR *mbr);
+
+/*!
+ * Start an update, the previous binaries of the memory are invalidated and the
+ * memory erased as its flags require.
+ * @details A differential update keeps the memory content instead. The host
+ * sends only the blocks that changed, see ::Flashboot_RangeCRC, each one is
+ * erased when the update reaches it and the others are kept.
+ * @param this        Struct initialized by ::Flashboot_Initialize function.
+ * @param target      Memory that receives the update
+ * @param bootAddress Boot address of the update
+ * @param size        Update size
+ * @param version     Version expected for the update
+ * @param crc         CRC expected for the update, 0 if unknown
+ * @param keepBlock   Block size of a differential update, a multiple of the
+ * page size. 0 to erase the memory.
+ * @return
+ */
 Flashboot_eResult Flashboot_FlashStart(Flashboot_Context *this,
                                        Flashboot_Memory *target,
                                        const uint64_t bootAddress,
-                                       uint32_t size);
+                                       uint64_t size, uint32_t version,
+                                       uint32_t crc, uint32_t keepBlock);
+
+/*!
+ * Continue the update recorded by the journal from its last checkpoint.
+ * @details The region written after the checkpoint is erased again, and an
+ * update interrupted before its first checkpoint is started again.
+ * @param this        Struct initialized by ::Flashboot_Initialize function.
+ * @param target      Memory that receives the update
+ * @param bootAddress Boot address of the update
+ * @param size        Update size
+ * @param version     Version expected for the update
+ * @param crc         CRC expected for the update, 0 if unknown
+ * @return            ::Flashboot_eGeneralError if the journal doesn't record
+ * this update.
+ */
+Flashboot_eResult Flashboot_FlashResume(Flashboot_Context *this,
+                                        Flashboot_Memory *target,
+                                        const uint64_t bootAddress,
+                                        uint64_t size, uint32_t version,
+                                        uint32_t crc);
+
+/*!
+ * Write the next slice of the update in progress.
+ * @details Slices may have any size, whole pages are written straight from
+ * the slice and a tail that doesn't fill a page is kept until the next slice
+ * or ::Flashboot_FlashFinish completes it.
+ * @param this       Struct initialized by ::Flashboot_Initialize function.
+ * @param data       Slice data.
+ * @param size       Slice size.
+ * @return
+ */
 Flashboot_eResult Flashboot_FlashWrite(Flashboot_Context *this,
                                        const uint8_t *data, uint32_t size);
+
+/*!
+ * Write a slice of the update in progress at a given offset.
+ * @details A slice at the current address continues the stream, a slice
+ * beyond it means a packet was lost and ::Flashboot_eRetransmitRequest is
+ * returned, and a slice inside the region already written is a selective
+ * retransmission that rewrites only that region.
+ * @param this       Struct initialized by ::Flashboot_Initialize function.
+ * @param offset     Slice offset from the update start address.
+ * @param data       Slice data.
+ * @param size       Slice size.
+ * @return
+ */
+Flashboot_eResult Flashboot_FlashWriteAt(Flashboot_Context *this,
+                                         uint64_t offset, const uint8_t *data,
+                                         uint32_t size);
+
+/*!
+ * Fill the next region of the update in progress with a constant value.
+ * @details Regions filled with the erased value are not programmed, the
+ * region was erased already by ::Flashboot_FlashStart.
+ * @param this       Struct initialized by ::Flashboot_Initialize function.
+ * @param offset     Region offset from the update start address.
+ * @param size       Region size.
+ * @param value      Value of every byte of the region.
+ * @return
+ */
+Flashboot_eResult Flashboot_FlashFill(Flashboot_Context *this,
+                                      uint64_t offset, uint64_t size,
+                                      uint8_t value);
 Flashboot_eResult Flashboot_FlashFinish(Flashboot_Context *this,
                                         const uint32_t crc, uint32_t version);
 
+/*!
+ * Start the multi-image update described by Flashboot_Context::manifest.
+ * @details Every image is checked before anything is erased, then the
+ * previous images of their memories are invalidated and only the range of
+ * each image, with its MBR, is erased.
+ * @param this       Struct initialized by ::Flashboot_Initialize function.
+ * @return
+ */
+Flashboot_eResult Flashboot_ManifestStart(Flashboot_Context *this);
+
+/*!
+ * Write a slice of the multi-image update in progress at a given offset of
+ * the stream, the images are streamed back to back in the manifest order.
+ * @param this       Struct initialized by ::Flashboot_Initialize function.
+ * @param offset     Slice offset from the start of the stream.
+ * @param data       Slice data, NULL to fill the slice with value.
+ * @param size       Slice size.
+ * @param value      Value of every byte of the slice when data is NULL.
+ * @return
+ */
+Flashboot_eResult Flashboot_ManifestWrite(Flashboot_Context *this,
+                                          uint64_t offset, const uint8_t *data,
+                                          uint64_t size, uint8_t value);
+
+/*!
+ * Finish the multi-image update in progress. The MBRs are written only when
+ * every image matches its CRC, the one of the image booted is the last.
+ * @param this       Struct initialized by ::Flashboot_Initialize function.
+ * @return
+ */
+Flashboot_eResult Flashboot_ManifestFinish(Flashboot_Context *this);
+
+/*!
+ * Check the components listed after the MBR of the image booted
+ * @param this       Struct initialized by ::Flashboot_Initialize function.
+ * @param mbr        MBR of the image booted
+ * @return           ::Flashboot_eCRCError if a component is missing or
+ * corrupted.
+ */
+Flashboot_eResult Flashboot_CheckComponents(Flashboot_Context *this,
+                                            const Flashboot_MBR *mbr);
+
+/*!
+ * Check blocks of an image against its CRC table, see ::Flashboot_SetBlockCRC
+ * @param this       Struct initialized by ::Flashboot_Initialize function.
+ * @param mbr        MBR of the image
+ * @param table      Table of the image, read and checked already
+ * @param first      Index of the first block to be checked
+ * @param count      Amount of blocks to be checked
+ * @return           ::Flashboot_eCRCError at the first corrupted block.
+ */
+Flashboot_eResult Flashboot_CheckBlocks(Flashboot_Context *this,
+                                        const Flashboot_MBR *mbr,
+                                        const Flashboot_BlockTable *table,
+                                        uint32_t first, uint32_t count);
+
+/*!
+ * Check an image before a boot, in the program memory or in a slot of the A/B
+ * mode, as selected by ::Flashboot_SetVerifyPolicy
+ * @param this       Struct initialized by ::Flashboot_Initialize function.
+ * @param mbr        MBR of the image
+ * @return
+ */
+Flashboot_eResult Flashboot_VerifyImage(Flashboot_Context *this,
+                                        const Flashboot_MBR *mbr);
+
+/*!
+ * Repair the image in the program memory copying only its corrupted blocks
+ * from the backup memory
+ * @param this       Struct initialized by ::Flashboot_Initialize function.
+ * @param backup     MBR of the image in the backup memory
+ * @return           ::Flashboot_eOK if the image was repaired, an error if it
+ * has to be copied as a whole, as when none of its blocks is corrupted.
+ */
+Flashboot_eResult Flashboot_RepairBlocks(Flashboot_Context *this,
+                                         const Flashboot_MBR *backup);
+
+/*!
+ * Read the MBR of an image kept in the backup memory, see
+ * ::Flashboot_SetBackupGenerations.
+ * @param this       Struct initialized by ::Flashboot_Initialize function.
+ * @param age        Generation, 0 for the newest image
+ * @param mbr        Receives the MBR of the image
+ * @return           ::Flashboot_eOK if the slot of the generation holds an
+ * image.
+ */
+Flashboot_eResult Flashboot_ReadGeneration(Flashboot_Context *this,
+                                           uint8_t age, Flashboot_MBR *mbr);
+
+/*!
+ * Keep an image as the newest generation of the backup memory, over the
+ * oldest one, unless it's kept already.
+ * @param this       Struct initialized by ::Flashboot_Initialize function.
+ * @param mbr        MBR of the image in the program memory
+ * @return
+ */
+Flashboot_eResult Flashboot_StoreGeneration(Flashboot_Context *this,
+                                            const Flashboot_MBR *mbr);
+
+/*!
+ * Copy an image kept in the backup memory to the program memory, after
+ * checking its CRC.
+ * @param this       Struct initialized by ::Flashboot_Initialize function.
+ * @param age        Generation, 0 for the newest image
+ * @return
+ */
+Flashboot_eResult Flashboot_CopyGeneration(Flashboot_Context *this,
+                                           uint8_t age);
+
+/*!
+ * Calculate the CRC of a memory range of any size, in chunks that fit
+ * Flashboot_Interface::CalcCRC.
+ * @param this       Struct initialized by ::Flashboot_Initialize function.
+ * @param address    Range start address
+ * @param size       Range size
+ * @return           The CRC of the range.
+ */
 uint32_t Flashboot_CalcCRC(Flashboot_Context *this, uint64_t address,
-                           uint32_t size);
+                           uint64_t size);
+
+/*!
+ * Continue a CRC over data in RAM through Flashboot_Interface::CalcCRC,
+ * counting the bytes calculated.
+ * @param this       Struct initialized by ::Flashboot_Initialize function.
+ * @param crc        CRC of the data before, 0 to start a CRC
+ * @param data       Data
+ * @param size       Data size
+ * @return           The CRC of the data before and of the data.
+ */
+uint32_t Flashboot_DataCRC(Flashboot_Context *this, uint32_t crc,
+                           const void *data, uint32_t size);
 
 #endif /* FLASHBOOT_HELPER_H_ */
@@ -9,14 +9,12 @@
 void State_BackupFW(void *arg) {
   Flashboot_Context *this = (Flashboot_Context *)arg;
 
+  this->timing.state = Flashboot_StateBackupFW;
+
   this->Flashboot_State = State_Boot;
 
   if (this->backupMem && this->createBackup) {
-    Flashboot_MBR mbr;
-    /*Look for a valid application MBR*/
-    if (Flashboot_SearchForMBR(this, this->backupMem, &mbr) != Flashboot_eOK ||
-        mbr.crc != this->mbr.crc) {
-      Flashboot_CopyToMemory(this, this->backupMem, &this->mbr);
-    }
+    /*The application is kept unless a generation has it already*/
+    Flashboot_StoreGeneration(this, &this->mbr);
   }
 }
@@ -0,0 +1,89 @@
+// Copyright Douglas Santos Reis.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "Flashboot_States.h"
+#include "Flashboot_Types.h"
+#include <Helper.h>
+
+/*!
+ * Check if a command can be part of a batch. The batch has a single reply, so
+ * the commands replied with data are left out, and each command runs a single
+ * state, so the boot, which takes several ones, can only be the last one and
+ * continues after the batch.
+ * @param id     Command id.
+ * @param last   The command is the last one of the batch.
+ * @return true if the command is allowed.
+ */
+static bool BatchAllowed(Flashboot_CmdId id, bool last) {
+  switch (id) {
+  case Flashboot_UpdateStart:
+  case Flashboot_UpdateTransfer:
+  case Flashboot_UpdateFill:
+  case Flashboot_UpdateFinish:
+  case Flashboot_UpdateResume:
+  case Flashboot_UpdateManifest:
+  case Flashboot_GenerationRestore:
+    return true;
+  case Flashboot_BootApplication:
+    return last;
+  default:
+    return false;
+  }
+}
+
+void State_Batch(void *arg) {
+  Flashboot_Context *this = (Flashboot_Context *)arg;
+  const uint8_t *data = this->frame->payload.batch.frames;
+  uint32_t size = this->frameSize - sizeof(this->frame->id);
+  Flashboot_Frame frame;
+
+  this->timing.state = Flashboot_StateBatch;
+  frame.id = Flashboot_Result;
+  frame.payload.batchResult.count = 0;
+  this->result = Flashboot_eOK;
+
+  /*Execute the commands in order until the first failure, the states that
+   * follow the last one, as a boot, continue after the batch*/
+  this->batch = true;
+  while (this->result == Flashboot_eOK && size) {
+    uint16_t length = 0;
+
+    this->result = Flashboot_eProtocolError;
+    if (size >= sizeof(length) &&
+        frame.payload.batchResult.count < BATCH_MAX_COMMANDS) {
+      length = FLASHBOOT_ARRAY_TO_U16(data);
+      data += sizeof(length);
+      size -= sizeof(length);
+    }
+
+    if (length && length <= size) {
+      this->frame = (Flashboot_Frame *)data;
+      this->frameSize = length;
+      if (BatchAllowed(this->frame->id, length == size)) {
+        this->result = Flashboot_SelectCommand(this);
+      }
+      if (this->result == Flashboot_eOK) {
+        this->Flashboot_State(this);
+      }
+      frame.payload.batchResult.results[frame.payload.batchResult.count++] =
+          this->result;
+      data += length;
+      size -= length;
+    }
+  }
+  this->batch = false;
+
+  if (this->result != Flashboot_eOK) {
+    this->Flashboot_State = State_Idle;
+  }
+
+  frame.payload.batchResult.result = this->result;
+  size = sizeof(frame.id) + sizeof(frame.payload.batchResult.result) +
+         sizeof(frame.payload.batchResult.count) +
+         frame.payload.batchResult.count *
+             sizeof(frame.payload.batchResult.results[0]);
+
+  /*Send response to the host*/
+  Flashboot_SendReply(this, &frame, size);
+}
@@ -10,11 +10,12 @@ void State_Boot(void *arg) {
   Flashboot_Context *this = (Flashboot_Context *)arg;
   uint64_t address = 0;
 
+  this->timing.state = Flashboot_StateBoot;
   this->result = Flashboot_eGeneralError;
   this->Flashboot_State = State_Idle;
 
   /* if an application header is available, if not return to Idle state*/
-  if (this->mbr.magicKey == MBR_MAGIC_KEY) {
+  if (MBR_IS_MAGIC_KEY(this->mbr.magicKey)) {
     /*Calculate the application fist address*/
     address = (uint64_t)this->mbr.loadAddress;
     this->result = Flashboot_eOK;
@@ -26,7 +27,7 @@ void State_Boot(void *arg) {
 
   if (this->result == Flashboot_eOK) {
     /*Enable flash projection*/
-    this->interface->ProtectMem(this->arg, true);
+    Flashboot_ProtectMem(this, this->progMem, true);
     this->interface->Boot(this->arg, address);
   }
 }
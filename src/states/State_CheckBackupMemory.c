@@ -9,14 +9,23 @@
 void State_CheckBackupMemory(void *arg) {
   Flashboot_Context *this = (Flashboot_Context *)arg;
 
+  this->timing.state = Flashboot_StateCheckBackupMemory;
+
   this->Flashboot_State = State_Idle;
 
-  if (this->backupMem) {
-    /*Look for a valid application MBR*/
-    if (Flashboot_SearchForMBR(this, this->backupMem, &this->mbr) ==
-        Flashboot_eOK) {
-      if (Flashboot_CopyToMemory(this, this->progMem, &this->mbr) ==
-          Flashboot_eOK) {
+  /*The generations are tried from the newest to the oldest*/
+  for (uint8_t age = 0; this->backupMem && age < this->generations.count &&
+                        this->Flashboot_State == State_Idle;
+       age++) {
+    /*Look for a valid application MBR, the components it lists are kept
+     * outside the backup and shall be valid already*/
+    if (Flashboot_ReadGeneration(this, age, &this->mbr) == Flashboot_eOK &&
+        Flashboot_CheckComponents(this, &this->mbr) == Flashboot_eOK) {
+      /*The corrupted blocks are repaired if the program memory keeps the
+       * same application, otherwise it's copied as a whole*/
+      if (Flashboot_RepairBlocks(this, &this->mbr) == Flashboot_eOK ||
+          Flashboot_CopyToMemory(this, this->progMem, &this->mbr) ==
+              Flashboot_eOK) {
         this->Flashboot_State = State_CheckProgramMemory;
       }
     }
@@ -9,22 +9,24 @@
 
 void State_CheckCRC(void *arg) {
   Flashboot_Context *this = (Flashboot_Context *)arg;
-  uint64_t address = 0;
+
+  this->timing.state = Flashboot_StateCheckCRC;
 
   this->Flashboot_State = State_Idle;
 
   /* if an application header is available, if not return to Idle state*/
-  if (this->mbr.magicKey == MBR_MAGIC_KEY) {
-    /*Calculate the application fist address*/
-    address = (uint64_t)this->mbr.loadAddress;
-
-    /*Calculate the application CRC*/
-    uint32_t crc = Flashboot_CalcCRC(this, address, this->mbr.size);
+  if (MBR_IS_MAGIC_KEY(this->mbr.magicKey)) {
+    /*Check the application as the verification policy selects*/
+    Flashboot_eResult result = Flashboot_VerifyImage(this, &this->mbr);
 
-    /* Check if CRC is valid, if not return to Idle state*/
-    if (this->mbr.crc == crc) {
+    /* Check if CRC is valid, and the components of a multi-image update, if
+     * not recover the application from the backup*/
+    if (result == Flashboot_eOK &&
+        Flashboot_CheckComponents(this, &this->mbr) == Flashboot_eOK) {
       /*Perform backup before boot*/
       this->Flashboot_State = State_BackupFW;
+    } else if (this->backupMem) {
+      this->Flashboot_State = State_CheckBackupMemory;
     }
   }
 }
@@ -9,6 +9,8 @@
 void State_CheckDataMemory(void *arg) {
   Flashboot_Context *this = (Flashboot_Context *)arg;
 
+  this->timing.state = Flashboot_StateCheckDataMemory;
+
   this->Flashboot_State = State_CheckProgramMemory;
 
   /*Look for a valid application MBR*/
@@ -20,7 +22,9 @@ void State_CheckDataMemory(void *arg) {
     if (crc == this->mbr.crc &&
         Flashboot_CopyToMemory(this, this->progMem, &this->mbr) ==
             Flashboot_eOK) {
-      Flashboot_MemoryErase(this, this->mbr.mbrAddress, sizeof(this->mbr));
+      /*The MBR shall be cleared, otherwise the copy is repeated on every
+       * boot*/
+      this->result = Flashboot_InvalidateMBR(this, this->mbr.mbrAddress);
       this->Flashboot_State = State_CheckProgramMemory;
     }
   }
@@ -9,8 +9,19 @@
 void State_CheckProgramMemory(void *arg) {
   Flashboot_Context *this = (Flashboot_Context *)arg;
 
+  this->timing.state = Flashboot_StateCheckProgramMemory;
+
   this->Flashboot_State = State_CheckBackupMemory;
 
+  /*In A/B mode the slot is selected checked already, as the verification
+   * policy selects*/
+  if (this->slots.record) {
+    if (Flashboot_SelectSlot(this) == Flashboot_eOK) {
+      this->Flashboot_State = this->commandMode ? State_Idle : State_BackupFW;
+    }
+    return;
+  }
+
   /*Look for a valid application MBR*/
   if (Flashboot_SearchForMBR(this, this->progMem, &this->mbr) ==
       Flashboot_eOK) {
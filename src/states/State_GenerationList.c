@@ -0,0 +1,49 @@
+// Copyright Douglas Santos Reis.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "Flashboot_States.h"
+#include "Flashboot_Types.h"
+#include <Helper.h>
+
+void State_GenerationList(void *arg) {
+  Flashboot_Context *this = (Flashboot_Context *)arg;
+  Flashboot_Frame frame;
+  uint32_t size;
+
+  this->timing.state = Flashboot_StateGenerationList;
+  frame.id = Flashboot_Result;
+  frame.payload.generationListResult.count = 0;
+  this->result = this->backupMem ? Flashboot_eOK : Flashboot_eBadInputError;
+
+  /*A generation without an image is replied with size 0*/
+  for (uint8_t age = 0; this->result == Flashboot_eOK &&
+                        age < this->generations.count;
+       age++) {
+    Flashboot_MBR mbr;
+
+    if (Flashboot_ReadGeneration(this, age, &mbr) != Flashboot_eOK) {
+      memset(&mbr, 0, sizeof(mbr));
+    }
+    FLASHBOOT_U32_TO_ARRAY(
+        mbr.version,
+        frame.payload.generationListResult.generation[age].version);
+    FLASHBOOT_U64_TO_ARRAY(
+        mbr.size, frame.payload.generationListResult.generation[age].size);
+    FLASHBOOT_U32_TO_ARRAY(
+        mbr.crc, frame.payload.generationListResult.generation[age].crc);
+    frame.payload.generationListResult.count++;
+  }
+
+  frame.payload.generationListResult.result = this->result;
+  size = sizeof(frame.id) + sizeof(frame.payload.generationListResult.result) +
+         sizeof(frame.payload.generationListResult.count) +
+         frame.payload.generationListResult.count *
+             sizeof(frame.payload.generationListResult.generation[0]);
+
+  /*Send response to the host*/
+  Flashboot_SendReply(this, &frame, size);
+
+  /*Return to Idle state to wait the next command*/
+  this->Flashboot_State = State_Idle;
+}
@@ -0,0 +1,31 @@
+// Copyright Douglas Santos Reis.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "Flashboot_States.h"
+#include "Flashboot_Types.h"
+#include <Helper.h>
+
+void State_GenerationRestore(void *arg) {
+  Flashboot_Context *this = (Flashboot_Context *)arg;
+  uint32_t size = sizeof(this->frame->id) +
+                  sizeof(this->frame->payload.generationRestore);
+
+  this->timing.state = Flashboot_StateGenerationRestore;
+  this->result = Flashboot_eProtocolError;
+  if (this->frameSize >= size) {
+    Flashboot_CopyGeneration(this, this->frame->payload.generationRestore.age);
+  }
+
+  Flashboot_Frame *frame = (Flashboot_Frame *)this->workBuffer;
+
+  frame->id = Flashboot_Result;
+  frame->payload.Result.result = this->result;
+  size = sizeof(frame->id) + sizeof(frame->payload.Result);
+
+  /*Send response to the host*/
+  Flashboot_SendReply(this, frame, size);
+
+  /*Return to Idle state to wait the next command*/
+  this->Flashboot_State = State_Idle;
+}
@@ -0,0 +1,52 @@
+// Copyright Douglas Santos Reis.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "Flashboot_States.h"
+#include "Flashboot_Types.h"
+#include <Helper.h>
+
+void State_GetStats(void *arg) {
+  Flashboot_Context *this = (Flashboot_Context *)arg;
+  const Flashboot_Stats *stats = &this->stats;
+  Flashboot_Frame frame;
+  uint32_t size;
+
+  this->timing.state = Flashboot_StateGetStats;
+  frame.id = Flashboot_Result;
+  frame.payload.statsResult.result = this->result = Flashboot_eOK;
+  FLASHBOOT_U64_TO_ARRAY(stats->bytesRead,
+                         frame.payload.statsResult.bytesRead);
+  FLASHBOOT_U32_TO_ARRAY(stats->pagesWritten,
+                         frame.payload.statsResult.pagesWritten);
+  FLASHBOOT_U32_TO_ARRAY(stats->sectorsErased,
+                         frame.payload.statsResult.sectorsErased);
+  FLASHBOOT_U32_TO_ARRAY(stats->erasesSkipped,
+                         frame.payload.statsResult.erasesSkipped);
+  FLASHBOOT_U64_TO_ARRAY(stats->crcBytes, frame.payload.statsResult.crcBytes);
+  FLASHBOOT_U32_TO_ARRAY(stats->mbrProbes,
+                         frame.payload.statsResult.mbrProbes);
+  FLASHBOOT_U32_TO_ARRAY(stats->retransmits,
+                         frame.payload.statsResult.retransmits);
+
+  frame.payload.statsResult.states = Flashboot_StateCount;
+  for (uint8_t i = 0; i < Flashboot_StateCount; i++) {
+    FLASHBOOT_U32_TO_ARRAY(stats->stateTime[i],
+                           frame.payload.statsResult.stateTime[i]);
+  }
+  size = sizeof(frame.id) + sizeof(frame.payload.statsResult) -
+         sizeof(frame.payload.statsResult.stateTime) +
+         Flashboot_StateCount * sizeof(frame.payload.statsResult.stateTime[0]);
+
+  /*The counters start again from the reply, for the next update*/
+  if (this->frameSize > sizeof(frame.id) &&
+      this->frame->payload.getStats.reset) {
+    memset(&this->stats, 0, sizeof(this->stats));
+  }
+
+  /*Send response to the host*/
+  Flashboot_SendReply(this, &frame, size);
+
+  /*Return to Idle state to wait the next command*/
+  this->Flashboot_State = State_Idle;
+}
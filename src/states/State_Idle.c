@@ -10,6 +10,8 @@
 void State_Idle(void *arg) {
   Flashboot_Context *this = (Flashboot_Context *)arg;
 
+  this->timing.state = Flashboot_StateIdle;
+
   /*Check If there's a command to process*/
   this->interface->CheckData(this->arg);
 
@@ -0,0 +1,74 @@
+// Copyright Douglas Santos Reis.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "Flashboot_States.h"
+#include "Flashboot_Types.h"
+#include <Helper.h>
+
+void State_RangeCRC(void *arg) {
+  Flashboot_Context *this = (Flashboot_Context *)arg;
+  uint8_t count = this->frame->payload.rangeCRC.count;
+  uint32_t size = sizeof(this->frame->id) +
+                  sizeof(this->frame->payload.rangeCRC.count) +
+                  count * sizeof(this->frame->payload.rangeCRC.range[0]);
+  Flashboot_Frame frame;
+  uint32_t capacity = sizeof(frame.payload.rangeCRCResult.crc) /
+                      sizeof(frame.payload.rangeCRCResult.crc[0]);
+
+  this->timing.state = Flashboot_StateRangeCRC;
+  frame.id = Flashboot_Result;
+  frame.payload.rangeCRCResult.count = 0;
+
+  this->result = Flashboot_eProtocolError;
+  if (this->frameSize >= size &&
+      count <= sizeof(this->frame->payload.rangeCRC.range) /
+                   sizeof(this->frame->payload.rangeCRC.range[0])) {
+    this->result = Flashboot_eOK;
+  }
+
+  for (uint8_t i = 0; this->result == Flashboot_eOK && i < count; i++) {
+    uint64_t address =
+        FLASHBOOT_ARRAY_TO_U64(this->frame->payload.rangeCRC.range[i].address);
+    uint64_t length =
+        FLASHBOOT_ARRAY_TO_U64(this->frame->payload.rangeCRC.range[i].size);
+    uint64_t blockSize = FLASHBOOT_ARRAY_TO_U32(
+        this->frame->payload.rangeCRC.range[i].blockSize);
+    blockSize = (blockSize == 0 || blockSize > length) ? length : blockSize;
+
+    /*The range shall be inside a memory known by the loader*/
+    if (Flashboot_GetMemory(this, address, length) == NULL) {
+      this->result = Flashboot_eAddressOutOfBoundsError;
+    }
+
+    /*The CRC of each block shall fit in the reply*/
+    if (blockSize && (length + blockSize - 1) / blockSize >
+                         capacity - frame.payload.rangeCRCResult.count) {
+      this->result = Flashboot_eBufferOverflowError;
+    }
+
+    while (this->result == Flashboot_eOK && length) {
+      uint64_t min = length > blockSize ? blockSize : length;
+      uint32_t crc = Flashboot_CalcCRC(this, address, min);
+
+      FLASHBOOT_U32_TO_ARRAY(
+          crc,
+          frame.payload.rangeCRCResult.crc[frame.payload.rangeCRCResult.count]);
+      frame.payload.rangeCRCResult.count++;
+      address += min;
+      length -= min;
+    }
+  }
+
+  frame.payload.rangeCRCResult.result = this->result;
+  size = sizeof(frame.id) + sizeof(frame.payload.rangeCRCResult.result) +
+         sizeof(frame.payload.rangeCRCResult.count) +
+         frame.payload.rangeCRCResult.count *
+             sizeof(frame.payload.rangeCRCResult.crc[0]);
+
+  /*Send response to the host*/
+  Flashboot_SendReply(this, &frame, size);
+
+  /*Return to Idle state to wait the next command*/
+  this->Flashboot_State = State_Idle;
+}
@@ -0,0 +1,37 @@
+// Copyright Douglas Santos Reis.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "Flashboot_States.h"
+#include "Flashboot_Types.h"
+#include <Helper.h>
+
+void State_ReadAck(void *arg) {
+  Flashboot_Context *this = (Flashboot_Context *)arg;
+  uint16_t ackID =
+      FLASHBOOT_ARRAY_TO_U16(this->frame->payload.readAck.packetID) + 1;
+
+  uint16_t acked = ackID - this->read.ackID;
+
+  this->timing.state = Flashboot_StateReadAck;
+
+  /*Only packets already sent can be acknowledged*/
+  if (acked != 0 &&
+      acked <= (uint16_t)(this->read.packetID - this->read.ackID)) {
+    uint64_t address =
+        this->read.ackAddress + (uint64_t)acked * this->read.slice;
+
+    this->read.ackID = ackID;
+    this->read.ackAddress =
+        address < this->read.endAddress ? address : this->read.endAddress;
+  } else {
+    /*A stale or repeated acknowledge means the host lost the packet after
+     * it, the stream goes back to it*/
+    this->read.packetID = this->read.ackID;
+    this->read.currentAddress = this->read.ackAddress;
+  }
+
+  /*Resume the stream, a new window is available*/
+  this->result = Flashboot_eOK;
+  this->Flashboot_State = State_ReadStream;
+}
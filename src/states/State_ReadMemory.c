@@ -0,0 +1,53 @@
+// Copyright Douglas Santos Reis.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "Flashboot_States.h"
+#include "Flashboot_Types.h"
+#include <Helper.h>
+
+void State_ReadMemory(void *arg) {
+  Flashboot_Context *this = (Flashboot_Context *)arg;
+  uint64_t address =
+      FLASHBOOT_ARRAY_TO_U64(this->frame->payload.readMemory.address);
+  uint64_t size = FLASHBOOT_ARRAY_TO_U64(this->frame->payload.readMemory.size);
+
+  this->timing.state = Flashboot_StateReadMemory;
+  this->Flashboot_State = State_Idle;
+  this->result = Flashboot_eAddressOutOfBoundsError;
+
+  /*The range shall be inside a memory known by the loader*/
+  if (Flashboot_GetMemory(this, address, size)) {
+    Flashboot_Frame *frame = (Flashboot_Frame *)this->workBuffer;
+    uint32_t header = sizeof(frame->id) +
+                      sizeof(frame->payload.readData.packetID) +
+                      sizeof(frame->payload.readData.offset) +
+                      sizeof(frame->payload.readData.crc);
+
+    this->read.startAddress = this->read.currentAddress = address;
+    this->read.ackAddress = address;
+    this->read.slice = sizeof(frame->payload.readData.packet);
+    this->read.slice =
+        this->wbs - header < this->read.slice ? this->wbs - header
+                                               : this->read.slice;
+    this->read.endAddress = address + size;
+    this->read.packetID = this->read.ackID = 0;
+    this->read.window = this->frame->payload.readMemory.window
+                            ? this->frame->payload.readMemory.window
+                            : 1;
+    this->result = Flashboot_eOK;
+
+    /*The slices are the reply*/
+    this->Flashboot_State = State_ReadStream;
+    return;
+  }
+
+  Flashboot_Frame *frame = (Flashboot_Frame *)this->workBuffer;
+
+  frame->id = Flashboot_Result;
+  frame->payload.Result.result = this->result;
+  size = sizeof(frame->id) + sizeof(frame->payload.Result);
+
+  /*Send response to the host*/
+  Flashboot_SendReply(this, frame, size);
+}
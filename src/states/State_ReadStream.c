@@ -0,0 +1,50 @@
+// Copyright Douglas Santos Reis.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "Flashboot_States.h"
+#include "Flashboot_Types.h"
+#include <Helper.h>
+
+void State_ReadStream(void *arg) {
+  Flashboot_Context *this = (Flashboot_Context *)arg;
+  Flashboot_Frame *frame = (Flashboot_Frame *)this->workBuffer;
+  uint32_t header = sizeof(frame->id) +
+                    sizeof(frame->payload.readData.packetID) +
+                    sizeof(frame->payload.readData.offset) +
+                    sizeof(frame->payload.readData.crc);
+  uint32_t size = this->read.slice;
+
+  this->timing.state = Flashboot_StateReadStream;
+  this->result = Flashboot_eOK;
+
+  /*Wait for the host when the whole window is in flight or everything was
+   * sent*/
+  if ((uint16_t)(this->read.packetID - this->read.ackID) >= this->read.window ||
+      this->read.currentAddress >= this->read.endAddress) {
+    this->Flashboot_State = State_Idle;
+    return;
+  }
+
+  size = this->read.endAddress - this->read.currentAddress < size
+             ? this->read.endAddress - this->read.currentAddress
+             : size;
+
+  /*Read the slice straight into the frame to be sent*/
+  Flashboot_ReadMem(this, this->read.currentAddress,
+                    frame->payload.readData.packet, size);
+
+  frame->id = Flashboot_ReadData;
+  FLASHBOOT_U16_TO_ARRAY(this->read.packetID, frame->payload.readData.packetID);
+  uint64_t offset = this->read.currentAddress - this->read.startAddress;
+  FLASHBOOT_U64_TO_ARRAY(offset, frame->payload.readData.offset);
+  uint32_t crc =
+      Flashboot_DataCRC(this, 0, frame->payload.readData.packet, size);
+  FLASHBOOT_U32_TO_ARRAY(crc, frame->payload.readData.crc);
+
+  /*Send the slice to the host*/
+  Flashboot_SendReply(this, frame, header + size);
+
+  this->read.currentAddress += size;
+  this->read.packetID++;
+}
@@ -0,0 +1,42 @@
+// Copyright Douglas Santos Reis.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "Flashboot_States.h"
+#include "Flashboot_Types.h"
+#include <Helper.h>
+
+void State_UpdateFill(void *arg) {
+  Flashboot_Context *this = (Flashboot_Context *)arg;
+
+  this->timing.state = Flashboot_StateUpdateFill;
+
+  uint64_t offset =
+      FLASHBOOT_ARRAY_TO_U64(this->frame->payload.updateFill.offset);
+  uint64_t length =
+      FLASHBOOT_ARRAY_TO_U64(this->frame->payload.updateFill.size);
+
+  if (this->manifest.count) {
+    Flashboot_ManifestWrite(this, offset, NULL, length,
+                            this->frame->payload.updateFill.value);
+  } else {
+    Flashboot_FlashFill(this, offset, length,
+                        this->frame->payload.updateFill.value);
+  }
+
+  if (this->result == Flashboot_eRetransmitRequest) {
+    this->stats.retransmits++;
+  }
+
+  Flashboot_Frame *frame = (Flashboot_Frame *)this->workBuffer;
+
+  frame->id = Flashboot_Result;
+  frame->payload.Result.result = this->result;
+  uint32_t size = sizeof(frame->id) + sizeof(frame->payload.Result);
+
+  /*Send response to the host*/
+  Flashboot_SendReply(this, frame, size);
+
+  /*Return to Idle state to wait the next command*/
+  this->Flashboot_State = State_Idle;
+}
@@ -9,9 +9,16 @@
 void State_UpdateFinish(void *arg) {
   Flashboot_Context *this = (Flashboot_Context *)arg;
 
-  Flashboot_FlashFinish(
-      this, FLASHBOOT_ARRAY_TO_U32(this->frame->payload.updateFinish.crc),
-      0000);
+  this->timing.state = Flashboot_StateUpdateFinish;
+
+  /*The CRCs and versions of a multi-image update came with its manifest*/
+  if (this->manifest.count) {
+    Flashboot_ManifestFinish(this);
+  } else {
+    Flashboot_FlashFinish(
+        this, FLASHBOOT_ARRAY_TO_U32(this->frame->payload.updateFinish.crc),
+        0000);
+  }
 
   Flashboot_Frame *frame = (Flashboot_Frame *)this->workBuffer;
 
@@ -20,7 +27,7 @@ void State_UpdateFinish(void *arg) {
   uint32_t size = sizeof(frame->id) + sizeof(frame->payload.Result);
 
   /*Send response to the host*/
-  this->interface->SendData(this->arg, (uint8_t *)frame, size);
+  Flashboot_SendReply(this, frame, size);
 
   /*Return to Idle state to wait the next command*/
   this->Flashboot_State = State_Idle;
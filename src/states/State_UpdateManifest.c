@@ -0,0 +1,48 @@
+// Copyright Douglas Santos Reis.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "Flashboot_States.h"
+#include "Flashboot_Types.h"
+#include <Helper.h>
+
+void State_UpdateManifest(void *arg) {
+  Flashboot_Context *this = (Flashboot_Context *)arg;
+  uint8_t count = this->frame->payload.updateManifest.count;
+  uint32_t size = sizeof(this->frame->id) +
+                  sizeof(this->frame->payload.updateManifest.count) +
+                  count * sizeof(this->frame->payload.updateManifest.image[0]);
+
+  this->timing.state = Flashboot_StateUpdateManifest;
+  this->result = Flashboot_eProtocolError;
+  this->manifest.count = 0;
+
+  if (this->frameSize >= size && count <= FLASHBOOT_MAX_IMAGES) {
+    for (uint8_t i = 0; i < count; i++) {
+      this->manifest.image[i] = (Flashboot_Image){
+          .address = FLASHBOOT_ARRAY_TO_U64(
+              this->frame->payload.updateManifest.image[i].address),
+          .size = FLASHBOOT_ARRAY_TO_U64(
+              this->frame->payload.updateManifest.image[i].size),
+          .crc = FLASHBOOT_ARRAY_TO_U32(
+              this->frame->payload.updateManifest.image[i].crc),
+          .version = FLASHBOOT_ARRAY_TO_U32(
+              this->frame->payload.updateManifest.image[i].version),
+      };
+    }
+    this->manifest.count = count;
+    Flashboot_ManifestStart(this);
+  }
+
+  Flashboot_Frame *frame = (Flashboot_Frame *)this->workBuffer;
+
+  frame->id = Flashboot_Result;
+  frame->payload.Result.result = this->result;
+  size = sizeof(frame->id) + sizeof(frame->payload.Result);
+
+  /*Send response to the host*/
+  Flashboot_SendReply(this, frame, size);
+
+  /*Return to Idle state to wait the next command*/
+  this->Flashboot_State = State_Idle;
+}
@@ -0,0 +1,40 @@
+// Copyright Douglas Santos Reis.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "Flashboot_States.h"
+#include "Flashboot_Types.h"
+#include <Helper.h>
+
+void State_UpdateResume(void *arg) {
+  Flashboot_Context *this = (Flashboot_Context *)arg;
+  uint64_t offset = 0;
+  uint32_t crc = 0;
+
+  this->timing.state = Flashboot_StateUpdateResume;
+  this->result = Flashboot_FlashResume(
+      this, Flashboot_UpdateTarget(this, this->progMem),
+      FLASHBOOT_ARRAY_TO_U64(this->frame->payload.updateResume.startAddress),
+      FLASHBOOT_ARRAY_TO_U64(this->frame->payload.updateResume.size),
+      FLASHBOOT_ARRAY_TO_U32(this->frame->payload.updateResume.version), 0);
+
+  /*The host continues from the offset after checking the CRC up to it*/
+  if (this->result == Flashboot_eOK) {
+    offset = this->update.currentAddress - this->update.startAddress;
+    crc = this->journal.entry.committedCRC;
+  }
+
+  Flashboot_Frame *frame = (Flashboot_Frame *)this->workBuffer;
+
+  frame->id = Flashboot_Result;
+  frame->payload.updateResumeResult.result = this->result;
+  FLASHBOOT_U64_TO_ARRAY(offset, frame->payload.updateResumeResult.offset);
+  FLASHBOOT_U32_TO_ARRAY(crc, frame->payload.updateResumeResult.crc);
+  uint32_t size = sizeof(frame->id) + sizeof(frame->payload.updateResumeResult);
+
+  /*Send response to the host*/
+  Flashboot_SendReply(this, frame, size);
+
+  /*Return to Idle state to wait the next command*/
+  this->Flashboot_State = State_Idle;
+}
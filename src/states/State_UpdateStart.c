@@ -5,14 +5,33 @@
 #include "Flashboot_States.h"
 #include "Flashboot_Types.h"
 #include <Helper.h>
+#include <stddef.h>
 
 void State_UpdateStart(void *arg) {
   Flashboot_Context *this = (Flashboot_Context *)arg;
 
+  this->timing.state = Flashboot_StateUpdateStart;
+
+  uint32_t version = 0, blockSize = 0;
+
+  /*The version is optional, it identifies the update to be resumed*/
+  if (this->frameSize >=
+      offsetof(Flashboot_Frame, payload.updateStart.blockSize)) {
+    version = FLASHBOOT_ARRAY_TO_U32(this->frame->payload.updateStart.version);
+  }
+
+  /*The block size is optional too, a differential update keeps the memory*/
+  if (this->frameSize >=
+      sizeof(this->frame->id) + sizeof(this->frame->payload.updateStart)) {
+    blockSize =
+        FLASHBOOT_ARRAY_TO_U32(this->frame->payload.updateStart.blockSize);
+  }
+
   this->result = Flashboot_FlashStart(
-      this, this->progMem,
-      FLASHBOOT_ARRAY_TO_U32(this->frame->payload.updateStart.startAddress),
-      FLASHBOOT_ARRAY_TO_U32(this->frame->payload.updateStart.size));
+      this, Flashboot_UpdateTarget(this, this->progMem),
+      FLASHBOOT_ARRAY_TO_U64(this->frame->payload.updateStart.startAddress),
+      FLASHBOOT_ARRAY_TO_U64(this->frame->payload.updateStart.size), version,
+      0, blockSize);
 
   Flashboot_Frame *frame = (Flashboot_Frame *)this->workBuffer;
 
@@ -21,7 +40,7 @@ void State_UpdateStart(void *arg) {
   uint32_t size = sizeof(frame->id) + sizeof(frame->payload.Result);
 
   /*Send response to the host*/
-  this->interface->SendData(this->arg, (uint8_t *)frame, size);
+  Flashboot_SendReply(this, frame, size);
 
   /*Return to Idle state to wait the next command*/
   this->Flashboot_State = State_Idle;
@@ -8,21 +8,49 @@
 
 void State_UpdateTransfer(void *arg) {
   Flashboot_Context *this = (Flashboot_Context *)arg;
-
-  /*Calculate the packet size*/
-  uint32_t size = this->frameSize - sizeof(this->frame->id) -
-                  sizeof(this->frame->payload.updateTransfer.packetID);
-
-  Flashboot_FlashWrite(this, this->frame->payload.updateTransfer.packet, size);
+  uint32_t header = sizeof(this->frame->id) +
+                    sizeof(this->frame->payload.updateTransfer.packetID) +
+                    sizeof(this->frame->payload.updateTransfer.offset) +
+                    sizeof(this->frame->payload.updateTransfer.crc);
+
+  this->timing.state = Flashboot_StateUpdateTransfer;
+  this->result = Flashboot_eProtocolError;
+
+  if (this->frameSize >= header) {
+    /*Calculate the packet size*/
+    uint32_t size = this->frameSize - header;
+    uint64_t offset =
+        FLASHBOOT_ARRAY_TO_U64(this->frame->payload.updateTransfer.offset);
+    uint32_t crc =
+        FLASHBOOT_ARRAY_TO_U32(this->frame->payload.updateTransfer.crc);
+
+    /*A packet corrupted in the link is not written, the host shall resend it*/
+    this->result = Flashboot_eRetransmitRequest;
+    if (Flashboot_DataCRC(this, 0, this->frame->payload.updateTransfer.packet,
+                          size) == crc) {
+      if (this->manifest.count) {
+        Flashboot_ManifestWrite(this, offset,
+                                this->frame->payload.updateTransfer.packet,
+                                size, 0);
+      } else {
+        Flashboot_FlashWriteAt(
+            this, offset, this->frame->payload.updateTransfer.packet, size);
+      }
+    }
+  }
+
+  if (this->result == Flashboot_eRetransmitRequest) {
+    this->stats.retransmits++;
+  }
 
   Flashboot_Frame *frame = (Flashboot_Frame *)this->workBuffer;
 
   frame->id = Flashboot_Result;
   frame->payload.Result.result = this->result;
-  size = sizeof(frame->id) + sizeof(frame->payload.Result);
+  uint32_t size = sizeof(frame->id) + sizeof(frame->payload.Result);
 
   /*Send response to the host*/
-  this->interface->SendData(this->arg, (uint8_t *)frame, size);
+  Flashboot_SendReply(this, frame, size);
 
   /*Return to Idle state to wait the next command*/
   this->Flashboot_State = State_Idle;
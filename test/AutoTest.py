@@ -87,6 +87,18 @@ def main(args):
             ],
         )
     )
+    testList.append(
+        TestFeature(
+            name="Bootloader unaligned packets",
+            scenario=[
+                TestScenario(
+                    cmd="ProgramMemoryLoad",
+                    input="FW_unaligned.txt",
+                    expected="FW_1_Ok.txt",
+                )
+            ],
+        )
+    )
     testList.append(
         TestFeature(
             name="Bootloader overflow error",
@@ -143,6 +155,287 @@ def main(args):
             ],
         )
     )
+    testList.append(
+        TestFeature(
+            name="Protocol retransmission",
+            scenario=[
+                TestScenario(
+                    cmd="ProtocolRetransmit",
+                    input="FW_1.txt",
+                    expected="ProtocolRetransmit_OK.txt",
+                )
+            ],
+        )
+    )
+    testList.append(
+        TestFeature(
+            name="Protocol differential update",
+            scenario=[
+                TestScenario(
+                    cmd="ProtocolDeltaLoad",
+                    input="FW_1.txt",
+                    expected="ProtocolDelta_OK.txt",
+                )
+            ],
+        )
+    )
+    testList.append(
+        TestFeature(
+            name="Protocol sparse image",
+            scenario=[
+                TestScenario(
+                    cmd="ProtocolSparseLoad",
+                    input="FW_sparse.txt",
+                    expected="ProtocolSparse_OK.txt",
+                )
+            ],
+        )
+    )
+    testList.append(
+        TestFeature(
+            name="Protocol memory read back",
+            scenario=[
+                TestScenario(
+                    cmd="ProtocolReadBack",
+                    input="FW_1.txt",
+                    expected="ProtocolReadBack_OK.txt",
+                ),
+                TestScenario(
+                    cmd="ProtocolReadBackLoss",
+                    input="FW_1.txt",
+                    expected="ProtocolReadBackLoss_OK.txt",
+                ),
+            ],
+        )
+    )
+    testList.append(
+        TestFeature(
+            name="Protocol batched commands",
+            scenario=[
+                TestScenario(
+                    cmd="ProtocolBatch",
+                    input="FW_1.txt",
+                    expected="ProtocolBatch_OK.txt",
+                )
+            ],
+        )
+    )
+    testList.append(
+        TestFeature(
+            name="Sector map with block erase",
+            scenario=[
+                TestScenario(
+                    cmd="SectorMapLoad",
+                    input="FW_1.txt",
+                    expected="SectorMap_OK.txt",
+                )
+            ],
+        )
+    )
+    testList.append(
+        TestFeature(
+            name="Work buffer smaller than a sector",
+            scenario=[
+                TestScenario(
+                    cmd="ScratchSectorLoad",
+                    input="FW_1.txt",
+                    expected="ScratchSector_OK.txt",
+                )
+            ],
+        )
+    )
+    testList.append(
+        TestFeature(
+            name="Bit-clear programming without erase",
+            scenario=[
+                TestScenario(
+                    cmd="BitClearLoad",
+                    input="FW_1.txt",
+                    expected="BitClear_OK.txt",
+                )
+            ],
+        )
+    )
+    testList.append(
+        TestFeature(
+            name="Erase-free memory written in blocks",
+            scenario=[
+                TestScenario(
+                    cmd="EraseFreeLoad",
+                    input="FW_1.txt",
+                    expected="EraseFree_OK.txt",
+                )
+            ],
+        )
+    )
+    testList.append(
+        TestFeature(
+            name="Backup through a memory driver",
+            scenario=[
+                TestScenario(
+                    cmd="MemoryDriverBackup",
+                    input="FW_1.txt",
+                    expected="MemoryDriver_OK.txt",
+                )
+            ],
+        )
+    )
+    testList.append(
+        TestFeature(
+            name="Multi-GB memory with 64 bits addresses",
+            scenario=[
+                TestScenario(
+                    cmd="LargeMemoryLoad",
+                    input="FW_1.txt",
+                    expected="LargeMemory_OK.txt",
+                )
+            ],
+        )
+    )
+    testList.append(
+        TestFeature(
+            name="A/B slots booted in place",
+            scenario=[
+                TestScenario(
+                    cmd="SlotsBoot",
+                    input="FW_1.txt",
+                    expected="SlotsBoot_OK.txt",
+                )
+            ],
+        )
+    )
+    testList.append(
+        TestFeature(
+            name="Update resumed after a power loss",
+            scenario=[
+                TestScenario(
+                    cmd="ProtocolResume",
+                    input="FW_1.txt",
+                    expected="ProtocolResume_OK.txt",
+                )
+            ],
+        )
+    )
+    testList.append(
+        TestFeature(
+            name="Update applied after a power loss",
+            scenario=[
+                TestScenario(
+                    cmd="CopyResume",
+                    input="FW_1.txt",
+                    expected="CopyResume_OK.txt",
+                )
+            ],
+        )
+    )
+    testList.append(
+        TestFeature(
+            name="Multi-image update with a manifest",
+            scenario=[
+                TestScenario(
+                    cmd="ManifestLoad",
+                    input="FW_1.txt",
+                    expected="ManifestLoad_OK.txt",
+                )
+            ],
+        )
+    )
+    testList.append(
+        TestFeature(
+            name="Backup refreshed sector by sector",
+            scenario=[
+                TestScenario(
+                    cmd="BackupRefresh",
+                    input="FW_1.txt",
+                    expected="BackupRefresh_OK.txt",
+                )
+            ],
+        )
+    )
+    testList.append(
+        TestFeature(
+            name="Corrupted blocks repaired from the backup",
+            scenario=[
+                TestScenario(
+                    cmd="BlockRepair",
+                    input="FW_1.txt",
+                    expected="BlockRepair_OK.txt",
+                )
+            ],
+        )
+    )
+    testList.append(
+        TestFeature(
+            name="Boot verification policies",
+            scenario=[
+                TestScenario(
+                    cmd="VerifyPolicy",
+                    input="FW_1.txt",
+                    expected="VerifyPolicy_OK.txt",
+                )
+            ],
+        )
+    )
+    testList.append(
+        TestFeature(
+            name="Backup generations listed and restored",
+            scenario=[
+                TestScenario(
+                    cmd="BackupGenerations",
+                    input="FW_1.txt",
+                    expected="BackupGenerations_OK.txt",
+                )
+            ],
+        )
+    )
+    testList.append(
+        TestFeature(
+            name="Host flasher pipelined update",
+            scenario=[
+                TestScenario(
+                    cmd="HostFlasher",
+                    input="FW_1.txt",
+                    expected="HostFlasher_OK.txt",
+                )
+            ],
+        )
+    )
+    testList.append(
+        TestFeature(
+            name="Update through a simulated link",
+            scenario=[
+                TestScenario(
+                    cmd="SimulatedLink",
+                    input="FW_1.txt",
+                    expected="SimulatedLink_OK.txt",
+                )
+            ],
+        )
+    )
+    testList.append(
+        TestFeature(
+            name="Flash cost model presets",
+            scenario=[
+                TestScenario(
+                    cmd="FlashCostModel",
+                    input="FW_1.txt",
+                    expected="FlashCostModel_OK.txt",
+                )
+            ],
+        )
+    )
+    testList.append(
+        TestFeature(
+            name="Operation counters and GetStats",
+            scenario=[
+                TestScenario(
+                    cmd="GetStats",
+                    input="FW_1.txt",
+                    expected="GetStats_OK.txt",
+                )
+            ],
+        )
+    )
 
     approved = True
     for test in testList:
@@ -211,8 +504,9 @@ class AutoTest:
                 logging.info("Failed to run: " + " ".join(args))
 
         logging.info(
-            "| Test case {}: {: <59} {:>8} |".format(
-                self.index, testFeature.name, "Approved" if result else "Failed"
+            "| {: <72} {:>8} |".format(
+                "Test case {}: {}".format(self.index, testFeature.name),
+                "Approved" if result else "Failed",
             )
         )
         logging.info("+{:->84}".format("+"))
@@ -5,6 +5,8 @@
 #ifndef TEST_SRC_CONFIG_H_
 #define TEST_SRC_CONFIG_H_
 
+#include <Flashboot_Types.h>
+#include <setjmp.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -18,8 +20,11 @@ void Bin2Hex(uint8_t *abHex, const uint8_t *abBin, uint32_t uiHexLen);
 void Hex2Bin(uint8_t *abBin, const uint8_t *abHex, uint32_t uiHexLen);
 
 uint32_t FlashWrite(void *arg, uint64_t address, uint8_t *data);
+uint32_t FlashWriteBlock(void *arg, uint64_t address, uint8_t *data,
+                         uint32_t size);
 uint32_t FlashRead(void *arg, uint64_t address, uint8_t *data, uint32_t size);
 uint32_t FlashErase(void *arg, uint64_t address);
+uint32_t FlashEraseBlock(void *arg, uint64_t address, uint32_t size);
 uint32_t FlashProtect(void *arg, bool lock);
 uint32_t CRCCalc(void *arg, uint32_t initValue, void *data, uint32_t size);
 uint32_t GetTick(void *);
@@ -34,5 +39,14 @@ void test_init(FILE *input, FILE *output, bool *running,
                uint64_t bakMemAddress, uint32_t bakMemSize);
 
 void test_finish();
+uint32_t test_reply(uint8_t *data);
+void test_flipBit(uint64_t address);
+void test_sectorMap(const Flashboot_Memory *memory);
+void test_eraseCount(uint32_t *sectors, uint32_t *blocks);
+void test_writeCount(uint32_t *pages, uint32_t *blocks);
+void test_readCount(uint64_t *bytes);
+void test_powerLoss(jmp_buf *env, uint32_t count);
+const Flashboot_MemoryDriver *test_fileMemory(uint64_t address, uint64_t size);
+void test_fileMemoryClose(void);
 
 #endif /* TEST_SRC_CONFIG_H_ */
@@ -3,9 +3,14 @@
 // SPDX-License-Identifier: Apache-2.0
 
 #include "config.h"
+#include "Device.h"
+#include "Flasher.h"
+#include "Link.h"
+#include "crc.h"
 #include <Flashboot.h>
 #include <Flashboot_Types.h>
 #include <assert.h>
+#include <inttypes.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -20,8 +25,10 @@ BootApp_Context appContext;
 
 static const Flashboot_Interface interface = {
     .WriteMemPage = FlashWrite,
+    .WriteMem = FlashWriteBlock,
     .ReadMem = FlashRead,
     .EraseMemSector = FlashErase,
+    .EraseMemBlock = FlashEraseBlock,
     .ProtectMem = FlashProtect,
     .CheckData = CheckData,
     .SendData = SendData,
@@ -50,11 +57,59 @@ typedef struct {
 int ProgramMemoryLoad(ClassTest *test, void *arg);
 int DataMemoryLoad(ClassTest *test, void *arg);
 int BackupMemoryLoad(ClassTest *test, void *arg);
+int ProtocolRetransmit(ClassTest *test, void *arg);
+int ProtocolDeltaLoad(ClassTest *test, void *arg);
+int ProtocolSparseLoad(ClassTest *test, void *arg);
+int ProtocolReadBack(ClassTest *test, void *arg);
+int ProtocolReadBackLoss(ClassTest *test, void *arg);
+int ProtocolBatch(ClassTest *test, void *arg);
+int SectorMapLoad(ClassTest *test, void *arg);
+int ScratchSectorLoad(ClassTest *test, void *arg);
+int BitClearLoad(ClassTest *test, void *arg);
+int EraseFreeLoad(ClassTest *test, void *arg);
+int MemoryDriverBackup(ClassTest *test, void *arg);
+int LargeMemoryLoad(ClassTest *test, void *arg);
+int SlotsBoot(ClassTest *test, void *arg);
+int ProtocolResume(ClassTest *test, void *arg);
+int CopyResume(ClassTest *test, void *arg);
+int ManifestLoad(ClassTest *test, void *arg);
+int BackupRefresh(ClassTest *test, void *arg);
+int BlockRepair(ClassTest *test, void *arg);
+int VerifyPolicy(ClassTest *test, void *arg);
+int BackupGenerations(ClassTest *test, void *arg);
+int HostFlasher(ClassTest *test, void *arg);
+int SimulatedLink(ClassTest *test, void *arg);
+int FlashCostModel(ClassTest *test, void *arg);
+int GetStats(ClassTest *test, void *arg);
 
 TestCase TestMap[] = {
     {"ProgramMemoryLoad", (Function)ProgramMemoryLoad},
     {"DataMemoryLoad", (Function)DataMemoryLoad},
     {"BackupMemoryLoad", (Function)BackupMemoryLoad},
+    {"ProtocolRetransmit", (Function)ProtocolRetransmit},
+    {"ProtocolDeltaLoad", (Function)ProtocolDeltaLoad},
+    {"ProtocolSparseLoad", (Function)ProtocolSparseLoad},
+    {"ProtocolReadBack", (Function)ProtocolReadBack},
+    {"ProtocolReadBackLoss", (Function)ProtocolReadBackLoss},
+    {"ProtocolBatch", (Function)ProtocolBatch},
+    {"SectorMapLoad", (Function)SectorMapLoad},
+    {"ScratchSectorLoad", (Function)ScratchSectorLoad},
+    {"BitClearLoad", (Function)BitClearLoad},
+    {"EraseFreeLoad", (Function)EraseFreeLoad},
+    {"MemoryDriverBackup", (Function)MemoryDriverBackup},
+    {"LargeMemoryLoad", (Function)LargeMemoryLoad},
+    {"SlotsBoot", (Function)SlotsBoot},
+    {"ProtocolResume", (Function)ProtocolResume},
+    {"CopyResume", (Function)CopyResume},
+    {"ManifestLoad", (Function)ManifestLoad},
+    {"BackupRefresh", (Function)BackupRefresh},
+    {"BlockRepair", (Function)BlockRepair},
+    {"VerifyPolicy", (Function)VerifyPolicy},
+    {"BackupGenerations", (Function)BackupGenerations},
+    {"HostFlasher", (Function)HostFlasher},
+    {"SimulatedLink", (Function)SimulatedLink},
+    {"FlashCostModel", (Function)FlashCostModel},
+    {"GetStats", (Function)GetStats},
 };
 
 int ProgramMemoryLoad(ClassTest *test, void *arg) {
@@ -301,6 +356,2431 @@ int BackupMemoryLoad(ClassTest *test, void *arg) {
   test_finish();
   return 0;
 }
+/*!
+ * Read a whole mock file into a binary image.
+ * @return The image size.
+ */
+static uint32_t LoadImage(FILE *input, uint64_t *addr, uint32_t *crc,
+                          uint32_t *version, uint8_t *image, uint32_t max) {
+  char hexData[128];
+  uint32_t size, imageSize = 0;
+
+  size_t res =
+      fscanf(input, "addr=%" SCNx64 "\nsize=%u\ncrc=%x\nversion=%x\n", addr,
+             &size, crc, version);
+  assert(res == 4);
+
+  while (fscanf(input, "%s\r\n", hexData) == 1 &&
+         (size = strlen(hexData)) > 0 && imageSize + size / 2 <= max) {
+    Hex2Bin(image + imageSize, (uint8_t *)hexData, size);
+    imageSize += size / 2;
+  }
+  return imageSize;
+}
+
+/*!
+ * Deliver a frame to the loader as if it arrived from the host and wait for
+ * the reply.
+ * @return The reply.
+ */
+static Flashboot_Frame SendFrame(Flashboot_Frame *frame, uint32_t size) {
+  BootApp_Context *obj = &appContext;
+  Flashboot_Frame reply = {.id = Flashboot_Result};
+
+  reply.payload.Result.result = Flashboot_ProcessProtocol(
+      &obj->loader, (uint8_t *)frame, size);
+  if (reply.payload.Result.result == Flashboot_eOK) {
+    /*A command may take a few states to reply*/
+    for (int i = 0; i < 4; i++) {
+      Flashboot_Execute(&obj->loader);
+      if (test_reply((uint8_t *)&reply)) {
+        break;
+      }
+    }
+  }
+  return reply;
+}
+
+static int8_t TransferPacket(uint64_t offset, const uint8_t *data,
+                             uint32_t size, bool corrupt) {
+  Flashboot_Frame frame = {.id = Flashboot_UpdateTransfer};
+  uint32_t header = sizeof(frame.id) +
+                    sizeof(frame.payload.updateTransfer.packetID) +
+                    sizeof(frame.payload.updateTransfer.offset) +
+                    sizeof(frame.payload.updateTransfer.crc);
+
+  FLASHBOOT_U16_TO_ARRAY(offset / PACKET_SIZE,
+                         frame.payload.updateTransfer.packetID);
+  FLASHBOOT_U64_TO_ARRAY(offset, frame.payload.updateTransfer.offset);
+  FLASHBOOT_U32_TO_ARRAY(crc32(data, size, 0),
+                         frame.payload.updateTransfer.crc);
+  memcpy(frame.payload.updateTransfer.packet, data, size);
+
+  /*Noise in the link*/
+  if (corrupt) {
+    frame.payload.updateTransfer.packet[size / 2] ^= 0x10;
+  }
+
+  return SendFrame(&frame, header + size).payload.Result.result;
+}
+
+/*!
+ * Finish the update through the protocol and boot the new application.
+ */
+static void FinishAndBoot(ClassTest *test, uint32_t crc, uint32_t version) {
+  BootApp_Context *obj = &appContext;
+  Flashboot_Frame frame = {.id = Flashboot_UpdateFinish};
+  Flashboot_eResult ret;
+
+  FLASHBOOT_U32_TO_ARRAY(crc, frame.payload.updateFinish.crc);
+  FLASHBOOT_U32_TO_ARRAY(version, frame.payload.updateFinish.version);
+  ret = SendFrame(&frame, sizeof(frame.id) + sizeof(frame.payload.updateFinish))
+            .payload.Result.result;
+  if (ret == Flashboot_eOK) {
+    ret = Flashboot_Boot(&obj->loader);
+    SetError(0, ret);
+
+    while (test->running && ret == Flashboot_eOK) {
+      ret = Flashboot_Execute(&obj->loader);
+      SetError(0, ret);
+    }
+  }
+}
+
+int ProtocolRetransmit(ClassTest *test, void *arg) {
+  BootApp_Context *obj = &appContext;
+  enum { kRangeSize = 1024 };
+
+  Flashboot_Memory progMemory = {
+      .startAddress = 0x08004000, // Complete memory size
+      .size = 20 * 1024,          // Complete memory size
+      .pageSize = PAGE_SIZE,      // Minimum writable block
+      .sectorSize = SECTOR_SIZE,  // Minimum erasable block
+  };
+
+  test_init(test->inputFile, test->outputFile, &test->running,
+            progMemory.startAddress, progMemory.size, 0, 0, 0, 0);
+
+  /*Init loader library*/
+  Flashboot_eResult ret =
+      Flashboot_Initialize(&obj->loader, obj, &interface, &progMemory,
+                           obj->workbuffer, sizeof(obj->workbuffer));
+
+  if (ret != Flashboot_eOK) {
+    return 0;
+  }
+  test->running = true;
+
+  static uint8_t image[20 * 1024];
+  uint32_t crc, version, offset, size;
+  uint64_t addr = 0;
+  bool retry = false;
+
+  size = LoadImage(test->inputFile, &addr, &crc, &version, image,
+                   sizeof(image));
+  ret = Flashboot_StartLoad(&obj->loader, false, addr, size);
+  SetError(0, ret);
+
+  /*Every 7th packet is corrupted in the link on its first transmission*/
+  for (offset = 0; ret == Flashboot_eOK && offset < size;) {
+    uint32_t len = size - offset > PACKET_SIZE ? PACKET_SIZE : size - offset;
+    ret = TransferPacket(offset, &image[offset], len,
+                         !retry && (offset / PACKET_SIZE) % 7 == 3);
+    retry = ret == Flashboot_eRetransmitRequest;
+    if (retry) {
+      ret = Flashboot_eOK;
+    } else {
+      offset += len;
+    }
+  }
+
+  /*A cell lost its charge after being programmed*/
+  test_flipBit(addr + 3 * kRangeSize + 10);
+
+  /*Verify the image by blocks and resend only the corrupted ones*/
+  Flashboot_Frame frame = {.id = Flashboot_RangeCRC};
+  frame.payload.rangeCRC.count = 1;
+  FLASHBOOT_U64_TO_ARRAY(addr, frame.payload.rangeCRC.range[0].address);
+  FLASHBOOT_U64_TO_ARRAY((uint64_t)size, frame.payload.rangeCRC.range[0].size);
+  FLASHBOOT_U32_TO_ARRAY(kRangeSize, frame.payload.rangeCRC.range[0].blockSize);
+  Flashboot_Frame reply =
+      SendFrame(&frame, sizeof(frame.id) +
+                            sizeof(frame.payload.rangeCRC.count) +
+                            sizeof(frame.payload.rangeCRC.range[0]));
+  ret = reply.payload.rangeCRCResult.result;
+
+  for (offset = 0; ret == Flashboot_eOK && offset < size;
+       offset += kRangeSize) {
+    uint32_t len = size - offset > kRangeSize ? kRangeSize : size - offset;
+
+    if (FLASHBOOT_ARRAY_TO_U32(
+            reply.payload.rangeCRCResult.crc[offset / kRangeSize]) !=
+        crc32(&image[offset], len, 0)) {
+      for (uint32_t i = 0; ret == Flashboot_eOK && i < len; i += PACKET_SIZE) {
+        ret = TransferPacket(offset + i, &image[offset + i],
+                             len - i > PACKET_SIZE ? PACKET_SIZE : len - i,
+                             false);
+      }
+    }
+  }
+
+  if (test->running && ret == Flashboot_eOK) {
+    FinishAndBoot(test, crc, version);
+  }
+
+  test_finish();
+  return 0;
+}
+
+int ProtocolDeltaLoad(ClassTest *test, void *arg) {
+  BootApp_Context *obj = &appContext;
+  enum { kBlockSize = 1024 };
+
+  Flashboot_Memory progMemory = {
+      .startAddress = 0x08004000, // Complete memory size
+      .size = 20 * 1024,          // Complete memory size
+      .pageSize = PAGE_SIZE,      // Minimum writable block
+      .sectorSize = SECTOR_SIZE,  // Minimum erasable block
+  };
+
+  test_init(test->inputFile, test->outputFile, &test->running,
+            progMemory.startAddress, progMemory.size, 0, 0, 0, 0);
+
+  /*Init loader library*/
+  Flashboot_eResult ret =
+      Flashboot_Initialize(&obj->loader, obj, &interface, &progMemory,
+                           obj->workbuffer, sizeof(obj->workbuffer));
+
+  if (ret != Flashboot_eOK) {
+    return 0;
+  }
+  test->running = true;
+
+  static uint8_t image[20 * 1024];
+  uint32_t crc, version, offset, size, sent = 0, erased, blocks;
+  uint64_t addr = 0;
+
+  size = LoadImage(test->inputFile, &addr, &crc, &version, image,
+                   sizeof(image));
+  ret = Flashboot_StartLoad(&obj->loader, false, addr, size);
+  SetError(0, ret);
+  if (ret == Flashboot_eOK) {
+    ret = Flashboot_WriteLoad(&obj->loader, image, size);
+    SetError(0, ret);
+  }
+  if (ret == Flashboot_eOK) {
+    ret = Flashboot_FinishLoad(&obj->loader, crc, version);
+    SetError(0, ret);
+  }
+
+  /*The new release changes two blocks, the last one is the same*/
+  image[2 * kBlockSize + 100] ^= 0x5A;
+  image[5 * kBlockSize + 7] ^= 0xA5;
+  crc = crc32(image, size, 0);
+  version++;
+
+  Flashboot_Frame frame = {.id = Flashboot_RangeCRC};
+  frame.payload.rangeCRC.count = 1;
+  FLASHBOOT_U64_TO_ARRAY(addr, frame.payload.rangeCRC.range[0].address);
+  FLASHBOOT_U64_TO_ARRAY((uint64_t)size, frame.payload.rangeCRC.range[0].size);
+  FLASHBOOT_U32_TO_ARRAY(kBlockSize, frame.payload.rangeCRC.range[0].blockSize);
+  Flashboot_Frame reply =
+      SendFrame(&frame, sizeof(frame.id) +
+                            sizeof(frame.payload.rangeCRC.count) +
+                            sizeof(frame.payload.rangeCRC.range[0]));
+  ret = reply.payload.rangeCRCResult.result;
+
+  /*The memory is kept, only the blocks that changed are sent*/
+  Flashboot_Frame start = {.id = Flashboot_UpdateStart};
+  FLASHBOOT_U64_TO_ARRAY(addr, start.payload.updateStart.startAddress);
+  FLASHBOOT_U64_TO_ARRAY((uint64_t)size, start.payload.updateStart.size);
+  FLASHBOOT_U32_TO_ARRAY(version, start.payload.updateStart.version);
+  FLASHBOOT_U32_TO_ARRAY(kBlockSize, start.payload.updateStart.blockSize);
+  test_eraseCount(&erased, &blocks);
+  if (ret == Flashboot_eOK) {
+    ret = SendFrame(&start,
+                    sizeof(start.id) + sizeof(start.payload.updateStart))
+              .payload.Result.result;
+    SetError(0, ret);
+  }
+
+  for (offset = 0; ret == Flashboot_eOK && offset < size;
+       offset += kBlockSize) {
+    uint32_t len = size - offset > kBlockSize ? kBlockSize : size - offset;
+
+    if (FLASHBOOT_ARRAY_TO_U32(
+            reply.payload.rangeCRCResult.crc[offset / kBlockSize]) !=
+        crc32(&image[offset], len, 0)) {
+      for (uint32_t i = 0; ret == Flashboot_eOK && i < len; i += PACKET_SIZE) {
+        ret = TransferPacket(offset + i, &image[offset + i],
+                             len - i > PACKET_SIZE ? PACKET_SIZE : len - i,
+                             false);
+      }
+      sent++;
+    }
+  }
+
+  /*Only the sectors of the blocks sent and of the MBR are erased*/
+  test_eraseCount(&offset, &blocks);
+  fprintf(test->outputFile, "Blocks=%u of %u erase=%u sectors\n", sent,
+          (size + kBlockSize - 1) / kBlockSize, offset - erased);
+
+  /*The finish checks the CRC of the kept blocks as well*/
+  if (test->running && ret == Flashboot_eOK) {
+    FinishAndBoot(test, crc, version);
+  }
+
+  test_finish();
+  return 0;
+}
+
+/*!
+ * Amount of bytes at the beginning of data equal to the first one.
+ */
+static uint32_t ConstantRun(const uint8_t *data, uint32_t size) {
+  uint32_t run = 1;
+  while (run < size && data[run] == data[0]) {
+    run++;
+  }
+  return run;
+}
+
+int ProtocolSparseLoad(ClassTest *test, void *arg) {
+  BootApp_Context *obj = &appContext;
+  enum { kMinFill = 64 };
+
+  Flashboot_Memory progMemory = {
+      .startAddress = 0x08004000, // Complete memory size
+      .size = 20 * 1024,          // Complete memory size
+      .pageSize = PAGE_SIZE,      // Minimum writable block
+      .sectorSize = SECTOR_SIZE,  // Minimum erasable block
+  };
+
+  test_init(test->inputFile, test->outputFile, &test->running,
+            progMemory.startAddress, progMemory.size, 0, 0, 0, 0);
+
+  /*Init loader library*/
+  Flashboot_eResult ret =
+      Flashboot_Initialize(&obj->loader, obj, &interface, &progMemory,
+                           obj->workbuffer, sizeof(obj->workbuffer));
+
+  if (ret != Flashboot_eOK) {
+    return 0;
+  }
+  test->running = true;
+
+  static uint8_t image[20 * 1024];
+  uint32_t crc, version, offset, size, len;
+  uint64_t addr = 0;
+
+  size = LoadImage(test->inputFile, &addr, &crc, &version, image,
+                   sizeof(image));
+  ret = Flashboot_StartLoad(&obj->loader, false, addr, size);
+  SetError(0, ret);
+
+  /*Constant regions are filled by the loader instead of transferred*/
+  for (offset = 0; ret == Flashboot_eOK && offset < size; offset += len) {
+    len = ConstantRun(&image[offset], size - offset);
+    if (len >= kMinFill) {
+      Flashboot_Frame frame = {.id = Flashboot_UpdateFill};
+
+      FLASHBOOT_U64_TO_ARRAY((uint64_t)offset, frame.payload.updateFill.offset);
+      FLASHBOOT_U64_TO_ARRAY((uint64_t)len, frame.payload.updateFill.size);
+      frame.payload.updateFill.value = image[offset];
+      ret = SendFrame(&frame,
+                      sizeof(frame.id) + sizeof(frame.payload.updateFill))
+                .payload.Result.result;
+    } else {
+      /*Transfer until the next constant region or a full packet*/
+      for (len = 0; len < PACKET_SIZE && offset + len < size;) {
+        uint32_t run = ConstantRun(&image[offset + len], size - offset - len);
+        if (run >= kMinFill) {
+          break;
+        }
+        len += run;
+      }
+      len = len > PACKET_SIZE ? PACKET_SIZE : len;
+      ret = TransferPacket(offset, &image[offset], len, false);
+    }
+  }
+
+  if (test->running && ret == Flashboot_eOK) {
+    FinishAndBoot(test, crc, version);
+  }
+
+  test_finish();
+  return 0;
+}
+
+/*!
+ * Write the image and stream it back, the packet with the id lost is dropped
+ * once as if the link lost it, none if it's negative.
+ */
+static int ReadBack(ClassTest *test, int32_t lost) {
+  BootApp_Context *obj = &appContext;
+  enum { kWindow = 4 };
+
+  Flashboot_Memory progMemory = {
+      .startAddress = 0x08004000, // Complete memory size
+      .size = 20 * 1024,          // Complete memory size
+      .pageSize = PAGE_SIZE,      // Minimum writable block
+      .sectorSize = SECTOR_SIZE,  // Minimum erasable block
+  };
+
+  test_init(test->inputFile, test->outputFile, &test->running,
+            progMemory.startAddress, progMemory.size, 0, 0, 0, 0);
+
+  /*Init loader library*/
+  Flashboot_eResult ret =
+      Flashboot_Initialize(&obj->loader, obj, &interface, &progMemory,
+                           obj->workbuffer, sizeof(obj->workbuffer));
+
+  if (ret != Flashboot_eOK) {
+    return 0;
+  }
+  test->running = true;
+
+  static uint8_t image[20 * 1024];
+  static uint8_t readBack[20 * 1024];
+  uint32_t crc, version, size, received = 0, discarded = 0;
+  uint64_t addr = 0;
+  bool lossy = lost >= 0;
+
+  size = LoadImage(test->inputFile, &addr, &crc, &version, image,
+                   sizeof(image));
+  ret = Flashboot_StartLoad(&obj->loader, false, addr, size);
+  SetError(0, ret);
+  if (ret == Flashboot_eOK) {
+    ret = Flashboot_WriteLoad(&obj->loader, image, size);
+    SetError(0, ret);
+  }
+  if (ret == Flashboot_eOK) {
+    ret = Flashboot_FinishLoad(&obj->loader, crc, version);
+    SetError(0, ret);
+  }
+
+  /*Stream the image back, acknowledging every window*/
+  Flashboot_Frame frame = {.id = Flashboot_ReadMemory};
+  FLASHBOOT_U64_TO_ARRAY(addr, frame.payload.readMemory.address);
+  FLASHBOOT_U64_TO_ARRAY((uint64_t)size, frame.payload.readMemory.size);
+  frame.payload.readMemory.window = kWindow;
+  Flashboot_Frame reply =
+      SendFrame(&frame, sizeof(frame.id) + sizeof(frame.payload.readMemory));
+  /*Id of the last packet received in order, none yet*/
+  uint16_t lastID = UINT16_MAX;
+
+  while (ret == Flashboot_eOK && reply.id == Flashboot_ReadData) {
+    uint16_t packetID = FLASHBOOT_ARRAY_TO_U16(reply.payload.readData.packetID);
+    uint32_t offset = FLASHBOOT_ARRAY_TO_U64(reply.payload.readData.offset);
+    uint32_t len = size - offset > PACKET_SIZE ? PACKET_SIZE : size - offset;
+
+    /*Packets lost, corrupted or out of order are discarded, the repeated
+     * acknowledge makes the loader send them again*/
+    if (packetID == lost ||
+        FLASHBOOT_ARRAY_TO_U32(reply.payload.readData.crc) !=
+            crc32(reply.payload.readData.packet, len, 0) ||
+        offset != received) {
+      lost = packetID == lost ? -1 : lost;
+      discarded++;
+    } else {
+      memcpy(&readBack[offset], reply.payload.readData.packet, len);
+      received += len;
+      lastID = packetID;
+    }
+
+    Flashboot_Execute(&obj->loader);
+    if (test_reply((uint8_t *)&reply) == 0) {
+      if (received == size) {
+        break;
+      }
+      Flashboot_Frame ack = {.id = Flashboot_ReadAck};
+      FLASHBOOT_U16_TO_ARRAY(lastID, ack.payload.readAck.packetID);
+      reply = SendFrame(&ack, sizeof(ack.id) + sizeof(ack.payload.readAck));
+    }
+  }
+
+  fprintf(test->outputFile, "ReadBack=%s\n",
+          received == size && memcmp(image, readBack, size) == 0 ? "OK"
+                                                                 : "Fail");
+  if (lossy) {
+    fprintf(test->outputFile, "Discarded=%u\n", discarded);
+  }
+
+  test_finish();
+  return 0;
+}
+
+int ProtocolReadBack(ClassTest *test, void *arg) {
+  return ReadBack(test, -1);
+}
+
+int ProtocolReadBackLoss(ClassTest *test, void *arg) {
+  /*The third packet of the first window is lost*/
+  return ReadBack(test, 2);
+}
+
+/*!
+ * Append a frame preceded by its size to a batch.
+ * @return The new size of the batch.
+ */
+static uint32_t BatchAppend(uint8_t *batch, uint32_t size,
+                            const Flashboot_Frame *frame, uint16_t length) {
+  uint8_t *entry = &batch[size];
+
+  FLASHBOOT_U16_TO_ARRAY(length, entry);
+  memcpy(entry + sizeof(length), frame, length);
+  return size + sizeof(length) + length;
+}
+
+int ProtocolBatch(ClassTest *test, void *arg) {
+  BootApp_Context *obj = &appContext;
+
+  Flashboot_Memory progMemory = {
+      .startAddress = 0x08004000, // Complete memory size
+      .size = 20 * 1024,          // Complete memory size
+      .pageSize = PAGE_SIZE,      // Minimum writable block
+      .sectorSize = SECTOR_SIZE,  // Minimum erasable block
+  };
+
+  test_init(test->inputFile, test->outputFile, &test->running,
+            progMemory.startAddress, progMemory.size, 0, 0, 0, 0);
+
+  /*Init loader library*/
+  Flashboot_eResult ret =
+      Flashboot_Initialize(&obj->loader, obj, &interface, &progMemory,
+                           obj->workbuffer, sizeof(obj->workbuffer));
+
+  if (ret != Flashboot_eOK) {
+    return 0;
+  }
+  test->running = true;
+
+  static uint8_t image[20 * 1024];
+  uint32_t crc, version, offset, size, last;
+  uint64_t addr = 0;
+
+  size = LoadImage(test->inputFile, &addr, &crc, &version, image,
+                   sizeof(image));
+  ret = Flashboot_StartLoad(&obj->loader, false, addr, size);
+  SetError(0, ret);
+
+  last = size - ((size - 1) % PACKET_SIZE + 1);
+  for (offset = 0; ret == Flashboot_eOK && offset < last;
+       offset += PACKET_SIZE) {
+    ret = TransferPacket(offset, &image[offset], PACKET_SIZE, false);
+  }
+
+  /*The last packet, the finish and the boot share a single frame*/
+  uint8_t batch[sizeof(Flashboot_CmdId) + 2 * sizeof(Flashboot_Frame)];
+  uint32_t batchSize = sizeof(Flashboot_CmdId);
+  Flashboot_Frame frame = {.id = Flashboot_UpdateTransfer};
+  uint16_t length = sizeof(frame.id) +
+                    sizeof(frame.payload.updateTransfer.packetID) +
+                    sizeof(frame.payload.updateTransfer.offset) +
+                    sizeof(frame.payload.updateTransfer.crc) + size - last;
+
+  batch[0] = Flashboot_Batch;
+  FLASHBOOT_U16_TO_ARRAY(last / PACKET_SIZE,
+                         frame.payload.updateTransfer.packetID);
+  FLASHBOOT_U64_TO_ARRAY((uint64_t)last, frame.payload.updateTransfer.offset);
+  FLASHBOOT_U32_TO_ARRAY(crc32(&image[last], size - last, 0),
+                         frame.payload.updateTransfer.crc);
+  memcpy(frame.payload.updateTransfer.packet, &image[last], size - last);
+  batchSize = BatchAppend(batch, batchSize, &frame, length);
+
+  frame.id = Flashboot_UpdateFinish;
+  FLASHBOOT_U32_TO_ARRAY(crc, frame.payload.updateFinish.crc);
+  FLASHBOOT_U32_TO_ARRAY(version, frame.payload.updateFinish.version);
+  batchSize = BatchAppend(batch, batchSize, &frame,
+                          sizeof(frame.id) +
+                              sizeof(frame.payload.updateFinish));
+
+  frame.id = Flashboot_BootApplication;
+  batchSize = BatchAppend(batch, batchSize, &frame, sizeof(frame.id));
+
+  /*The commands replied with data are refused, the batch has one reply*/
+  if (ret == Flashboot_eOK) {
+    uint8_t refused[sizeof(Flashboot_CmdId) + sizeof(Flashboot_Frame)];
+    Flashboot_eResult result;
+
+    refused[0] = Flashboot_Batch;
+    frame.id = Flashboot_GetVersion;
+    result = (int8_t)SendFrame((Flashboot_Frame *)refused,
+                               BatchAppend(refused, sizeof(Flashboot_CmdId),
+                                           &frame, sizeof(frame.id)))
+                 .payload.batchResult.result;
+    fprintf(test->outputFile, "Batch GetVersion=%d\n", result);
+  }
+
+  if (ret == Flashboot_eOK) {
+    ret = SendFrame((Flashboot_Frame *)batch, batchSize)
+              .payload.batchResult.result;
+  }
+
+  /*The boot continues after the batch reply*/
+  while (test->running && ret == Flashboot_eOK) {
+    ret = Flashboot_Execute(&obj->loader);
+    SetError(0, ret);
+  }
+
+  test_finish();
+  return 0;
+}
+
+int SectorMapLoad(ClassTest *test, void *arg) {
+  BootApp_Context *obj = &appContext;
+  static const Flashboot_SectorRegion sectorMap[] = {
+      {.count = 8, .size = SECTOR_SIZE},
+      {.count = 17, .size = 2 * SECTOR_SIZE},
+  };
+  static const uint32_t blockSizes[] = {4 * SECTOR_SIZE, 8 * SECTOR_SIZE};
+
+  Flashboot_Memory progMemory = {
+      .startAddress = 0x08004000, // Complete memory size
+      .size = 21 * 1024,          // Complete memory size
+      .pageSize = PAGE_SIZE,      // Minimum writable block
+      .sectorSize = SECTOR_SIZE,  // Minimum erasable block
+      .sectorMap = sectorMap,
+      .sectorMapCount = sizeof(sectorMap) / sizeof(sectorMap[0]),
+      .blockSizes = blockSizes,
+      .blockSizeCount = sizeof(blockSizes) / sizeof(blockSizes[0]),
+  };
+
+  test_init(test->inputFile, test->outputFile, &test->running,
+            progMemory.startAddress, progMemory.size, 0, 0, 0, 0);
+  test_sectorMap(&progMemory);
+
+  /*Init loader library*/
+  Flashboot_eResult ret =
+      Flashboot_Initialize(&obj->loader, obj, &interface, &progMemory,
+                           obj->workbuffer, sizeof(obj->workbuffer));
+
+  if (ret != Flashboot_eOK) {
+    return 0;
+  }
+  test->running = true;
+
+  static uint8_t image[20 * 1024];
+  uint32_t crc, version, size, sectors, blocks;
+  uint64_t addr = 0;
+
+  size = LoadImage(test->inputFile, &addr, &crc, &version, image,
+                   sizeof(image));
+  ret = Flashboot_StartLoad(&obj->loader, false, addr, size);
+  SetError(0, ret);
+  if (ret == Flashboot_eOK) {
+    ret = Flashboot_WriteLoad(&obj->loader, image, size);
+    SetError(0, ret);
+  }
+  if (ret == Flashboot_eOK) {
+    ret = Flashboot_FinishLoad(&obj->loader, crc, version);
+    SetError(0, ret);
+  }
+
+  /*The whole memory is erased by blocks, only the last sector doesn't fit*/
+  test_eraseCount(&sectors, &blocks);
+  fprintf(test->outputFile, "Erase=%u sectors %u blocks\n", sectors, blocks);
+
+  if (ret == Flashboot_eOK) {
+    ret = Flashboot_Boot(&obj->loader);
+    SetError(0, ret);
+
+    while (test->running && ret == Flashboot_eOK) {
+      ret = Flashboot_Execute(&obj->loader);
+      SetError(0, ret);
+    }
+  }
+
+  test_finish();
+  return 0;
+}
+
+int ScratchSectorLoad(ClassTest *test, void *arg) {
+  BootApp_Context *obj = &appContext;
+  enum { kWorkBufferSize = SECTOR_SIZE / 4 };
+
+  Flashboot_Memory progMemory = {
+      .startAddress = 0x08004000, // Complete memory size
+      .size = 20 * 1024,          // Complete memory size
+      .pageSize = PAGE_SIZE,      // Minimum writable block
+      .sectorSize = SECTOR_SIZE,  // Minimum erasable block
+  };
+
+  Flashboot_Memory scratchMemory = {
+      .startAddress = 0x08010000, // Complete memory size
+      .size = SECTOR_SIZE,        // Complete memory size
+      .pageSize = PAGE_SIZE,      // Minimum writable block
+      .sectorSize = SECTOR_SIZE,  // Minimum erasable block
+  };
+
+  test_init(test->inputFile, test->outputFile, &test->running,
+            progMemory.startAddress, progMemory.size,
+            scratchMemory.startAddress, scratchMemory.size, 0, 0);
+
+  /*Init loader library with a work buffer smaller than a sector*/
+  Flashboot_eResult ret =
+      Flashboot_Initialize(&obj->loader, obj, &interface, &progMemory,
+                           obj->workbuffer, kWorkBufferSize);
+
+  if (ret != Flashboot_eOK) {
+    return 0;
+  }
+  Flashboot_SetScratchMemory(&obj->loader, &scratchMemory);
+  test->running = true;
+
+  static uint8_t image[20 * 1024];
+  uint32_t crc, version, size, offset = 7 * PACKET_SIZE;
+  uint64_t addr = 0;
+
+  size = LoadImage(test->inputFile, &addr, &crc, &version, image,
+                   sizeof(image));
+  ret = Flashboot_StartLoad(&obj->loader, false, addr, size);
+  SetError(0, ret);
+  if (ret == Flashboot_eOK) {
+    ret = Flashboot_WriteLoad(&obj->loader, image, size);
+    SetError(0, ret);
+  }
+
+  /*A cell lost its charge, resending the packet rewrites a range across two
+   * sectors, the rest of each sector is preserved in the scratch memory*/
+  test_flipBit(addr + offset + 10);
+  if (ret == Flashboot_eOK) {
+    ret = TransferPacket(offset, &image[offset], PACKET_SIZE, false);
+  }
+
+  if (test->running && ret == Flashboot_eOK) {
+    FinishAndBoot(test, crc, version);
+  }
+
+  test_finish();
+  return 0;
+}
+
+/*!
+ * Sector erase of a worn memory, the erases after the ones left fail.
+ */
+static uint32_t WornErase(void *arg, uint64_t address) {
+  uint32_t *left = arg;
+
+  if (*left == 0) {
+    return 0;
+  }
+  (*left)--;
+  return FlashErase(NULL, address);
+}
+
+int BitClearLoad(ClassTest *test, void *arg) {
+  BootApp_Context *obj = &appContext;
+
+  Flashboot_Memory progMemory = {
+      .startAddress = 0x08004000, // Complete memory size
+      .size = 20 * 1024,          // Complete memory size
+      .pageSize = PAGE_SIZE,      // Minimum writable block
+      .sectorSize = SECTOR_SIZE,  // Minimum erasable block
+      .flags = FLASHBOOT_MEMORY_BIT_CLEAR,
+  };
+
+  test_init(test->inputFile, test->outputFile, &test->running,
+            progMemory.startAddress, progMemory.size, 0x10000000, 8 * 1024,
+            0, 0);
+  test_sectorMap(&progMemory);
+
+  /*Init loader library*/
+  Flashboot_eResult ret =
+      Flashboot_Initialize(&obj->loader, obj, &interface, &progMemory,
+                           obj->workbuffer, sizeof(obj->workbuffer));
+
+  if (ret != Flashboot_eOK) {
+    return 0;
+  }
+  test->running = true;
+
+  static uint8_t image[20 * 1024];
+  uint32_t crc, version, size, sectors, blocks, offset = 7 * PACKET_SIZE;
+  uint64_t addr = 0;
+
+  size = LoadImage(test->inputFile, &addr, &crc, &version, image,
+                   sizeof(image));
+  ret = Flashboot_StartLoad(&obj->loader, false, addr, size);
+  SetError(0, ret);
+  if (ret == Flashboot_eOK) {
+    ret = Flashboot_WriteLoad(&obj->loader, image, size);
+    SetError(0, ret);
+  }
+  if (ret == Flashboot_eOK) {
+    ret = Flashboot_FinishLoad(&obj->loader, crc, version);
+    SetError(0, ret);
+  }
+
+  /*Only the sectors reached by the update are erased*/
+  test_eraseCount(&sectors, &blocks);
+  fprintf(test->outputFile, "Erase=%u sectors\n", sectors);
+
+  /*A smaller update invalidates the previous MBR in place*/
+  size /= 2;
+  if (ret == Flashboot_eOK) {
+    ret = Flashboot_StartLoad(&obj->loader, false, addr, size);
+    SetError(0, ret);
+  }
+  if (ret == Flashboot_eOK) {
+    ret = Flashboot_WriteLoad(&obj->loader, image, size);
+    SetError(0, ret);
+  }
+  test_eraseCount(&sectors, &blocks);
+  fprintf(test->outputFile, "Erase=%u sectors\n", sectors);
+
+  /*A cell was programmed to 1 by noise, the retransmission only clears it*/
+  test_flipBit(addr + offset + 10);
+  if (ret == Flashboot_eOK) {
+    ret = TransferPacket(offset, &image[offset], PACKET_SIZE, false);
+  }
+  test_eraseCount(&sectors, &blocks);
+  fprintf(test->outputFile, "Erase=%u sectors\n", sectors);
+
+  if (test->running && ret == Flashboot_eOK) {
+    FinishAndBoot(test, crc32(image, size, 0), version);
+  }
+
+  /*A sector the update reaches isn't erased, the update stops instead of
+   * programming over it*/
+  uint32_t erases = 1;
+  const Flashboot_MemoryDriver wornDriver = {.EraseMemSector = WornErase,
+                                             .arg = &erases};
+
+  progMemory.driver = &wornDriver;
+  ret = Flashboot_StartLoad(&obj->loader, false, addr, size * 2);
+  if (ret == Flashboot_eOK) {
+    ret = Flashboot_WriteLoad(&obj->loader, image, size * 2);
+  }
+  fprintf(test->outputFile, "Worn=%d\n", ret);
+
+  /*An image kept in a data memory with bigger pages is copied once, its MBR
+   * is cleared in place with the pages of the data memory*/
+  Flashboot_Memory dataMemory = {
+      .startAddress = 0x10000000,
+      .size = 8 * 1024,
+      .pageSize = 4 * PAGE_SIZE,
+      .sectorSize = SECTOR_SIZE,
+      .flags = FLASHBOOT_MEMORY_BIT_CLEAR,
+      .writeBlockSize = SECTOR_SIZE,
+  };
+
+  progMemory.driver = NULL;
+  Flashboot_SetDataMemory(&obj->loader, &dataMemory);
+  ret = Flashboot_StartLoad(&obj->loader, true, addr, size);
+  if (ret == Flashboot_eOK) {
+    ret = Flashboot_WriteLoad(&obj->loader, image, size);
+  }
+  if (ret == Flashboot_eOK) {
+    ret = Flashboot_FinishLoad(&obj->loader, crc32(image, size, 0), version);
+  }
+  for (int boot = 0; boot < 2 && ret == Flashboot_eOK; boot++) {
+    uint32_t erased;
+
+    test_eraseCount(&erased, &blocks);
+    ret = Flashboot_Initialize(&obj->loader, obj, &interface, &progMemory,
+                               obj->workbuffer, sizeof(obj->workbuffer));
+    Flashboot_SetDataMemory(&obj->loader, &dataMemory);
+    test->running = true;
+    while (test->running && ret == Flashboot_eOK) {
+      ret = Flashboot_Execute(&obj->loader);
+      SetError(0, ret);
+    }
+    test_eraseCount(&sectors, &blocks);
+    fprintf(test->outputFile, "Boot=%d copy=%u sectors\n", boot,
+            sectors - erased);
+  }
+
+  test_finish();
+  return 0;
+}
+
+int EraseFreeLoad(ClassTest *test, void *arg) {
+  BootApp_Context *obj = &appContext;
+
+  Flashboot_Memory progMemory = {
+      .startAddress = 0x08004000, // Complete memory size
+      .size = 20 * 1024,          // Complete memory size
+      .pageSize = PAGE_SIZE,      // Minimum writable block
+      .sectorSize = SECTOR_SIZE,  // Minimum erasable block
+      .flags = FLASHBOOT_MEMORY_ERASE_FREE,
+      .writeBlockSize = SECTOR_SIZE,
+  };
+
+  test_init(test->inputFile, test->outputFile, &test->running,
+            progMemory.startAddress, progMemory.size, 0, 0, 0, 0);
+
+  /*Init loader library*/
+  Flashboot_eResult ret =
+      Flashboot_Initialize(&obj->loader, obj, &interface, &progMemory,
+                           obj->workbuffer, sizeof(obj->workbuffer));
+
+  if (ret != Flashboot_eOK) {
+    return 0;
+  }
+  test->running = true;
+
+  static uint8_t image[20 * 1024];
+  uint32_t crc, version, size, sectors, blocks, pages;
+  uint64_t addr = 0;
+
+  size = LoadImage(test->inputFile, &addr, &crc, &version, image,
+                   sizeof(image));
+
+  /*The second update overwrites the first one and invalidates its MBR*/
+  for (int i = 0; i < 2 && ret == Flashboot_eOK; i++) {
+    size = i ? size / 2 : size;
+    ret = Flashboot_StartLoad(&obj->loader, false, addr, size);
+    SetError(0, ret);
+    if (ret == Flashboot_eOK) {
+      ret = Flashboot_WriteLoad(&obj->loader, image, size);
+      SetError(0, ret);
+    }
+    if (ret == Flashboot_eOK) {
+      ret = Flashboot_FinishLoad(&obj->loader, crc32(image, size, 0), version);
+      SetError(0, ret);
+    }
+  }
+
+  /*An update failing its CRC is discarded writing the erased value over it,
+   * then it's written again*/
+  for (int i = 0; i < 2 && ret == Flashboot_eOK; i++) {
+    ret = Flashboot_StartLoad(&obj->loader, false, addr, size);
+    if (ret == Flashboot_eOK) {
+      ret = Flashboot_WriteLoad(&obj->loader, image, size);
+    }
+    if (ret == Flashboot_eOK) {
+      ret = Flashboot_FinishLoad(&obj->loader, crc32(image, size, !i), version);
+    }
+    if (i == 0) {
+      uint8_t blank[PAGE_SIZE];
+      bool erased = true;
+
+      for (uint32_t offset = 0; offset < size; offset += sizeof(blank)) {
+        FlashRead(obj, addr + offset, blank, sizeof(blank));
+        for (uint32_t j = 0; j < sizeof(blank); j++) {
+          erased = erased && blank[j] == 0xFF;
+        }
+      }
+      fprintf(test->outputFile, "Discarded=%d erased=%s\n", ret,
+              erased ? "OK" : "Fail");
+      ret = Flashboot_eOK;
+    }
+  }
+  SetError(0, ret);
+
+  /*No erase, the image is written in blocks*/
+  test_eraseCount(&sectors, &blocks);
+  fprintf(test->outputFile, "Erase=%u sectors %u blocks\n", sectors, blocks);
+  test_writeCount(&pages, &blocks);
+  fprintf(test->outputFile, "Write=%u pages %u blocks\n", pages, blocks);
+
+  if (ret == Flashboot_eOK) {
+    ret = Flashboot_Boot(&obj->loader);
+    SetError(0, ret);
+
+    while (test->running && ret == Flashboot_eOK) {
+      ret = Flashboot_Execute(&obj->loader);
+      SetError(0, ret);
+    }
+  }
+
+  test_finish();
+  return 0;
+}
+
+/*!
+ * Driver of a memory backed by RAM, it's memory mapped and doesn't need an
+ * erase.
+ */
+typedef struct {
+  uint8_t data[20 * 1024];
+  uint32_t writes;
+  uint32_t reads;
+} RamMemory;
+
+static uint32_t RamWrite(void *arg, uint64_t address, uint8_t *data,
+                         uint32_t size) {
+  RamMemory *ram = (RamMemory *)arg;
+
+  memcpy((void *)(uintptr_t)address, data, size);
+  ram->writes++;
+  return size;
+}
+
+static uint32_t RamWritePage(void *arg, uint64_t address, uint8_t *data) {
+  return RamWrite(arg, address, data, PAGE_SIZE);
+}
+
+static uint32_t RamRead(void *arg, uint64_t address, uint8_t *data,
+                        uint32_t size) {
+  RamMemory *ram = (RamMemory *)arg;
+
+  memcpy(data, (void *)(uintptr_t)address, size);
+  ram->reads++;
+  return size;
+}
+
+static uint32_t RamProtect(void *arg, bool lock) { return 0; }
+
+int MemoryDriverBackup(ClassTest *test, void *arg) {
+  BootApp_Context *obj = &appContext;
+  /*Aligned to the sectors, so they don't depend on where the RAM is*/
+  static RamMemory ram __attribute__((aligned(SECTOR_SIZE)));
+  enum { kImageSize = 9300 };
+  const Flashboot_MemoryDriver ramDriver = {
+      .WriteMemPage = RamWritePage,
+      .WriteMem = RamWrite,
+      .ReadMem = RamRead,
+      .ProtectMem = RamProtect,
+      .arg = &ram,
+      .capabilities = FLASHBOOT_DRIVER_MAPPED_READ,
+  };
+
+  Flashboot_Memory progMemory = {
+      .startAddress = 0x08004000, // Complete memory size
+      .size = 20 * 1024,          // Complete memory size
+      .pageSize = PAGE_SIZE,      // Minimum writable block
+      .sectorSize = SECTOR_SIZE,  // Minimum erasable block
+  };
+
+  Flashboot_Memory backupMemory = {
+      .startAddress = (uintptr_t)ram.data, // Complete memory size
+      .size = 39 * MBR_ALINGMENT,          // Complete memory size
+      .pageSize = PAGE_SIZE,               // Minimum writable block
+      .sectorSize = SECTOR_SIZE,           // Minimum erasable block
+      .flags = FLASHBOOT_MEMORY_ERASE_FREE,
+      .writeBlockSize = SECTOR_SIZE,
+      .driver = &ramDriver,
+  };
+
+  test_init(test->inputFile, test->outputFile, &test->running,
+            progMemory.startAddress, progMemory.size, 0, 0, 0, 0);
+
+  /*Init loader library*/
+  Flashboot_eResult ret =
+      Flashboot_Initialize(&obj->loader, obj, &interface, &progMemory,
+                           obj->workbuffer, sizeof(obj->workbuffer));
+
+  if (ret != Flashboot_eOK) {
+    return 0;
+  }
+  test->running = true;
+
+  static uint8_t image[20 * 1024];
+  uint32_t crc, version, size;
+  uint64_t addr = 0;
+
+  size = LoadImage(test->inputFile, &addr, &crc, &version, image,
+                   sizeof(image));
+
+  /*The backup memory ends before the last chunk of the work buffer read by
+   * the restore*/
+  size = kImageSize;
+  crc = crc32(image, size, 0);
+  ret = Flashboot_StartLoad(&obj->loader, false, addr, size);
+  SetError(0, ret);
+  if (ret == Flashboot_eOK) {
+    ret = Flashboot_WriteLoad(&obj->loader, image, size);
+    SetError(0, ret);
+  }
+  if (ret == Flashboot_eOK) {
+    ret = Flashboot_FinishLoad(&obj->loader, crc, version);
+    SetError(0, ret);
+  }
+
+  /*The backup is created in the RAM through its own driver*/
+  if (ret == Flashboot_eOK) {
+    Flashboot_Initialize(&obj->loader, obj, &interface, &progMemory,
+                         obj->workbuffer, sizeof(obj->workbuffer));
+    ret = Flashboot_SetBackupMemory(&obj->loader, true, &backupMemory);
+    SetError(0, ret);
+
+    while (test->running && ret == Flashboot_eOK) {
+      ret = Flashboot_Execute(&obj->loader);
+      SetError(0, ret);
+    }
+  }
+
+  /*The mapped memory is never read through the driver*/
+  fprintf(test->outputFile, "RamBackup=%s writes=%u reads=%u\n",
+          memcmp(ram.data, image, size) == 0 ? "OK" : "Fail", ram.writes,
+          ram.reads);
+
+  /*The image is restored from the RAM, nothing is written after it*/
+  test_flipBit(addr + 0x10);
+  if (ret == Flashboot_eOK) {
+    Flashboot_Initialize(&obj->loader, obj, &interface, &progMemory,
+                         obj->workbuffer, sizeof(obj->workbuffer));
+    ret = Flashboot_SetBackupMemory(&obj->loader, true, &backupMemory);
+    SetError(0, ret);
+
+    test->running = true;
+    while (test->running && ret == Flashboot_eOK) {
+      ret = Flashboot_Execute(&obj->loader);
+      SetError(0, ret);
+    }
+  }
+
+  test_finish();
+  return 0;
+}
+
+/*!
+ * Start an update through the protocol.
+ * @return The result of the command.
+ */
+static int8_t UpdateStart(uint64_t address, uint64_t size, uint32_t version) {
+  Flashboot_Frame frame = {.id = Flashboot_UpdateStart};
+
+  FLASHBOOT_U64_TO_ARRAY(address, frame.payload.updateStart.startAddress);
+  FLASHBOOT_U64_TO_ARRAY(size, frame.payload.updateStart.size);
+  FLASHBOOT_U32_TO_ARRAY(version, frame.payload.updateStart.version);
+  return SendFrame(&frame, sizeof(frame.id) + sizeof(frame.payload.updateStart))
+      .payload.Result.result;
+}
+
+int LargeMemoryLoad(ClassTest *test, void *arg) {
+  BootApp_Context *obj = &appContext;
+
+  Flashboot_Memory progMemory = {
+      .startAddress = 0x100000000, // Complete memory size
+      .size = 6ULL << 30,          // Complete memory size
+      .pageSize = PAGE_SIZE,       // Minimum writable block
+      .sectorSize = SECTOR_SIZE,   // Minimum erasable block
+      .flags = FLASHBOOT_MEMORY_ERASE_FREE,
+      .writeBlockSize = SECTOR_SIZE,
+  };
+
+  test_init(test->inputFile, test->outputFile, &test->running, 0, 0, 0, 0, 0,
+            0);
+  progMemory.driver = test_fileMemory(progMemory.startAddress, progMemory.size);
+  if (progMemory.driver == NULL) {
+    return 0;
+  }
+
+  /*Init loader library*/
+  Flashboot_eResult ret =
+      Flashboot_Initialize(&obj->loader, obj, &interface, &progMemory,
+                           obj->workbuffer, sizeof(obj->workbuffer));
+
+  if (ret != Flashboot_eOK) {
+    test_fileMemoryClose();
+    return 0;
+  }
+  test->running = true;
+
+  static uint8_t image[20 * 1024];
+  uint32_t crc, version, size, offset;
+  uint64_t addr = 0;
+
+  /*The image is placed beyond the first 4GB of the memory*/
+  size = LoadImage(test->inputFile, &addr, &crc, &version, image,
+                   sizeof(image));
+  addr = progMemory.startAddress + (5ULL << 30) + (addr % SECTOR_SIZE);
+
+  /*The size is not truncated, 4GB more don't fit the memory*/
+  ret = UpdateStart(addr, (1ULL << 32) + size, 0);
+  if (ret == Flashboot_eAddressOutOfBoundsError) {
+    ret = UpdateStart(addr, size, 0);
+  }
+
+  for (offset = 0; ret == Flashboot_eOK && offset < size;
+       offset += PACKET_SIZE) {
+    ret = TransferPacket(offset, &image[offset],
+                         size - offset > PACKET_SIZE ? PACKET_SIZE
+                                                     : size - offset,
+                         false);
+  }
+
+  /*The CRC of a range beyond the first 4GB*/
+  Flashboot_Frame frame = {.id = Flashboot_RangeCRC};
+  frame.payload.rangeCRC.count = 1;
+  FLASHBOOT_U64_TO_ARRAY(addr, frame.payload.rangeCRC.range[0].address);
+  FLASHBOOT_U64_TO_ARRAY((uint64_t)size, frame.payload.rangeCRC.range[0].size);
+  Flashboot_Frame reply =
+      SendFrame(&frame, sizeof(frame.id) +
+                            sizeof(frame.payload.rangeCRC.count) +
+                            sizeof(frame.payload.rangeCRC.range[0]));
+  fprintf(test->outputFile, "RangeCRC=%s\n",
+          FLASHBOOT_ARRAY_TO_U32(reply.payload.rangeCRCResult.crc[0]) == crc
+              ? "OK"
+              : "Fail");
+
+  /*The MBR with 64 bits addresses is found and the image booted*/
+  if (test->running && ret == Flashboot_eOK) {
+    FinishAndBoot(test, crc, version);
+  }
+
+  uint8_t mbr[sizeof(Flashboot_MBR)];
+  uint8_t hexData[2 * sizeof(mbr) + 1] = {0};
+  uint64_t mbrAddress = addr + size + MBR_ALINGMENT - 1;
+
+  mbrAddress -= mbrAddress % MBR_ALINGMENT;
+  progMemory.driver->ReadMem(NULL, mbrAddress, mbr, sizeof(mbr));
+  Bin2Hex(hexData, mbr, 2 * sizeof(mbr));
+  fprintf(test->outputFile, "MBR=%s\n", hexData);
+
+  test_fileMemoryClose();
+  test_finish();
+  return 0;
+}
+
+/*!
+ * Restart the loader in A/B mode and boot the selected slot.
+ */
+static void BootSlots(ClassTest *test, Flashboot_Memory *progMemory,
+                      Flashboot_Memory *slotMemory,
+                      Flashboot_Memory *recordMemory, Flashboot_eVerify policy,
+                      bool successBoot) {
+  BootApp_Context *obj = &appContext;
+  Flashboot_eResult ret;
+
+  Flashboot_Initialize(&obj->loader, obj, &interface, progMemory,
+                       obj->workbuffer, sizeof(obj->workbuffer));
+  ret = Flashboot_SetSlots(&obj->loader, slotMemory, recordMemory);
+  SetError(0, ret);
+  if (ret == Flashboot_eOK) {
+    ret = Flashboot_SetVerifyPolicy(&obj->loader, policy, 0, successBoot);
+    SetError(0, ret);
+  }
+
+  test->running = true;
+  while (test->running && ret == Flashboot_eOK) {
+    ret = Flashboot_Execute(&obj->loader);
+    SetError(0, ret);
+  }
+}
+
+int SlotsBoot(ClassTest *test, void *arg) {
+  BootApp_Context *obj = &appContext;
+
+  Flashboot_Memory progMemory = {
+      .startAddress = 0x08004000, // Complete memory size
+      .size = 20 * 1024,          // Complete memory size
+      .pageSize = PAGE_SIZE,      // Minimum writable block
+      .sectorSize = SECTOR_SIZE,  // Minimum erasable block
+  };
+
+  Flashboot_Memory slotMemory = {
+      .startAddress = 0x10000000, // Complete memory size
+      .size = 20 * 1024,          // Complete memory size
+      .pageSize = PAGE_SIZE,      // Minimum writable block
+      .sectorSize = SECTOR_SIZE,  // Minimum erasable block
+  };
+
+  Flashboot_Memory recordMemory = {
+      .startAddress = 0x10010000, // Complete memory size
+      .size = 2 * SECTOR_SIZE,    // Complete memory size
+      .pageSize = PAGE_SIZE,      // Minimum writable block
+      .sectorSize = SECTOR_SIZE,  // Minimum erasable block
+  };
+
+  test_init(test->inputFile, test->outputFile, &test->running,
+            progMemory.startAddress, progMemory.size, slotMemory.startAddress,
+            slotMemory.size, recordMemory.startAddress, recordMemory.size);
+
+  /*Init loader library*/
+  Flashboot_eResult ret =
+      Flashboot_Initialize(&obj->loader, obj, &interface, &progMemory,
+                           obj->workbuffer, sizeof(obj->workbuffer));
+
+  if (ret != Flashboot_eOK) {
+    return 0;
+  }
+  ret = Flashboot_SetSlots(&obj->loader, &slotMemory, &recordMemory);
+  SetError(0, ret);
+  if (ret == Flashboot_eOK) {
+    ret = Flashboot_SetBlockCRC(&obj->loader, 2 * SECTOR_SIZE);
+    SetError(0, ret);
+  }
+
+  static uint8_t image[20 * 1024];
+  uint32_t crc, version, size, sectors, blocks;
+  uint64_t addr = 0;
+
+  size = LoadImage(test->inputFile, &addr, &crc, &version, image,
+                   sizeof(image));
+
+  /*Each update is written in the slot not in use and booted from it*/
+  for (int i = 0; i < 2 && ret == Flashboot_eOK; i++) {
+    size = i ? size / 2 : size;
+    ret = Flashboot_StartLoad(&obj->loader, true, addr, size);
+    SetError(0, ret);
+    if (ret == Flashboot_eOK) {
+      ret = Flashboot_WriteLoad(&obj->loader, image, size);
+      SetError(0, ret);
+    }
+    if (ret == Flashboot_eOK) {
+      ret = Flashboot_FinishLoad(&obj->loader, crc32(image, size, 0),
+                                 version + i);
+      SetError(0, ret);
+    }
+    BootSlots(test, &progMemory, &slotMemory, &recordMemory,
+              Flashboot_eVerifyFull, true);
+  }
+
+  /*Applying the update didn't copy anything, only the updates erased*/
+  test_eraseCount(&sectors, &blocks);
+  fprintf(test->outputFile, "Erase=%u sectors %u blocks\n", sectors, blocks);
+
+  /*The previous image is selected again*/
+  ret = Flashboot_Rollback(&obj->loader);
+  SetError(0, ret);
+  BootSlots(test, &progMemory, &slotMemory, &recordMemory,
+            Flashboot_eVerifyFull, true);
+
+  /*The records fill the second half of their memory, the next one erases the
+   * first half. A reset before it's written keeps the slot selected*/
+  static jmp_buf powerLoss;
+  uint32_t erased, switches = 0;
+
+  test_eraseCount(&erased, &blocks);
+  do {
+    ret = Flashboot_Rollback(&obj->loader);
+    test_eraseCount(&sectors, &blocks);
+    switches++;
+  } while (ret == Flashboot_eOK && sectors == erased);
+  for (uint32_t i = 1; ret == Flashboot_eOK &&
+                       i < SECTOR_SIZE / sizeof(Flashboot_SlotRecord);
+       i++, switches++) {
+    ret = Flashboot_Rollback(&obj->loader);
+  }
+  SetError(0, ret);
+  BootSlots(test, &progMemory, &slotMemory, &recordMemory,
+            Flashboot_eVerifyFull, true);
+  fprintf(test->outputFile, "Switches=%u sequence=%u\n", switches,
+          obj->loader.slots.sequence);
+
+  test_eraseCount(&erased, &blocks);
+  test_powerLoss(&powerLoss, 1);
+  if (setjmp(powerLoss) == 0) {
+    Flashboot_Rollback(&obj->loader);
+  }
+  test_powerLoss(NULL, 0);
+  test_eraseCount(&sectors, &blocks);
+  BootSlots(test, &progMemory, &slotMemory, &recordMemory,
+            Flashboot_eVerifyFull, true);
+  fprintf(test->outputFile, "Erase=%u sectors sequence=%u\n",
+          sectors - erased, obj->loader.slots.sequence);
+
+  /*The slot selected before the records were filled is selected again*/
+  if (switches % 2) {
+    ret = Flashboot_Rollback(&obj->loader);
+    SetError(0, ret);
+  }
+
+  /*The selected image is corrupted, the other slot is booted*/
+  test_flipBit(slotMemory.startAddress + 0x100);
+  BootSlots(test, &progMemory, &slotMemory, &recordMemory,
+            Flashboot_eVerifyFull, true);
+
+  /*The slots are checked as the verification policy selects. The first boot
+   * of the repaired image checks it whole, the next ones only its table and
+   * miss a corrupted block, until a failed boot checks it whole again*/
+  test_flipBit(slotMemory.startAddress + 0x100);
+  ret = Flashboot_Rollback(&obj->loader);
+  SetError(0, ret);
+  for (int i = 0; i < 3; i++) {
+    if (i == 1) {
+      test_flipBit(slotMemory.startAddress + 0x100);
+    }
+    BootSlots(test, &progMemory, &slotMemory, &recordMemory,
+              Flashboot_eVerifyHeader, i < 2);
+  }
+
+  /*An update that doesn't fit in the other slot is refused*/
+  slotMemory.size = SECTOR_SIZE;
+  ret = Flashboot_StartLoad(&obj->loader, true, addr, size);
+  fprintf(test->outputFile, "SmallSlot=%d\n", ret);
+
+  test_finish();
+  return 0;
+}
+
+/*!
+ * Resume an update through the protocol.
+ * @param offset  Receives the offset to continue from.
+ * @param crc     Receives the CRC of the update up to the offset.
+ * @return The result of the command.
+ */
+static int8_t UpdateResume(uint64_t address, uint64_t size, uint32_t version,
+                           uint64_t *offset, uint32_t *crc) {
+  Flashboot_Frame frame = {.id = Flashboot_UpdateResume};
+
+  FLASHBOOT_U64_TO_ARRAY(address, frame.payload.updateResume.startAddress);
+  FLASHBOOT_U64_TO_ARRAY(size, frame.payload.updateResume.size);
+  FLASHBOOT_U32_TO_ARRAY(version, frame.payload.updateResume.version);
+  Flashboot_Frame reply = SendFrame(
+      &frame, sizeof(frame.id) + sizeof(frame.payload.updateResume));
+  *offset = FLASHBOOT_ARRAY_TO_U64(reply.payload.updateResumeResult.offset);
+  *crc = FLASHBOOT_ARRAY_TO_U32(reply.payload.updateResumeResult.crc);
+  return reply.payload.updateResumeResult.result;
+}
+
+int ProtocolResume(ClassTest *test, void *arg) {
+  BootApp_Context *obj = &appContext;
+  enum { kPowerLoss = 23 * PACKET_SIZE };
+
+  Flashboot_Memory progMemory = {
+      .startAddress = 0x08004000, // Complete memory size
+      .size = 20 * 1024,          // Complete memory size
+      .pageSize = PAGE_SIZE,      // Minimum writable block
+      .sectorSize = SECTOR_SIZE,  // Minimum erasable block
+  };
+
+  Flashboot_Memory journalMemory = {
+      .startAddress = 0x10010000, // Complete memory size
+      .size = SECTOR_SIZE,        // Complete memory size
+      .pageSize = PAGE_SIZE,      // Minimum writable block
+      .sectorSize = SECTOR_SIZE,  // Minimum erasable block
+  };
+
+  test_init(test->inputFile, test->outputFile, &test->running,
+            progMemory.startAddress, progMemory.size, 0, 0,
+            journalMemory.startAddress, journalMemory.size);
+
+  /*Init loader library*/
+  Flashboot_eResult ret =
+      Flashboot_Initialize(&obj->loader, obj, &interface, &progMemory,
+                           obj->workbuffer, sizeof(obj->workbuffer));
+
+  if (ret != Flashboot_eOK) {
+    return 0;
+  }
+  ret = Flashboot_SetJournalMemory(&obj->loader, &journalMemory);
+  SetError(0, ret);
+  test->running = true;
+
+  static uint8_t image[20 * 1024];
+  uint32_t crc, version, size, resumeCRC, sent = 0;
+  uint64_t addr = 0, offset;
+
+  size = LoadImage(test->inputFile, &addr, &crc, &version, image,
+                   sizeof(image));
+  ret = UpdateStart(addr, size, version);
+
+  /*The power drops in the middle of the transfer*/
+  for (offset = 0; ret == Flashboot_eOK && offset < kPowerLoss;
+       offset += PACKET_SIZE) {
+    ret = TransferPacket(offset, &image[offset], PACKET_SIZE, false);
+    sent += PACKET_SIZE;
+  }
+  Flashboot_Initialize(&obj->loader, obj, &interface, &progMemory,
+                       obj->workbuffer, sizeof(obj->workbuffer));
+  ret = Flashboot_SetJournalMemory(&obj->loader, &journalMemory);
+  SetError(0, ret);
+
+  /*Only the update recorded is resumed*/
+  ret = UpdateResume(addr, size, version + 1, &offset, &resumeCRC);
+  fprintf(test->outputFile, "ResumeOther=%d\n", ret);
+
+  /*The host checks the region kept and sends only what is missing*/
+  ret = UpdateResume(addr, size, version, &offset, &resumeCRC);
+  fprintf(test->outputFile, "Resume=%d offset=0x%" PRIX64 " crc=%s\n", ret,
+          offset, resumeCRC == crc32(image, offset, 0) ? "OK" : "Fail");
+
+  for (; ret == Flashboot_eOK && offset < size; offset += PACKET_SIZE) {
+    uint32_t len = size - offset > PACKET_SIZE ? PACKET_SIZE : size - offset;
+    ret = TransferPacket(offset, &image[offset], len, false);
+    sent += len;
+  }
+  fprintf(test->outputFile, "Sent=%u of %u\n", sent, size);
+
+  if (test->running && ret == Flashboot_eOK) {
+    FinishAndBoot(test, crc, version);
+  }
+
+  /*The finished update can't be resumed*/
+  ret = UpdateResume(addr, size, version, &offset, &resumeCRC);
+  fprintf(test->outputFile, "ResumeFinished=%d\n", ret);
+
+  test_finish();
+  return 0;
+}
+
+int CopyResume(ClassTest *test, void *arg) {
+  BootApp_Context *obj = &appContext;
+  enum { kPowerLoss = 3000 };
+
+  Flashboot_Memory progMemory = {
+      .startAddress = 0x08004000, // Complete memory size
+      .size = 20 * 1024,          // Complete memory size
+      .pageSize = PAGE_SIZE,      // Minimum writable block
+      .sectorSize = SECTOR_SIZE,  // Minimum erasable block
+  };
+
+  Flashboot_Memory dataMemory = {
+      .startAddress = 0x10000000, // Complete memory size
+      .size = 20 * 1024,          // Complete memory size
+      .pageSize = PAGE_SIZE,      // Minimum writable block
+      .sectorSize = SECTOR_SIZE,  // Minimum erasable block
+  };
+
+  Flashboot_Memory journalMemory = {
+      .startAddress = 0x10010000, // Complete memory size
+      .size = SECTOR_SIZE,        // Complete memory size
+      .pageSize = PAGE_SIZE,      // Minimum writable block
+      .sectorSize = SECTOR_SIZE,  // Minimum erasable block
+  };
+
+  test_init(test->inputFile, test->outputFile, &test->running,
+            progMemory.startAddress, progMemory.size, dataMemory.startAddress,
+            dataMemory.size, journalMemory.startAddress, journalMemory.size);
+
+  /*Init loader library*/
+  Flashboot_eResult ret =
+      Flashboot_Initialize(&obj->loader, obj, &interface, &progMemory,
+                           obj->workbuffer, sizeof(obj->workbuffer));
+
+  if (ret != Flashboot_eOK) {
+    return 0;
+  }
+  Flashboot_SetDataMemory(&obj->loader, &dataMemory);
+  ret = Flashboot_SetJournalMemory(&obj->loader, &journalMemory);
+  SetError(0, ret);
+
+  static uint8_t image[20 * 1024];
+  static jmp_buf powerLoss;
+  uint32_t crc, version, size;
+  uint64_t addr = 0;
+
+  /*The update is received in the data memory*/
+  size = LoadImage(test->inputFile, &addr, &crc, &version, image,
+                   sizeof(image));
+  ret = Flashboot_StartLoad(&obj->loader, true, addr, size);
+  SetError(0, ret);
+  if (ret == Flashboot_eOK) {
+    ret = Flashboot_WriteLoad(&obj->loader, image, size);
+    SetError(0, ret);
+  }
+  if (ret == Flashboot_eOK) {
+    ret = Flashboot_FinishLoad(&obj->loader, crc, version);
+    SetError(0, ret);
+  }
+
+  /*The power drops while the update is applied, the next boot continues the
+   * copy instead of starting it again*/
+  for (int i = 0; i < 2; i++) {
+    uint32_t pages, sectors, blocks, lastPages, lastSectors;
+
+    test_writeCount(&lastPages, &blocks);
+    test_eraseCount(&lastSectors, &blocks);
+
+    Flashboot_Initialize(&obj->loader, obj, &interface, &progMemory,
+                         obj->workbuffer, sizeof(obj->workbuffer));
+    Flashboot_SetJournalMemory(&obj->loader, &journalMemory);
+    Flashboot_SetDataMemory(&obj->loader, &dataMemory);
+
+    test->running = true;
+    test_powerLoss(i == 0 ? &powerLoss : NULL, kPowerLoss);
+    if (setjmp(powerLoss) == 0) {
+      ret = Flashboot_eOK;
+      while (test->running && ret == Flashboot_eOK) {
+        ret = Flashboot_Execute(&obj->loader);
+        SetError(0, ret);
+      }
+    }
+
+    test_writeCount(&pages, &blocks);
+    test_eraseCount(&sectors, &blocks);
+    fprintf(test->outputFile, "Apply=%d pages=%u sectors=%u\n", i,
+            pages - lastPages, sectors - lastSectors);
+  }
+
+  test_finish();
+  return 0;
+}
+
+int ManifestLoad(ClassTest *test, void *arg) {
+  BootApp_Context *obj = &appContext;
+  enum { kImages = 3 };
+
+  Flashboot_Memory progMemory = {
+      .startAddress = 0x08004000, // Complete memory size
+      .size = 20 * 1024,          // Complete memory size
+      .pageSize = PAGE_SIZE,      // Minimum writable block
+      .sectorSize = SECTOR_SIZE,  // Minimum erasable block
+  };
+
+  Flashboot_Memory dataMemory = {
+      .startAddress = 0x20000000, // Complete memory size
+      .size = 8 * 1024,           // Complete memory size
+      .pageSize = PAGE_SIZE,      // Minimum writable block
+      .sectorSize = SECTOR_SIZE,  // Minimum erasable block
+  };
+
+  Flashboot_Memory backupMemory = {
+      .startAddress = 0x10000000, // Complete memory size
+      .size = 20 * 1024,          // Complete memory size
+      .pageSize = PAGE_SIZE,      // Minimum writable block
+      .sectorSize = SECTOR_SIZE,  // Minimum erasable block
+  };
+
+  test_init(test->inputFile, test->outputFile, &test->running,
+            progMemory.startAddress, progMemory.size, dataMemory.startAddress,
+            dataMemory.size, backupMemory.startAddress, backupMemory.size);
+
+  /*Init loader library*/
+  Flashboot_eResult ret =
+      Flashboot_Initialize(&obj->loader, obj, &interface, &progMemory,
+                           obj->workbuffer, sizeof(obj->workbuffer));
+
+  if (ret != Flashboot_eOK) {
+    return 0;
+  }
+  Flashboot_SetDataMemory(&obj->loader, &dataMemory);
+  test->running = true;
+
+  static uint8_t image[20 * 1024];
+  uint32_t crc, version, size, sectors, blocks;
+  uint64_t addr = 0, offset = 0;
+
+  size = LoadImage(test->inputFile, &addr, &crc, &version, image,
+                   sizeof(image));
+
+  /*The application and two components taken from slices of the image, the
+   * components are kept in the data memory*/
+  struct {
+    uint64_t address;
+    const uint8_t *data;
+    uint32_t size;
+  } images[kImages] = {
+      {addr, image, size},
+      {0x20000000, &image[0x400], 2048},
+      {0x20001000, &image[0x1000], 1024},
+  };
+  Flashboot_Frame frame = {.id = Flashboot_UpdateManifest};
+
+  frame.payload.updateManifest.count = kImages;
+  for (int i = 0; i < kImages; i++) {
+    FLASHBOOT_U64_TO_ARRAY(images[i].address,
+                           frame.payload.updateManifest.image[i].address);
+    FLASHBOOT_U64_TO_ARRAY((uint64_t)images[i].size,
+                           frame.payload.updateManifest.image[i].size);
+    FLASHBOOT_U32_TO_ARRAY(crc32(images[i].data, images[i].size, 0),
+                           frame.payload.updateManifest.image[i].crc);
+    FLASHBOOT_U32_TO_ARRAY((version + i),
+                           frame.payload.updateManifest.image[i].version);
+  }
+  ret = SendFrame(&frame,
+                  sizeof(frame.id) +
+                      sizeof(frame.payload.updateManifest.count) +
+                      kImages * sizeof(frame.payload.updateManifest.image[0]))
+            .payload.Result.result;
+  fprintf(test->outputFile, "Manifest=%d\n", ret);
+
+  /*The images are streamed back to back, a packet may span two of them*/
+  static uint8_t stream[sizeof(image) * 2];
+  uint32_t total = 0;
+
+  for (int i = 0; i < kImages; i++) {
+    memcpy(&stream[total], images[i].data, images[i].size);
+    total += images[i].size;
+  }
+  for (; ret == Flashboot_eOK && offset < total; offset += PACKET_SIZE) {
+    uint32_t len = total - offset > PACKET_SIZE ? PACKET_SIZE : total - offset;
+    ret = TransferPacket(offset, &stream[offset], len, false);
+  }
+
+  /*Packets retransmitted across the end of an image are rewritten in both*/
+  for (int i = 0; ret == Flashboot_eOK && i < kImages - 1; i++) {
+    offset = (i ? images[0].size : 0) + images[i].size - PACKET_SIZE / 2;
+    ret = TransferPacket(offset, &stream[offset], PACKET_SIZE, false);
+    fprintf(test->outputFile, "Retransmit=%d\n", ret);
+  }
+
+  /*The update is checked against the CRC of each image*/
+  if (test->running && ret == Flashboot_eOK) {
+    FinishAndBoot(test, 0, 0);
+  }
+  test_eraseCount(&sectors, &blocks);
+  fprintf(test->outputFile, "Erase=%u sectors %u blocks\n", sectors, blocks);
+
+  /*A component is corrupted, the application isn't booted*/
+  test_flipBit(images[2].address + 0x10);
+  Flashboot_Initialize(&obj->loader, obj, &interface, &progMemory,
+                       obj->workbuffer, sizeof(obj->workbuffer));
+  Flashboot_SetDataMemory(&obj->loader, &dataMemory);
+  test->running = true;
+  ret = Flashboot_eOK;
+  for (int i = 0; i < 8 && test->running && ret == Flashboot_eOK; i++) {
+    ret = Flashboot_Execute(&obj->loader);
+    SetError(0, ret);
+  }
+  test_flipBit(images[2].address + 0x10);
+
+  /*The backup and the application restored from it list the components*/
+  for (int i = 0; i < 2; i++) {
+    if (i) {
+      test_flipBit(addr + 0x10);
+    }
+    Flashboot_Initialize(&obj->loader, obj, &interface, &progMemory,
+                         obj->workbuffer, sizeof(obj->workbuffer));
+    Flashboot_SetDataMemory(&obj->loader, &dataMemory);
+    ret = Flashboot_SetBackupMemory(&obj->loader, true, &backupMemory);
+    test->running = true;
+    while (test->running && ret == Flashboot_eOK) {
+      ret = Flashboot_Execute(&obj->loader);
+      SetError(0, ret);
+    }
+    fprintf(test->outputFile, "Components=%u\n",
+            obj->loader.mbr.components);
+  }
+
+  /*With a corrupted component neither the backup nor its blocks restore the
+   * application, the loader waits for an update*/
+  test_flipBit(images[2].address + 0x10);
+  Flashboot_Initialize(&obj->loader, obj, &interface, &progMemory,
+                       obj->workbuffer, sizeof(obj->workbuffer));
+  Flashboot_SetDataMemory(&obj->loader, &dataMemory);
+  Flashboot_SetBlockCRC(&obj->loader, 2 * SECTOR_SIZE);
+  ret = Flashboot_SetBackupMemory(&obj->loader, true, &backupMemory);
+  test->running = true;
+  int steps = 0;
+  for (; steps < 64 && test->running && ret == Flashboot_eOK; steps++) {
+    ret = Flashboot_Execute(&obj->loader);
+    SetError(0, ret);
+  }
+  fprintf(test->outputFile, "Recovery=%s\n", steps < 64 ? "stopped" : "loop");
+
+  test_finish();
+  return 0;
+}
+
+int BackupRefresh(ClassTest *test, void *arg) {
+  BootApp_Context *obj = &appContext;
+
+  Flashboot_Memory progMemory = {
+      .startAddress = 0x08004000, // Complete memory size
+      .size = 20 * 1024,          // Complete memory size
+      .pageSize = PAGE_SIZE,      // Minimum writable block
+      .sectorSize = SECTOR_SIZE,  // Minimum erasable block
+  };
+
+  Flashboot_Memory backupMemory = {
+      .startAddress = 0x10000000, // Complete memory size
+      .size = 20 * 1024,          // Complete memory size
+      .pageSize = PAGE_SIZE,      // Minimum writable block
+      .sectorSize = SECTOR_SIZE,  // Minimum erasable block
+  };
+
+  test_init(test->inputFile, test->outputFile, &test->running,
+            progMemory.startAddress, progMemory.size, 0, 0,
+            backupMemory.startAddress, backupMemory.size);
+
+  /*Init loader library*/
+  Flashboot_eResult ret =
+      Flashboot_Initialize(&obj->loader, obj, &interface, &progMemory,
+                           obj->workbuffer, sizeof(obj->workbuffer));
+
+  if (ret != Flashboot_eOK) {
+    return 0;
+  }
+
+  static uint8_t image[20 * 1024];
+  uint32_t crc, version, size;
+  uint64_t addr = 0;
+
+  size = LoadImage(test->inputFile, &addr, &crc, &version, image,
+                   sizeof(image));
+
+  /*The second update only changes a few bytes of the first one*/
+  for (int i = 0; i < 2; i++) {
+    uint32_t pages, sectors, blocks, lastPages, lastSectors;
+
+    memset(&image[0x1000], i, 16);
+    ret = Flashboot_StartLoad(&obj->loader, false, addr, size);
+    SetError(0, ret);
+    if (ret == Flashboot_eOK) {
+      ret = Flashboot_WriteLoad(&obj->loader, image, size);
+      SetError(0, ret);
+    }
+    if (ret == Flashboot_eOK) {
+      ret = Flashboot_FinishLoad(&obj->loader, crc32(image, size, 0),
+                                 version + i);
+      SetError(0, ret);
+    }
+
+    /*The backup is refreshed on the first boot of each update*/
+    test_writeCount(&lastPages, &blocks);
+    test_eraseCount(&lastSectors, &blocks);
+
+    Flashboot_Initialize(&obj->loader, obj, &interface, &progMemory,
+                         obj->workbuffer, sizeof(obj->workbuffer));
+    ret = Flashboot_SetBackupMemory(&obj->loader, true, &backupMemory);
+    SetError(0, ret);
+
+    test->running = true;
+    while (test->running && ret == Flashboot_eOK) {
+      ret = Flashboot_Execute(&obj->loader);
+      SetError(0, ret);
+    }
+
+    test_writeCount(&pages, &blocks);
+    test_eraseCount(&sectors, &blocks);
+    fprintf(test->outputFile, "Backup=%d pages=%u sectors=%u\n", i,
+            pages - lastPages, sectors - lastSectors);
+  }
+
+  test_finish();
+  return 0;
+}
+
+int BlockRepair(ClassTest *test, void *arg) {
+  BootApp_Context *obj = &appContext;
+  enum { kBlockSize = 2 * SECTOR_SIZE };
+
+  Flashboot_Memory progMemory = {
+      .startAddress = 0x08004000, // Complete memory size
+      .size = 20 * 1024,          // Complete memory size
+      .pageSize = PAGE_SIZE,      // Minimum writable block
+      .sectorSize = SECTOR_SIZE,  // Minimum erasable block
+  };
+
+  Flashboot_Memory backupMemory = {
+      .startAddress = 0x10000000, // Complete memory size
+      .size = 20 * 1024,          // Complete memory size
+      .pageSize = PAGE_SIZE,      // Minimum writable block
+      .sectorSize = SECTOR_SIZE,  // Minimum erasable block
+  };
+
+  test_init(test->inputFile, test->outputFile, &test->running,
+            progMemory.startAddress, progMemory.size, 0, 0,
+            backupMemory.startAddress, backupMemory.size);
+
+  /*Init loader library*/
+  Flashboot_eResult ret =
+      Flashboot_Initialize(&obj->loader, obj, &interface, &progMemory,
+                           obj->workbuffer, sizeof(obj->workbuffer));
+
+  if (ret != Flashboot_eOK) {
+    return 0;
+  }
+  ret = Flashboot_SetBlockCRC(&obj->loader, kBlockSize);
+  SetError(0, ret);
+
+  static uint8_t image[20 * 1024];
+  uint32_t crc, version, size;
+  uint64_t addr = 0;
+
+  /*The update is written with its table of block CRCs*/
+  size = LoadImage(test->inputFile, &addr, &crc, &version, image,
+                   sizeof(image));
+  ret = Flashboot_StartLoad(&obj->loader, false, addr, size);
+  SetError(0, ret);
+  if (ret == Flashboot_eOK) {
+    ret = Flashboot_WriteLoad(&obj->loader, image, size);
+    SetError(0, ret);
+  }
+  if (ret == Flashboot_eOK) {
+    ret = Flashboot_FinishLoad(&obj->loader, crc, version);
+    SetError(0, ret);
+  }
+
+  /*The first boot creates the backup, the next one finds a corrupted block
+   * and copies only that block from the backup. A corrupted CRC of the table
+   * leaves the image to be checked as a whole*/
+  for (int i = 0; i < 3; i++) {
+    uint32_t pages, sectors, blocks, lastPages, lastSectors;
+
+    if (i == 1) {
+      test_flipBit(addr + 3 * kBlockSize + 0x10);
+    } else if (i == 2) {
+      test_flipBit(obj->loader.mbr.mbrAddress + MBR_ALINGMENT +
+                   sizeof(Flashboot_BlockTable) + 0x4);
+    }
+    test_writeCount(&lastPages, &blocks);
+    test_eraseCount(&lastSectors, &blocks);
+
+    Flashboot_Initialize(&obj->loader, obj, &interface, &progMemory,
+                         obj->workbuffer, sizeof(obj->workbuffer));
+    ret = Flashboot_SetBackupMemory(&obj->loader, true, &backupMemory);
+    SetError(0, ret);
+
+    test->running = true;
+    while (test->running && ret == Flashboot_eOK) {
+      ret = Flashboot_Execute(&obj->loader);
+      SetError(0, ret);
+    }
+
+    test_writeCount(&pages, &blocks);
+    test_eraseCount(&sectors, &blocks);
+    fprintf(test->outputFile, "Boot=%d pages=%u sectors=%u\n", i,
+            pages - lastPages, sectors - lastSectors);
+  }
+
+  test_finish();
+  return 0;
+}
+
+/*!
+ * Memories the boot time is modelled on, see VerifyPolicy.
+ */
+static FlashModel bootModels[2];
+
+/*!
+ * Read of the test port that adds its time to each model of bootModels.
+ */
+static uint32_t ModelRead(void *arg, uint64_t address, uint8_t *data,
+                          uint32_t size) {
+  for (int i = 0; i < sizeof(bootModels) / sizeof(bootModels[0]); i++) {
+    FlashModel_Read(&bootModels[i], size);
+  }
+  return FlashRead(arg, address, data, size);
+}
+
+int VerifyPolicy(ClassTest *test, void *arg) {
+  BootApp_Context *obj = &appContext;
+  enum { kBlockSize = 2 * SECTOR_SIZE };
+  static const char *presets[] = {"stm32g4", "spi-nor"};
+  static uint64_t clocks[2];
+  const Flashboot_MemoryDriver modelDriver = {.ReadMem = ModelRead};
+
+  Flashboot_Memory progMemory = {
+      .startAddress = 0x08004000, // Complete memory size
+      .size = 20 * 1024,          // Complete memory size
+      .pageSize = PAGE_SIZE,      // Minimum writable block
+      .sectorSize = SECTOR_SIZE,  // Minimum erasable block
+      .driver = &modelDriver,
+  };
+
+  for (int i = 0; i < 2; i++) {
+    FlashModel_Initialize(&bootModels[i], FlashModel_Find(presets[i]),
+                          &clocks[i]);
+  }
+
+  test_init(test->inputFile, test->outputFile, &test->running,
+            progMemory.startAddress, progMemory.size, 0, 0, 0, 0);
+
+  /*Init loader library*/
+  Flashboot_eResult ret =
+      Flashboot_Initialize(&obj->loader, obj, &interface, &progMemory,
+                           obj->workbuffer, sizeof(obj->workbuffer));
+
+  if (ret != Flashboot_eOK) {
+    return 0;
+  }
+  ret = Flashboot_SetBlockCRC(&obj->loader, kBlockSize);
+  SetError(0, ret);
+
+  static uint8_t image[20 * 1024];
+  uint32_t crc, version, size;
+  uint64_t addr = 0;
+
+  size = LoadImage(test->inputFile, &addr, &crc, &version, image,
+                   sizeof(image));
+  ret = Flashboot_StartLoad(&obj->loader, false, addr, size);
+  SetError(0, ret);
+  if (ret == Flashboot_eOK) {
+    ret = Flashboot_WriteLoad(&obj->loader, image, size);
+    SetError(0, ret);
+  }
+  if (ret == Flashboot_eOK) {
+    ret = Flashboot_FinishLoad(&obj->loader, crc, version);
+    SetError(0, ret);
+  }
+
+  /*The bytes read by each boot measure its time, modelled on the read cost
+   * of each preset*/
+  const struct {
+    Flashboot_eVerify policy;
+    uint32_t bootCount;
+    bool successBoot;
+    bool corrupt;
+  } boots[] = {
+      {Flashboot_eVerifyFull, 0, true, false},
+      {Flashboot_eVerifySampled, 0, true, false},
+      {Flashboot_eVerifySampled, 1, true, false},
+      {Flashboot_eVerifySampled, 2, true, false},
+      {Flashboot_eVerifyHeader, 3, true, false},
+      {Flashboot_eVerifyHeader, 4, false, false},
+      {Flashboot_eVerifySampled, 3, true, true},
+  };
+
+  for (int i = 0; i < sizeof(boots) / sizeof(boots[0]); i++) {
+    uint64_t bytes, lastBytes, start[2] = {clocks[0], clocks[1]};
+
+    if (boots[i].corrupt) {
+      test_flipBit(addr + 3 * kBlockSize + 0x10);
+    }
+    test_readCount(&lastBytes);
+
+    Flashboot_Initialize(&obj->loader, obj, &interface, &progMemory,
+                         obj->workbuffer, sizeof(obj->workbuffer));
+    ret = Flashboot_SetVerifyPolicy(&obj->loader, boots[i].policy,
+                                    boots[i].bootCount, boots[i].successBoot);
+    SetError(0, ret);
+
+    test->running = true;
+    for (int j = 0; j < 8 && test->running && ret == Flashboot_eOK; j++) {
+      ret = Flashboot_Execute(&obj->loader);
+      SetError(0, ret);
+    }
+
+    test_readCount(&bytes);
+    fprintf(test->outputFile, "Verify=%d boot=%u read=%" PRIu64,
+            boots[i].policy, boots[i].bootCount, bytes - lastBytes);
+    for (int j = 0; j < 2; j++) {
+      fprintf(test->outputFile, " %s=%" PRIu64 "us", presets[j],
+              clocks[j] - start[j]);
+    }
+    fputs("\n", test->outputFile);
+  }
+
+  test_finish();
+  return 0;
+}
+
+/*!
+ * Boot the application in the program memory, keeping it in the generations
+ * of the backup memory.
+ */
+static void BootGenerations(ClassTest *test, Flashboot_Memory *progMemory,
+                            Flashboot_Memory *backupMemory) {
+  BootApp_Context *obj = &appContext;
+  Flashboot_eResult ret;
+
+  Flashboot_Initialize(&obj->loader, obj, &interface, progMemory,
+                       obj->workbuffer, sizeof(obj->workbuffer));
+  ret = Flashboot_SetBackupMemory(&obj->loader, true, backupMemory);
+  SetError(0, ret);
+  ret = Flashboot_SetBackupGenerations(&obj->loader, 3);
+  SetError(0, ret);
+
+  test->running = true;
+  while (test->running && ret == Flashboot_eOK) {
+    ret = Flashboot_Execute(&obj->loader);
+    SetError(0, ret);
+  }
+  fprintf(test->outputFile, "Booted version=0x%X\n", obj->loader.mbr.version);
+}
+
+int BackupGenerations(ClassTest *test, void *arg) {
+  BootApp_Context *obj = &appContext;
+
+  Flashboot_Memory progMemory = {
+      .startAddress = 0x08004000, // Complete memory size
+      .size = 20 * 1024,          // Complete memory size
+      .pageSize = PAGE_SIZE,      // Minimum writable block
+      .sectorSize = SECTOR_SIZE,  // Minimum erasable block
+  };
+
+  Flashboot_Memory backupMemory = {
+      .startAddress = 0x10000000, // Complete memory size
+      .size = 36 * 1024,          // Complete memory size
+      .pageSize = PAGE_SIZE,      // Minimum writable block
+      .sectorSize = SECTOR_SIZE,  // Minimum erasable block
+  };
+
+  test_init(test->inputFile, test->outputFile, &test->running,
+            progMemory.startAddress, progMemory.size, 0, 0,
+            backupMemory.startAddress, backupMemory.size);
+
+  /*Init loader library*/
+  Flashboot_eResult ret =
+      Flashboot_Initialize(&obj->loader, obj, &interface, &progMemory,
+                           obj->workbuffer, sizeof(obj->workbuffer));
+
+  if (ret != Flashboot_eOK) {
+    return 0;
+  }
+
+  static uint8_t image[20 * 1024];
+  uint32_t crc, version, size;
+  uint64_t addr = 0;
+
+  size = LoadImage(test->inputFile, &addr, &crc, &version, image,
+                   sizeof(image));
+
+  /*Four updates in a ring of three generations, the first one is dropped*/
+  for (int i = 0; i < 4; i++) {
+    memset(&image[0x1000], i, 16);
+    ret = Flashboot_StartLoad(&obj->loader, false, addr, size);
+    SetError(0, ret);
+    if (ret == Flashboot_eOK) {
+      ret = Flashboot_WriteLoad(&obj->loader, image, size);
+      SetError(0, ret);
+    }
+    if (ret == Flashboot_eOK) {
+      ret = Flashboot_FinishLoad(&obj->loader, crc32(image, size, 0),
+                                 (version + i));
+      SetError(0, ret);
+    }
+    BootGenerations(test, &progMemory, &backupMemory);
+  }
+
+  /*The application is the newest generation, the ring isn't searched*/
+  BootGenerations(test, &progMemory, &backupMemory);
+  fprintf(test->outputFile, "Probes=%u\n", obj->loader.stats.mbrProbes);
+
+  /*The host lists the generations kept*/
+  Flashboot_Initialize(&obj->loader, obj, &interface, &progMemory,
+                       obj->workbuffer, sizeof(obj->workbuffer));
+  Flashboot_SetBackupMemory(&obj->loader, true, &backupMemory);
+  Flashboot_SetBackupGenerations(&obj->loader, 3);
+
+  Flashboot_Frame frame = {.id = Flashboot_GenerationList};
+  Flashboot_Frame reply = SendFrame(&frame, sizeof(frame.id));
+  fprintf(test->outputFile, "List=%d count=%u\n",
+          reply.payload.generationListResult.result,
+          reply.payload.generationListResult.count);
+  for (int i = 0; i < reply.payload.generationListResult.count; i++) {
+    fprintf(test->outputFile,
+            "Generation=%d version=0x%X size=%" PRIu64 " crc=0x%X\n", i,
+            FLASHBOOT_ARRAY_TO_U32(
+                reply.payload.generationListResult.generation[i].version),
+            FLASHBOOT_ARRAY_TO_U64(
+                reply.payload.generationListResult.generation[i].size),
+            FLASHBOOT_ARRAY_TO_U32(
+                reply.payload.generationListResult.generation[i].crc));
+  }
+
+  /*A generation out of the ring isn't restored*/
+  frame = (Flashboot_Frame){.id = Flashboot_GenerationRestore};
+  frame.payload.generationRestore.age = 3;
+  reply = SendFrame(&frame, sizeof(frame.id) +
+                                sizeof(frame.payload.generationRestore));
+  fprintf(test->outputFile, "Restore=%d\n", reply.payload.Result.result);
+
+  /*The oldest generation is copied back and booted*/
+  frame.payload.generationRestore.age = 2;
+  reply = SendFrame(&frame, sizeof(frame.id) +
+                                sizeof(frame.payload.generationRestore));
+  fprintf(test->outputFile, "Restore=%d\n", reply.payload.Result.result);
+  BootGenerations(test, &progMemory, &backupMemory);
+
+  /*With the application and the newest generation corrupted, the recovery
+   * falls back to the previous generation*/
+  Flashboot_MBR mbr;
+  ret = Flashboot_GetGeneration(&obj->loader, 0, &mbr);
+  fprintf(test->outputFile, "Newest=%d version=0x%X\n", ret, mbr.version);
+  test_flipBit(addr + 0x100);
+  test_flipBit(mbr.loadAddress + 0x100);
+  BootGenerations(test, &progMemory, &backupMemory);
+
+  test_finish();
+  return 0;
+}
+
+/*!
+ * Link of the host flasher to the loader, each frame sent is processed at
+ * once and its reply queued, as they would arrive in order.
+ */
+static struct {
+  uint8_t reply[FLASHER_MAX_WINDOW + 1][sizeof(Flashboot_Frame)];
+  uint32_t size[FLASHER_MAX_WINDOW + 1];
+  uint32_t head;
+  uint32_t count;
+  uint32_t sent;    /*Frames sent by the host*/
+  uint32_t corrupt; /*Frame corrupted in the link, 0 for none*/
+  uint64_t time;    /*Virtual time, a microsecond per call*/
+} loopback;
+
+static int32_t LoopbackSend(void *arg, const uint8_t *data, uint32_t size) {
+  BootApp_Context *obj = &appContext;
+  uint32_t tail = (loopback.head + loopback.count) % (FLASHER_MAX_WINDOW + 1);
+  Flashboot_Frame frame;
+  Flashboot_eResult ret;
+
+  memcpy(&frame, data, size);
+  if (++loopback.sent == loopback.corrupt) {
+    ((uint8_t *)&frame)[size - 1] ^= 0x10;
+  }
+
+  ret = Flashboot_ProcessProtocol(&obj->loader, (uint8_t *)&frame, size);
+  for (int i = 0; ret == Flashboot_eOK && i < 4; i++) {
+    Flashboot_Execute(&obj->loader);
+    if ((loopback.size[tail] = test_reply(loopback.reply[tail])) != 0) {
+      loopback.count++;
+      break;
+    }
+  }
+  return size;
+}
+
+static int32_t LoopbackReceive(void *arg, uint8_t *data, uint32_t size,
+                               uint32_t timeout) {
+  uint32_t length = loopback.size[loopback.head];
+
+  if (loopback.count == 0) {
+    return 0;
+  }
+  memcpy(data, loopback.reply[loopback.head], length);
+  loopback.head = (loopback.head + 1) % (FLASHER_MAX_WINDOW + 1);
+  loopback.count--;
+  return length;
+}
+
+static uint64_t LoopbackTime(void *arg) { return loopback.time++; }
+
+static uint32_t LoopbackCRC(void *arg, uint32_t initValue, const void *data,
+                            uint32_t size) {
+  return crc32(data, size, initValue);
+}
+
+int HostFlasher(ClassTest *test, void *arg) {
+  BootApp_Context *obj = &appContext;
+  static Flasher_Context flasher;
+  static const Flasher_Interface link = {
+      .Send = LoopbackSend,
+      .Receive = LoopbackReceive,
+      .GetTime = LoopbackTime,
+      .CalcCRC = LoopbackCRC,
+  };
+
+  Flashboot_Memory progMemory = {
+      .startAddress = 0x08004000, // Complete memory size
+      .size = 20 * 1024,          // Complete memory size
+      .pageSize = PAGE_SIZE,      // Minimum writable block
+      .sectorSize = SECTOR_SIZE,  // Minimum erasable block
+  };
+
+  test_init(test->inputFile, test->outputFile, &test->running,
+            progMemory.startAddress, progMemory.size, 0, 0, 0, 0);
+
+  /*Init loader library*/
+  Flashboot_eResult ret =
+      Flashboot_Initialize(&obj->loader, obj, &interface, &progMemory,
+                           obj->workbuffer, sizeof(obj->workbuffer));
+
+  if (ret != Flashboot_eOK) {
+    return 0;
+  }
+
+  static uint8_t image[20 * 1024];
+  Flasher_Image update = {.data = image};
+  uint32_t crc;
+
+  update.size = LoadImage(test->inputFile, &update.address, &crc,
+                          &update.version, image, sizeof(image));
+
+  /*Four packets in flight, the fourth one is corrupted in the link*/
+  Flasher_Initialize(&flasher, &link);
+  flasher.window = 4;
+  loopback.corrupt = 5;
+  ret = Flasher_Update(&flasher, &update);
+  fprintf(test->outputFile, "Update=%d bytes=%" PRIu64 " crc=%s\n", ret,
+          flasher.bytes,
+          crc == crc32(image, update.size, 0) ? "OK" : "Fail");
+
+  if (ret == Flashboot_eOK) {
+    ret = Flasher_Boot(&flasher);
+    test->running = true;
+    while (test->running && ret == Flashboot_eOK) {
+      ret = Flashboot_Execute(&obj->loader);
+      SetError(0, ret);
+    }
+  }
+  Flasher_Report(&flasher, test->outputFile);
+
+  test_finish();
+  return 0;
+}
+
+int SimulatedLink(ClassTest *test, void *arg) {
+  static Flasher_Context flasher;
+  static Device device;
+  static Link link;
+  Flasher_Interface host = {.CalcCRC = LoopbackCRC};
+  uint8_t frame[sizeof(Flashboot_Frame)];
+
+  /*A serial line with a frame check, 64 bytes fragments and a few frames
+   * hit by bit errors*/
+  const Link_Config config = {
+      .baud = 115200,
+      .latency = 2000,
+      .mtu = 64,
+      .bitErrorRate = 2e-5,
+      .seed = 7,
+  };
+  /*The device has its own program memory, not the one of the test port*/
+  Flashboot_Memory progMemory = {
+      .startAddress = 0x08004000, // Complete memory size
+      .size = 32 * 1024,          // Complete memory size
+      .pageSize = 8,              // Minimum writable block
+      .sectorSize = 2048,         // Minimum erasable block
+  };
+
+  device = (Device){
+      .link = &link,
+      .Receive = Link_DeviceReceive,
+      .Send = Link_DeviceSend,
+      .GetTick = Link_DeviceTick,
+  };
+  Link_Initialize(&link, &config, Device_Step, &device);
+  Link_Bind(&link, &host);
+  if (Device_Initialize(&device, &progMemory) != Flashboot_eOK) {
+    return 0;
+  }
+
+  static uint8_t image[20 * 1024];
+  Flasher_Image update = {.data = image};
+  uint32_t crc;
+
+  update.size = LoadImage(test->inputFile, &update.address, &crc,
+                          &update.version, image, sizeof(image));
+
+  Flasher_Initialize(&flasher, &host);
+  flasher.window = 4;
+  flasher.timeout = 100;
+  Flashboot_eResult ret = Flasher_Update(&flasher, &update);
+
+  uint64_t elapsed = flasher.endTime - flasher.startTime;
+  fprintf(test->outputFile, "Update=%d image=%s\n", ret,
+          memcmp(device.flash + (update.address - progMemory.startAddress),
+                 image, update.size) == 0
+              ? "OK"
+              : "Fail");
+  fprintf(test->outputFile,
+          "Capacity=%.1f KiB/s achieved=%.1f KiB/s in %" PRIu64 " us\n",
+          Link_Capacity(&link) / 1024,
+          flasher.bytes * 1e6 / 1024 / elapsed, elapsed);
+  fprintf(test->outputFile,
+          "Frames=%" PRIu64 " bytes=%" PRIu64 " wire=%" PRIu64
+          " dropped=%" PRIu64 "\n",
+          link.stats.frames, link.stats.bytes, link.stats.wireBytes,
+          link.stats.dropped);
+
+  /*The boot request has no reply, the device runs until it boots*/
+  if (ret == Flashboot_eOK) {
+    Flasher_Boot(&flasher);
+    host.Receive(host.arg, frame, sizeof(frame), flasher.timeout);
+    fprintf(test->outputFile, "Boot=0x%" PRIX64 "\n", device.bootAddress);
+  }
+  Flasher_Report(&flasher, test->outputFile);
+
+  Device_Free(&device);
+  return 0;
+}
+
+int FlashCostModel(ClassTest *test, void *arg) {
+  static const char *presets[] = {"stm32g4", "spi-nor"};
+  static Flasher_Context flasher;
+  static FlashModel model;
+  static Device device;
+  static Link link;
+  Flasher_Interface host = {.CalcCRC = LoopbackCRC};
+  const Link_Config config = {.baud = 921600, .latency = 1000};
+
+  static uint8_t image[20 * 1024];
+  Flasher_Image update = {.data = image};
+  uint32_t crc;
+
+  update.size = LoadImage(test->inputFile, &update.address, &crc,
+                          &update.version, image, sizeof(image));
+
+  for (int i = 0; i < sizeof(presets) / sizeof(presets[0]); i++) {
+    const FlashModel_Config *flash = FlashModel_Find(presets[i]);
+    Flashboot_Memory progMemory = {
+        .startAddress = 0x08004000, // Complete memory size
+        .size = 32 * 1024,          // Complete memory size
+    };
+
+    FlashModel_Geometry(flash, &progMemory);
+    device = (Device){
+        .link = &link,
+        .Receive = Link_DeviceReceive,
+        .Send = Link_DeviceSend,
+        .GetTick = Link_DeviceTick,
+        .model = &model,
+    };
+    Link_Initialize(&link, &config, Device_Step, &device);
+    Link_Bind(&link, &host);
+    FlashModel_Initialize(&model, flash, &link.now);
+    if (Device_Initialize(&device, &progMemory) != Flashboot_eOK) {
+      return 0;
+    }
+    /*An older image is replaced*/
+    memset(device.flash, 0, progMemory.size);
+
+    Flasher_Initialize(&flasher, &host);
+    Flashboot_eResult ret = Flasher_Update(&flasher, &update);
+    fprintf(test->outputFile, "%s: Update=%d in %" PRIu64 " us\n", flash->name,
+            ret, flasher.endTime - flasher.startTime);
+    FlashModel_Report(&model, test->outputFile);
+
+    /*Cold boot, the image is checked before it's booted*/
+    uint64_t start = link.now;
+    FlashModel_Initialize(&model, flash, &link.now);
+    Device_Reset(&device, false);
+    for (int j = 0; device.running && j < 1000; j++) {
+      Device_Step(&device);
+    }
+    fprintf(test->outputFile, "%s: Boot=0x%" PRIX64 " in %" PRIu64 " us\n",
+            flash->name, device.bootAddress, link.now - start);
+    FlashModel_Report(&model, test->outputFile);
+
+    Device_Free(&device);
+  }
+  return 0;
+}
+
+int GetStats(ClassTest *test, void *arg) {
+  static Flasher_Context flasher;
+  static Flashboot_Stats stats;
+  static FlashModel model;
+  static Device device;
+  static Link link;
+  Flasher_Interface host = {.CalcCRC = LoopbackCRC};
+  const FlashModel_Config *flash = FlashModel_Find("spi-nor");
+
+  /*The state times are taken from the virtual time of the link*/
+  const Link_Config config = {
+      .baud = 115200,
+      .latency = 2000,
+      .mtu = 64,
+      .bitErrorRate = 2e-5,
+      .seed = 7,
+  };
+  Flashboot_Memory progMemory = {
+      .startAddress = 0x08004000, // Complete memory size
+      .size = 32 * 1024,          // Complete memory size
+  };
+
+  FlashModel_Geometry(flash, &progMemory);
+  device = (Device){
+      .link = &link,
+      .Receive = Link_DeviceReceive,
+      .Send = Link_DeviceSend,
+      .GetTick = Link_DeviceTick,
+      .model = &model,
+  };
+  Link_Initialize(&link, &config, Device_Step, &device);
+  Link_Bind(&link, &host);
+  FlashModel_Initialize(&model, flash, &link.now);
+  if (Device_Initialize(&device, &progMemory) != Flashboot_eOK) {
+    return 0;
+  }
+  /*An older and smaller image is replaced, the sectors after it are blank*/
+  memset(device.flash, 0, 8 * 1024);
+
+  static uint8_t image[20 * 1024];
+  Flasher_Image update = {.data = image};
+  uint32_t crc;
+
+  update.size = LoadImage(test->inputFile, &update.address, &crc,
+                          &update.version, image, sizeof(image));
+
+  Flasher_Initialize(&flasher, &host);
+  flasher.window = 4;
+  flasher.timeout = 100;
+  Flashboot_eResult ret = Flasher_Update(&flasher, &update);
+  fprintf(test->outputFile, "Update=%d dropped=%" PRIu64 "\n", ret,
+          link.stats.dropped);
+  FlashModel_Report(&model, test->outputFile);
+
+  /*The counters are cleared after the first read*/
+  for (int i = 0; i < 2; i++) {
+    ret = Flasher_GetStats(&flasher, &stats, true);
+    fprintf(test->outputFile, "GetStats=%d\n", ret);
+    Flasher_ReportStats(&stats, test->outputFile);
+  }
+
+  Device_Free(&device);
+  return 0;
+}
+
 TestCase *GetTestCase(char *name) {
   for (int i = 0; i < sizeof(TestMap) / sizeof(TestMap[0]); i++) {
     if (strcmp(TestMap[i].name, name) == 0) {
@@ -2,8 +2,10 @@
 // Licensed under the Apache License, Version 2.0, see LICENSE for details.
 // SPDX-License-Identifier: Apache-2.0
 
+#define _GNU_SOURCE
 #include "config.h"
 #include "crc.h"
+#include <setjmp.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -29,8 +31,31 @@ struct test {
   struct memory programMem;
   struct memory bakMem;
   struct memory dataMem;
+  uint8_t reply[sizeof(Flashboot_Frame)];
+  uint32_t replySize;
+  const Flashboot_Memory *geometry;
+  uint32_t sectorErases;
+  uint32_t blockErases;
+  uint32_t pageWrites;
+  uint32_t blockWrites;
+  uint64_t bytesRead;
+  jmp_buf *powerLoss;
+  uint32_t powerLossCount;
 } test;
 
+/*!
+ * Memory backed by a sparse file, only the regions written take disk space.
+ * The hole found by the last read is kept, so scanning a big empty memory
+ * doesn't access the file.
+ */
+struct fileMemory {
+  FILE *file;
+  uint64_t addr;
+  uint64_t size;
+  uint64_t holeStart; /*File offset of the last hole found*/
+  uint64_t holeEnd;   /*File offset of the data after the last hole found*/
+} fileMem;
+
 static void *GetMemAddr(uint64_t address);
 static void dumpMemory(FILE *f, struct memory *mem);
 
@@ -58,6 +83,134 @@ void test_init(FILE *input, FILE *output, bool *running,
   memset(test.dataMem.buf, 0, test.dataMem.size);
 
   test.idleCount = 0;
+  test.geometry = NULL;
+  test.sectorErases = test.blockErases = 0;
+  test.pageWrites = test.blockWrites = 0;
+  test.bytesRead = 0;
+  test.powerLoss = NULL;
+}
+
+/*!
+ * Set the geometry of the program memory, by default all the sectors have
+ * SECTOR_SIZE and the pages are overwritten.
+ * @param memory    Memory description with the sector map and the flags.
+ */
+void test_sectorMap(const Flashboot_Memory *memory) { test.geometry = memory; }
+
+/*!
+ * Amount of erase operations since the test initialization.
+ * @param sectors   Receives the amount of sectors erased.
+ * @param blocks    Receives the amount of blocks erased.
+ */
+void test_eraseCount(uint32_t *sectors, uint32_t *blocks) {
+  *sectors = test.sectorErases;
+  *blocks = test.blockErases;
+}
+
+/*!
+ * Amount of write operations since the test initialization.
+ * @param pages     Receives the amount of pages written.
+ * @param blocks    Receives the amount of blocks written.
+ */
+void test_writeCount(uint32_t *pages, uint32_t *blocks) {
+  *pages = test.pageWrites;
+  *blocks = test.blockWrites;
+}
+
+/*!
+ * Amount of bytes read since the test initialization.
+ * @param bytes     Receives the amount of bytes read.
+ */
+void test_readCount(uint64_t *bytes) { *bytes = test.bytesRead; }
+
+/*!
+ * Size of the sector in an address, based on the sector map.
+ */
+static uint32_t SectorSize(uint64_t address) {
+  uint64_t start;
+
+  if (test.geometry == NULL || test.geometry->sectorMap == NULL) {
+    return SECTOR_SIZE;
+  }
+
+  start = test.geometry->startAddress;
+  for (uint32_t i = 0; i < test.geometry->sectorMapCount; i++) {
+    start += (uint64_t)test.geometry->sectorMap[i].count *
+             test.geometry->sectorMap[i].size;
+    if (address < start) {
+      return test.geometry->sectorMap[i].size;
+    }
+  }
+  return SECTOR_SIZE;
+}
+
+static uint32_t FileRead(void *arg, uint64_t address, uint8_t *data,
+                         uint32_t size) {
+  uint64_t offset = address - fileMem.addr;
+  int fd = fileno(fileMem.file);
+
+  test.idleCount = 0;
+  if (offset < fileMem.holeStart || offset + size > fileMem.holeEnd) {
+    off_t next = lseek(fd, offset, SEEK_DATA);
+    fileMem.holeStart = offset;
+    fileMem.holeEnd = next < 0 ? fileMem.size : (uint64_t)next;
+  }
+
+  /*Nothing was written in the range, it reads as zeros*/
+  if (offset + size <= fileMem.holeEnd) {
+    memset(data, 0, size);
+    return size;
+  }
+  return pread(fd, data, size, offset) == (ssize_t)size ? size : 0;
+}
+
+static uint32_t FileWrite(void *arg, uint64_t address, uint8_t *data,
+                          uint32_t size) {
+  int fd = fileno(fileMem.file);
+
+  test.idleCount = 0;
+  fileMem.holeStart = fileMem.holeEnd = 0;
+  return pwrite(fd, data, size, address - fileMem.addr) == (ssize_t)size ? size
+                                                                         : 0;
+}
+
+static uint32_t FileWritePage(void *arg, uint64_t address, uint8_t *data) {
+  return FileWrite(arg, address, data, PAGE_SIZE);
+}
+
+/*!
+ * Create a memory backed by a sparse file, as a big eMMC or SD card. It's
+ * written without erases, see ::FLASHBOOT_MEMORY_ERASE_FREE.
+ * @param address   Memory start address.
+ * @param size      Memory size, it may have several GB.
+ * @return          The driver of the memory, NULL if the file can't be
+ * created.
+ */
+const Flashboot_MemoryDriver *test_fileMemory(uint64_t address, uint64_t size) {
+  static const Flashboot_MemoryDriver driver = {
+      .WriteMemPage = FileWritePage,
+      .WriteMem = FileWrite,
+      .ReadMem = FileRead,
+  };
+
+  fileMem.file = tmpfile();
+  if (fileMem.file == NULL || ftruncate(fileno(fileMem.file), size) != 0) {
+    return NULL;
+  }
+  fileMem.addr = address;
+  fileMem.size = size;
+  fileMem.holeStart = fileMem.holeEnd = 0;
+  return &driver;
+}
+
+/*!
+ * Release the memory created by ::test_fileMemory.
+ */
+void test_fileMemoryClose(void) {
+  if (fileMem.file) {
+    fclose(fileMem.file);
+    fileMem.file = NULL;
+  }
 }
 
 void test_finish() {
@@ -89,10 +242,67 @@ void CheckData(void *arg) {
  */
 uint32_t SendData(void *arg, uint8_t *data, uint32_t size) {
   //	BootApp_Context *obj = (BootApp_Context *)arg;
+  uint8_t hexData[2 * sizeof(test.reply) + 1] = {0};
+
+  if (size > sizeof(test.reply)) {
+    size = sizeof(test.reply);
+  }
+  memcpy(test.reply, data, size);
+  test.replySize = size;
+
+  Bin2Hex(hexData, data, size * 2);
+  fprintf(test.output, "Reply=%s\n", hexData);
+  return size;
+}
+
+/*!
+ * Read the last packet sent by the boot library to the host.
+ * @param data  Buffer to receive the packet.
+ * @return      The packet size, 0 if nothing was sent since the last call.
+ */
+uint32_t test_reply(uint8_t *data) {
+  uint32_t size = test.replySize;
 
+  memcpy(data, test.reply, size);
+  test.replySize = 0;
   return size;
 }
 
+/*!
+ * Flip a bit in the memory, as a cell that lost its charge.
+ * @param address   Memory address.
+ */
+void test_flipBit(uint64_t address) {
+  uint8_t *memory = GetMemAddr(address);
+  if (memory) {
+    *memory ^= 0x01;
+  }
+}
+
+/*!
+ * Cut the power after an amount of writes and erases, the operation that
+ * would exceed it isn't done and the execution jumps back to the test.
+ * @param env       Point the execution jumps to, NULL to disable.
+ * @param count     Amount of operations done before the power loss.
+ */
+void test_powerLoss(jmp_buf *env, uint32_t count) {
+  test.powerLoss = env;
+  test.powerLossCount = count;
+}
+
+/*!
+ * Account a write or erase, jumping back to the test on a power loss.
+ */
+static void PowerCheck(void) {
+  if (test.powerLoss && test.powerLossCount-- == 0) {
+    jmp_buf *env = test.powerLoss;
+
+    test.powerLoss = NULL;
+    fprintf(test.output, "PowerLoss\n");
+    longjmp(*env, 1);
+  }
+}
+
 /*!
  * Called by boot library to write a page to memory.
  * @param arg       Void pointer to the argument passed during the
@@ -102,10 +312,22 @@ uint32_t SendData(void *arg, uint8_t *data, uint32_t size) {
  * @return
  */
 uint32_t FlashWrite(void *arg, uint64_t address, uint8_t *data) {
+  PowerCheck();
   // BootApp_Context *obj = (BootApp_Context *)arg;
 
   test.idleCount = 0;
+  test.pageWrites++;
   uint8_t *memory = GetMemAddr(address);
+  if (memory && test.geometry &&
+      (test.geometry->flags & FLASHBOOT_MEMORY_BIT_CLEAR) &&
+      address >= test.geometry->startAddress &&
+      address < test.geometry->startAddress + test.geometry->size) {
+    /*NOR cells are only programmed from 1 to 0*/
+    for (uint32_t i = 0; i < PAGE_SIZE; i++) {
+      memory[i] &= data[i];
+    }
+    return PAGE_SIZE;
+  }
   if (memory) {
     memcpy(memory, data, PAGE_SIZE);
     return PAGE_SIZE;
@@ -114,6 +336,29 @@ uint32_t FlashWrite(void *arg, uint64_t address, uint8_t *data) {
   return 0;
 }
 
+/*!
+ * Called by boot library to write several pages to memory.
+ * @param arg       Void pointer to the argument passed during the
+ * initialization.
+ * @param address   Memory address.
+ * @param data      data to be written.
+ * @param size      data size.
+ * @return
+ */
+uint32_t FlashWriteBlock(void *arg, uint64_t address, uint8_t *data,
+                         uint32_t size) {
+  PowerCheck();
+  test.idleCount = 0;
+  test.blockWrites++;
+  uint8_t *memory = GetMemAddr(address);
+  if (memory) {
+    memcpy(memory, data, size);
+    return size;
+  }
+
+  return 0;
+}
+
 /*!
  * Called by boot library to read stream of data from memory.
  * @param arg       Void pointer to the argument passed during the
@@ -129,6 +374,7 @@ uint32_t FlashRead(void *arg, uint64_t address, uint8_t *data, uint32_t size) {
     memcpy(data, (uint8_t *)memory, size);
   }
   test.idleCount = 0;
+  test.bytesRead += size;
 
   return size;
 }
@@ -142,14 +388,37 @@ uint32_t FlashRead(void *arg, uint64_t address, uint8_t *data, uint32_t size) {
  */
 uint32_t FlashErase(void *arg, uint64_t address) {
   //	BootApp_Context *obj = (BootApp_Context *)arg;
+  uint32_t size = SectorSize(address);
 
+  PowerCheck();
   uint8_t *memory = GetMemAddr(address);
   if (memory) {
-    memset(memory, 0xFF, SECTOR_SIZE);
+    memset(memory, 0xFF, size);
   }
 
+  test.sectorErases++;
   test.idleCount = 0;
-  return SECTOR_SIZE;
+  return size;
+}
+
+/*!
+ * Called by boot library to erase a block bigger than a sector in memory.
+ * @param arg       Void pointer to the argument passed during the
+ * initialization.
+ * @param address   Memory address.
+ * @param size      Block size.
+ * @return
+ */
+uint32_t FlashEraseBlock(void *arg, uint64_t address, uint32_t size) {
+  PowerCheck();
+  uint8_t *memory = GetMemAddr(address);
+  if (memory) {
+    memset(memory, 0xFF, size);
+  }
+
+  test.blockErases++;
+  test.idleCount = 0;
+  return size;
 }
 
 /*!
@@ -196,6 +465,7 @@ uint32_t GetTick(void *arg) {
 
 void SetError(void *arg, Flashboot_eResult error) {
   char *errorTable[] = {
+      "Flashboot_eRetransmitRequest      ",
       "Flashboot_eGeneralError           ",
       "Flashboot_eCRCError               ",
       "Flashboot_eNullPointerError       ",
@@ -211,7 +481,7 @@ void SetError(void *arg, Flashboot_eResult error) {
 
   if (error != 0) {
     fprintf(test.output, "Error=%s\n",
-            errorTable[abs(Flashboot_eGeneralError) + error]);
+            errorTable[abs(Flashboot_eRetransmitRequest) + error]);
   }
 }
 /*!